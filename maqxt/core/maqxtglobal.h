@@ -27,6 +27,7 @@
 #define MAQXTGLOBAL_H
 
 #include <QtGlobal>
+#include <new>
 
 #define MAQXT_VERSION 0x000602
 #define MAQXT_VERSION_STR "0.6.2"
@@ -142,6 +143,7 @@ MAQXT_CORE_EXPORT const char* qxtVersion();
 ****************************************************************************/
 
 #define MAQXT_DECLARE_PRIVATE(PUB) friend class PUB##Private; MAQxtPrivateInterface<PUB, PUB##Private> qxt_d;
+#define MAQXT_DECLARE_INLINE_PRIVATE(PUB, SIZE) friend class PUB##Private; MAQxtInlinePrivateInterface<PUB, PUB##Private, SIZE> qxt_d;
 #define MAQXT_DECLARE_PUBLIC(PUB) friend class PUB;
 #define MAQXT_INIT_PRIVATE(PUB) qxt_d.setPublic(this);
 #define MAQXT_D(PUB) PUB##Private& d = qxt_d()
@@ -204,4 +206,60 @@ private:
     MAQxtPrivate<PUB>* pvt;
 };
 
+// Like MAQxtPrivateInterface, but keeps the private object inside the
+// public one instead of allocating it. SIZE becomes part of the public
+// class layout; the constructor, which must be instantiated where PVT is
+// complete, refuses to compile if PVT does not fit.
+template <typename PUB, typename PVT, int SIZE>
+class MAQxtInlinePrivateInterface
+{
+    friend class MAQxtPrivate<PUB>;
+public:
+    MAQxtInlinePrivateInterface()
+    {
+        typedef char MAQxtPrivateTooLarge[sizeof(PVT) <= SIZE ? 1 : -1];
+        typedef char MAQxtPrivateOveraligned[Q_ALIGNOF(PVT) <= Q_ALIGNOF(Storage) ? 1 : -1];
+        (void) sizeof(MAQxtPrivateTooLarge);
+        (void) sizeof(MAQxtPrivateOveraligned);
+        ::new (storage.data) PVT;
+    }
+    ~MAQxtInlinePrivateInterface()
+    {
+        pvt()->~PVT();
+    }
+
+    inline void setPublic(PUB* pub)
+    {
+        pvt()->MAQXT_setPublic(pub);
+    }
+    inline PVT& operator()()
+    {
+        return *pvt();
+    }
+    inline const PVT& operator()() const
+    {
+        return *pvt();
+    }
+private:
+    // Not copyable, and not defined, like Q_DISABLE_COPY.
+    MAQxtInlinePrivateInterface(const MAQxtInlinePrivateInterface&);
+    MAQxtInlinePrivateInterface& operator=(const MAQxtInlinePrivateInterface&);
+    inline PVT* pvt()
+    {
+        return reinterpret_cast<PVT*>(storage.data);
+    }
+    inline const PVT* pvt() const
+    {
+        return reinterpret_cast<const PVT*>(storage.data);
+    }
+
+    union Storage
+    {
+        char data[SIZE];
+        void* pointer;
+        double real;
+        qint64 integer;
+    } storage;
+};
+
 #endif // MAQXT_GLOBAL
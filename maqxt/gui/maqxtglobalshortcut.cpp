@@ -24,68 +24,1747 @@
  ****************************************************************************/
 #include "maqxtglobalshortcut.h"
 #include "maqxtglobalshortcut_p.h"
+#include "maqxtobjectpool_p.h"
 #include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QIODevice>
+#include <QSet>
+#include <QThread>
+#include <QWaitCondition>
 #include <QtDebug>
+#include <algorithm>
+#include <string.h>
 
-bool MAQxtGlobalShortcutPrivate::error = false;
-#ifndef Q_WS_MAC
+#ifdef MAQXT_NATIVE_EVENT_FILTER
 int MAQxtGlobalShortcutPrivate::ref = 0;
+#if QT_VERSION < 0x050000
 QAbstractEventDispatcher::EventFilter MAQxtGlobalShortcutPrivate::prevEventFilter = 0;
-#endif // Q_WS_MAC
-QHash<QPair<quint32, quint32>, MAQxtGlobalShortcut*> MAQxtGlobalShortcutPrivate::shortcuts;
+#endif
+#endif // MAQXT_NATIVE_EVENT_FILTER
+MAQxtGlobalShortcutTable MAQxtGlobalShortcutPrivate::shortcuts;
+MAQxtGlobalShortcutRegistry MAQxtGlobalShortcutPrivate::registrations;
+QHash<int, quint32> MAQxtGlobalShortcutPrivate::keycodes;
+MAQxtKeycodeCache MAQxtGlobalShortcutPrivate::keycodeCache;
+#if QT_VERSION >= 0x060000
+MAQxtRecursiveMutex MAQxtGlobalShortcutPrivate::mutex;
+#else
+MAQxtRecursiveMutex MAQxtGlobalShortcutPrivate::mutex(QMutex::Recursive);
+#endif
+MAQxtGlobalShortcut::DeliveryMode MAQxtGlobalShortcutPrivate::deliveryMode = MAQxtGlobalShortcut::EventLoopDelivery;
+MAQxtGlobalShortcutStatisticsCollector MAQxtGlobalShortcutPrivate::statistics;
+MAQxtGlobalShortcutTrace MAQxtGlobalShortcutPrivate::trace;
+MAQxtGlobalShortcutTrie MAQxtGlobalShortcutPrivate::chordTrie;
+int MAQxtGlobalShortcutPrivate::pendingChord = MAQxtGlobalShortcutTrie::Root;
+QVector<MAQxtGlobalShortcutPrivate::NativeShortcut> MAQxtGlobalShortcutPrivate::chordGrabs;
+QElapsedTimer MAQxtGlobalShortcutPrivate::chordClock;
+int MAQxtGlobalShortcutPrivate::chordTimeout = 1000;
+bool MAQxtGlobalShortcutPrivate::ungrabWhenDisabled = false;
+bool MAQxtGlobalShortcutPrivate::probing = false;
+QSet<quint64> MAQxtGlobalShortcutPrivate::releasedGrabs;
+QSet<quint64> MAQxtGlobalShortcutPrivate::staleGrabs;
+QVector<MAQxtGlobalShortcutPrivate::HeldKey> MAQxtGlobalShortcutPrivate::heldKeys;
+QList<MAQxtGlobalShortcut*> MAQxtGlobalShortcutPrivate::coalescedShortcuts;
+MAQxtRcuPointer<MAQxtGlobalShortcutPrivate::DispatchSnapshot> MAQxtGlobalShortcutPrivate::snapshot;
+bool MAQxtGlobalShortcutPrivate::snapshotStale = true;
+QAtomicInt MAQxtGlobalShortcutPrivate::heldKeyBits[8];
+QAtomicInt MAQxtGlobalShortcutPrivate::heldWideKeys;
+int MAQxtGlobalShortcutPrivate::lockDepth = 0;
+QVector<MAQxtGlobalShortcutPrivate::Emission> MAQxtGlobalShortcutPrivate::pendingEmissions;
+QList<MAQxtGlobalShortcutPrivate::EmissionBatch*> MAQxtGlobalShortcutPrivate::emissionBatches;
+MAQxtKeyState MAQxtGlobalShortcutPrivate::keyState;
+bool MAQxtGlobalShortcutPrivate::keyStateTracked = false;
 
-MAQxtGlobalShortcutPrivate::MAQxtGlobalShortcutPrivate() : enabled(true), key(Qt::Key(0)), mods(Qt::NoModifier)
+// A held key repeats many times a second. A press that follows the last
+// one on the same key after longer than this is taken as a new press, in
+// case the release was never seen.
+static const quint32 qxt_max_repeat_gap = 2000;
+
+// The helper objects below work through the main thread's event loop,
+// but may be created by whichever thread first needs them.
+template <typename T>
+static T* qxt_main_thread_object(T* object)
+{
+    if (QCoreApplication::instance())
+        object->moveToThread(QCoreApplication::instance()->thread());
+    return object;
+}
+
+// Runs the chord timeout on the main thread, which owns it, even when the
+// prefix was typed on a listener thread.
+class MAQxtChordTimer : public QObject
+{
+public:
+    MAQxtChordTimer() : timerId(0) {}
+
+    void arm()
+    {
+        if (QThread::currentThread() == thread())
+            restart();
+        else
+            QCoreApplication::postEvent(this, new QEvent(armEvent));
+    }
+
+protected:
+    bool event(QEvent* event)
+    {
+        if (event->type() != armEvent)
+            return QObject::event(event);
+        restart();
+        return true;
+    }
+
+    void timerEvent(QTimerEvent* event)
+    {
+        Q_UNUSED(event);
+        killTimer(timerId);
+        timerId = 0;
+        MAQxtGlobalShortcutPrivate::chordTimedOut();
+    }
+
+private:
+    void restart()
+    {
+        if (timerId)
+            killTimer(timerId);
+        timerId = startTimer(MAQxtGlobalShortcutPrivate::chordTimeout);
+    }
+
+    static const QEvent::Type armEvent;
+    int timerId;
+};
+
+const QEvent::Type MAQxtChordTimer::armEvent = QEvent::Type(QEvent::registerEventType());
+static MAQxtChordTimer* qxt_chord_timer = 0;
+
+// Brings native grabs in line with the enabled state once per event loop
+// iteration, so that a burst of enable and disable calls costs one update.
+class MAQxtGrabSync : public QObject
+{
+public:
+    MAQxtGrabSync() : pending(false) {}
+
+    // Called with MAQxtGlobalShortcutPrivate::mutex held.
+    void schedule()
+    {
+        if (pending)
+            return;
+        pending = true;
+        QCoreApplication::postEvent(this, new QEvent(syncEvent));
+    }
+
+protected:
+    bool event(QEvent* event)
+    {
+        if (event->type() != syncEvent)
+            return QObject::event(event);
+        MAQxtGlobalShortcutPrivate::syncGrabs();
+        return true;
+    }
+
+private:
+    friend class MAQxtGlobalShortcutPrivate;
+    static const QEvent::Type syncEvent;
+    bool pending;
+};
+
+const QEvent::Type MAQxtGrabSync::syncEvent = QEvent::Type(QEvent::registerEventType());
+static MAQxtGrabSync* qxt_grab_sync = 0;
+
+// Emits coalesced auto-repeats from the main thread's event loop, once it
+// has worked through the native events queued meanwhile.
+class MAQxtRepeatCoalescer : public QObject
+{
+public:
+    MAQxtRepeatCoalescer() : pending(false) {}
+
+    // Called with MAQxtGlobalShortcutPrivate::mutex held.
+    void schedule()
+    {
+        if (pending)
+            return;
+        pending = true;
+        QCoreApplication::postEvent(this, new QEvent(flushEvent));
+    }
+
+protected:
+    bool event(QEvent* event)
+    {
+        if (event->type() != flushEvent)
+            return QObject::event(event);
+        MAQxtGlobalShortcutPrivate::flushCoalescedRepeats();
+        return true;
+    }
+
+private:
+    friend class MAQxtGlobalShortcutPrivate;
+    static const QEvent::Type flushEvent;
+    bool pending;
+};
+
+const QEvent::Type MAQxtRepeatCoalescer::flushEvent = QEvent::Type(QEvent::registerEventType());
+static MAQxtRepeatCoalescer* qxt_repeat_coalescer = 0;
+
+// Serializes MAQxtGlobalShortcut::setDeliveryMode().
+static QMutex qxt_delivery_mode_mutex;
+
+// Guards EmissionBatch::current, which the emitting thread clears without
+// the shortcut mutex; every emission done is counted and announced.
+static QMutex qxt_emission_mutex;
+static QWaitCondition qxt_emission_done;
+static quint64 qxt_emissions_done = 0;
+
+static MAQxtObjectPool<MAQxtGlobalShortcutPrivate> qxt_private_pool;
+// Guards qxt_private_pool. The mutex is constructed dynamically and may not
+// exist yet when a static shortcut is created; this spin lock is constant
+// initialized, and only held for a few pointer moves.
+static QBasicAtomicInt qxt_private_pool_lock = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+class MAQxtPoolLocker
+{
+public:
+    MAQxtPoolLocker()
+    {
+        while (!qxt_private_pool_lock.testAndSetAcquire(0, 1))
+            QThread::yieldCurrentThread();
+    }
+
+    ~MAQxtPoolLocker()
+    {
+        qxt_private_pool_lock.fetchAndStoreRelease(0);
+    }
+};
+
+#ifdef MAQXT_NATIVE_EVENT_FILTER
+#if QT_VERSION >= 0x050000
+// The only kind of event the backend's eventFilter() knows how to read.
+// Other platform plugins, Qt 6 on Wayland for one, pass other structures.
+#if defined(Q_OS_WIN)
+static const char qxt_native_event_type[] = "windows_generic_MSG";
+#else
+static const char qxt_native_event_type[] = "xcb_generic_event_t";
+#endif
+
+// Qt keeps a list of native filters and calls each in turn, so other
+// filters in the process are unaffected.
+class MAQxtNativeEventFilter : public QAbstractNativeEventFilter
+{
+public:
+#if QT_VERSION >= 0x060000
+    bool nativeEventFilter(const QByteArray& eventType, void* message, qintptr* result)
+#else
+    bool nativeEventFilter(const QByteArray& eventType, void* message, long* result)
+#endif
+    {
+        Q_UNUSED(result);
+        if (eventType != qxt_native_event_type)
+            return false;
+        return MAQxtGlobalShortcutPrivate::eventFilter(message);
+    }
+};
+
+static MAQxtNativeEventFilter qxt_native_event_filter;
+#else
+static bool qxt_filter_chained = false;
+#endif
+// Whether the filter is in place; only touched by the main thread.
+static bool qxt_filter_installed = false;
+
+// Runs syncEventFilter() on the main thread for shortcuts created or
+// destroyed on other threads.
+class MAQxtFilterSync : public QObject
+{
+public:
+    static const QEvent::Type syncEvent;
+
+protected:
+    bool event(QEvent* event)
+    {
+        if (event->type() != syncEvent)
+            return QObject::event(event);
+        MAQxtGlobalShortcutPrivate::syncEventFilter();
+        return true;
+    }
+};
+
+const QEvent::Type MAQxtFilterSync::syncEvent = QEvent::Type(QEvent::registerEventType());
+static MAQxtFilterSync* qxt_filter_sync = 0;
+#endif // MAQXT_NATIVE_EVENT_FILTER
+
+void* MAQxtGlobalShortcutPrivate::operator new(size_t size)
 {
-#ifndef Q_WS_MAC
+    Q_ASSERT(size == sizeof(MAQxtGlobalShortcutPrivate));
+    Q_UNUSED(size);
+    // The pool is not thread-safe, shortcuts may be made on any thread.
+    MAQxtPoolLocker locker;
+    return qxt_private_pool.allocate();
+}
+
+void MAQxtGlobalShortcutPrivate::operator delete(void* pointer)
+{
+    if (!pointer)
+        return;
+    MAQxtPoolLocker locker;
+    qxt_private_pool.release(pointer);
+}
+
+MAQxtGlobalShortcutPrivate::MAQxtGlobalShortcutPrivate() : enabled(true), key(Qt::Key(0)), mods(Qt::NoModifier), activations(0), nextSubscriber(0),
+    repeatPolicy(MAQxtGlobalShortcut::AllowRepeats), repeatInterval(500), lastActivation(0), pendingRepeats(0), repeatCount(0), coalescing(false),
+    passive(false)
+{
+#ifdef MAQXT_NATIVE_EVENT_FILTER
+    MAQxtGlobalShortcutLocker locker;
     if (!ref++)
-        prevEventFilter = QAbstractEventDispatcher::instance()->setEventFilter(eventFilter);
-#endif // Q_WS_MAC
+        scheduleFilterSync();
+#endif // MAQXT_NATIVE_EVENT_FILTER
 }
 
 MAQxtGlobalShortcutPrivate::~MAQxtGlobalShortcutPrivate()
 {
-#ifndef Q_WS_MAC
+    MAQxtGlobalShortcutLocker locker;
+    if (coalescing)
+        dropRepeatState();
+#ifdef MAQXT_NATIVE_EVENT_FILTER
     if (!--ref)
-        QAbstractEventDispatcher::instance()->setEventFilter(prevEventFilter);
-#endif // Q_WS_MAC
+        scheduleFilterSync();
+#endif // MAQXT_NATIVE_EVENT_FILTER
 }
 
-bool MAQxtGlobalShortcutPrivate::setShortcut(const QKeySequence& shortcut)
+#ifdef MAQXT_NATIVE_EVENT_FILTER
+void MAQxtGlobalShortcutPrivate::scheduleFilterSync()
 {
-    Qt::KeyboardModifiers allMods = Qt::ShiftModifier | Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier;
-    key = shortcut.isEmpty() ? Qt::Key(0) : Qt::Key((shortcut[0] ^ allMods) & shortcut[0]);
-    mods = shortcut.isEmpty() ? Qt::KeyboardModifiers(0) : Qt::KeyboardModifiers(shortcut[0] & allMods);
-    const quint32 nativeKey = nativeKeycode(key);
-    const quint32 nativeMods = nativeModifiers(mods);
-    const bool res = registerShortcut(nativeKey, nativeMods);
-    if (res)
-        shortcuts.insert(qMakePair(nativeKey, nativeMods), &qxt_p());
+    QCoreApplication* application = QCoreApplication::instance();
+    if (!application)
+        return;
+    if (QThread::currentThread() == application->thread())
+    {
+        syncEventFilter();
+        return;
+    }
+    // Key events are only dispatched by the main thread, so none is missed
+    // that the filter could have seen; grabs made meanwhile are served once
+    // the event has been handled.
+    if (!qxt_filter_sync)
+        qxt_filter_sync = qxt_main_thread_object(new MAQxtFilterSync);
+    QCoreApplication::postEvent(qxt_filter_sync, new QEvent(MAQxtFilterSync::syncEvent));
+}
+
+void MAQxtGlobalShortcutPrivate::syncEventFilter()
+{
+    MAQxtGlobalShortcutLocker locker;
+    if ((ref > 0) == qxt_filter_installed)
+        return;
+    qxt_filter_installed = ref > 0;
+    if (qxt_filter_installed)
+    {
+#if QT_VERSION >= 0x050000
+        QCoreApplication::instance()->installNativeEventFilter(&qxt_native_event_filter);
+#else
+        // The filter may still be in the chain from an earlier round, kept
+        // there by a filter that was installed after it.
+        if (!qxt_filter_chained)
+            prevEventFilter = QAbstractEventDispatcher::instance()->setEventFilter(chainEventFilter);
+        qxt_filter_chained = true;
+#endif
+        return;
+    }
+#if QT_VERSION >= 0x050000
+    if (QCoreApplication::instance())
+        QCoreApplication::instance()->removeNativeEventFilter(&qxt_native_event_filter);
+#else
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    if (dispatcher)
+    {
+        // Only unhook when nobody has chained to us since; restoring
+        // the old filter would cut off the later one.
+        QAbstractEventDispatcher::EventFilter current = dispatcher->setEventFilter(prevEventFilter);
+        if (current == chainEventFilter)
+            qxt_filter_chained = false;
+        else
+            dispatcher->setEventFilter(current);
+    }
+#endif
+}
+
+#if QT_VERSION < 0x050000
+bool MAQxtGlobalShortcutPrivate::chainEventFilter(void* message)
+{
+    // While no shortcut exists the backend has nothing grabbed, so the
+    // filter only passes events on.
+    if (qxt_filter_installed && eventFilter(message))
+        return true;
+    return prevEventFilter ? prevEventFilter(message) : false;
+}
+#endif
+#endif // MAQXT_NATIVE_EVENT_FILTER
+
+void MAQxtGlobalShortcutPrivate::splitChord(int chord, Qt::Key& key, Qt::KeyboardModifiers& mods)
+{
+    Qt::KeyboardModifiers allMods = Qt::ShiftModifier | Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier | Qt::KeypadModifier;
+    key = Qt::Key((chord ^ allMods) & chord);
+    mods = Qt::KeyboardModifiers(chord & allMods);
+}
+
+quint64 MAQxtGlobalShortcutPrivate::nativeCombination(Qt::Key key, Qt::KeyboardModifiers mods) const
+{
+    return MAQxtGlobalShortcutTable::pack(cachedNativeKeycode(key, mods), nativeModifiers(mods) | (passive ? PassiveFlag : 0));
+}
+
+void MAQxtGlobalShortcutPrivate::splitShortcut(const QKeySequence& shortcut, Qt::Key& key, Qt::KeyboardModifiers& mods)
+{
+    if (shortcut.isEmpty())
+    {
+        key = Qt::Key(0);
+        mods = Qt::KeyboardModifiers(0);
+    }
     else
+        splitChord(chordAt(shortcut, 0), key, mods);
+}
+
+bool MAQxtGlobalShortcutPrivate::setShortcut(const QKeySequence& shortcut)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (shortcut.count() > 1)
+        return setChordShortcut(shortcut);
+    splitShortcut(shortcut, key, mods);
+    // An empty sequence leaves the shortcut unset.
+    if (key == 0)
+        return false;
+    QVector<SubscriptionMove> moves(1);
+    moves[0].shortcut = &qxt_p();
+    moves[0].to = nativeCombination(key, mods);
+    moves[0].leaves = false;
+    moves[0].joins = true;
+    moves[0].ok = false;
+    moveSubscriptions(moves, false);
+    if (!moves[0].ok)
         qWarning() << "MAQxtGlobalShortcut failed to register:" << QKeySequence(key + mods).toString();
-    return res;
+    return moves[0].ok;
+}
+
+void MAQxtGlobalShortcutPrivate::setEnabled(bool enabled)
+{
+    MAQxtGlobalShortcutLocker locker;
+    this->enabled = enabled;
+    if (key != 0 && chords.isEmpty())
+        updateEnabledFlag(nativeCombination(key, mods));
 }
 
 bool MAQxtGlobalShortcutPrivate::unsetShortcut()
 {
-    bool res = false;
-    const quint32 nativeKey = nativeKeycode(key);
-    const quint32 nativeMods = nativeModifiers(mods);
-    if (shortcuts.value(qMakePair(nativeKey, nativeMods)) == &qxt_p())
-        res = unregisterShortcut(nativeKey, nativeMods);
-    if (res)
-        shortcuts.remove(qMakePair(nativeKey, nativeMods));
-    else
+    MAQxtGlobalShortcutLocker locker;
+    dropRepeatState();
+    if (!chords.isEmpty())
+        return unsetChordShortcut();
+    QVector<SubscriptionMove> moves(1);
+    moves[0].shortcut = &qxt_p();
+    moves[0].from = nativeCombination(key, mods);
+    moves[0].leaves = isSubscribed(moves[0].from, &qxt_p());
+    moves[0].joins = false;
+    moves[0].ok = false;
+    if (moves[0].leaves)
+        moveSubscriptions(moves, false);
+    if (!moves[0].ok)
         qWarning() << "MAQxtGlobalShortcut failed to unregister:" << QKeySequence(key + mods).toString();
     key = Qt::Key(0);
     mods = Qt::KeyboardModifiers(0);
+    return moves[0].ok;
+}
+
+// Shortcuts bound to the same native combination form a list through
+// nextSubscriber, headed by the table entry. The entry counts as enabled
+// while any of them is.
+bool MAQxtGlobalShortcutPrivate::isSubscribed(quint64 key, const MAQxtGlobalShortcut* shortcut)
+{
+    for (MAQxtGlobalShortcut* s = shortcuts.value(key); s; s = s->qxt_d().nextSubscriber)
+    {
+        if (s == shortcut)
+            return true;
+    }
+    return false;
+}
+
+int MAQxtGlobalShortcutPrivate::subscriberCount(quint64 key)
+{
+    int count = 0;
+    for (MAQxtGlobalShortcut* s = shortcuts.value(key); s; s = s->qxt_d().nextSubscriber)
+        ++count;
+    return count;
+}
+
+void MAQxtGlobalShortcutPrivate::subscribe(quint64 key, MAQxtGlobalShortcut* shortcut)
+{
+    shortcut->qxt_d().nextSubscriber = 0;
+    MAQxtGlobalShortcut* last = shortcuts.value(key);
+    if (!last)
+        shortcuts.insert(key, shortcut, shortcut->qxt_d().enabled);
+    else
+    {
+        while (last->qxt_d().nextSubscriber)
+            last = last->qxt_d().nextSubscriber;
+        last->qxt_d().nextSubscriber = shortcut;
+    }
+    updateEnabledFlag(key);
+}
+
+bool MAQxtGlobalShortcutPrivate::unsubscribe(quint64 key, MAQxtGlobalShortcut* shortcut)
+{
+    MAQxtGlobalShortcut* head = shortcuts.value(key);
+    if (head == shortcut)
+    {
+        MAQxtGlobalShortcut* next = shortcut->qxt_d().nextSubscriber;
+        shortcut->qxt_d().nextSubscriber = 0;
+        if (next)
+        {
+            shortcuts.insert(key, next, next->qxt_d().enabled);
+            updateEnabledFlag(key);
+        }
+        else
+        {
+            shortcuts.remove(key);
+            invalidateSnapshot();
+        }
+        return true;
+    }
+    for (MAQxtGlobalShortcut* s = head; s; s = s->qxt_d().nextSubscriber)
+    {
+        MAQxtGlobalShortcutPrivate& d = s->qxt_d();
+        if (d.nextSubscriber == shortcut)
+        {
+            d.nextSubscriber = shortcut->qxt_d().nextSubscriber;
+            shortcut->qxt_d().nextSubscriber = 0;
+            updateEnabledFlag(key);
+            return true;
+        }
+    }
+    return false;
+}
+
+void MAQxtGlobalShortcutPrivate::dropSubscribers(quint64 key)
+{
+    MAQxtGlobalShortcut* s = shortcuts.value(key);
+    while (s)
+    {
+        MAQxtGlobalShortcut* next = s->qxt_d().nextSubscriber;
+        s->qxt_d().nextSubscriber = 0;
+        s = next;
+    }
+    shortcuts.remove(key);
+    releasedGrabs.remove(key);
+    invalidateSnapshot();
+}
+
+void MAQxtGlobalShortcutPrivate::updateEnabledFlag(quint64 key)
+{
+    MAQxtGlobalShortcut* head = shortcuts.value(key);
+    bool enabled = false;
+    for (MAQxtGlobalShortcut* s = head; s && !enabled; s = s->qxt_d().nextSubscriber)
+        enabled = s->qxt_d().enabled;
+    if (head)
+        shortcuts.setEnabled(key, head, enabled);
+    invalidateSnapshot();
+    if (ungrabWhenDisabled)
+        scheduleGrabSync(key);
+}
+
+void MAQxtGlobalShortcutPrivate::scheduleGrabSync(quint64 key)
+{
+    staleGrabs.insert(key);
+    if (qxt_grab_sync)
+        qxt_grab_sync->schedule();
+}
+
+void MAQxtGlobalShortcutPrivate::syncGrabs()
+{
+    MAQxtGlobalShortcutLocker locker;
+    qxt_grab_sync->pending = false;
+
+    // Only the net difference reaches the server; a shortcut disabled and
+    // enabled again since the last sync costs nothing.
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> grabs;
+    foreach (quint64 key, staleGrabs)
+    {
+        const MAQxtGlobalShortcutTable::Entry* entry = shortcuts.find(key);
+        if (!entry)
+            continue;
+        const bool wanted = !ungrabWhenDisabled || entry->isEnabled();
+        const bool released = releasedGrabs.contains(key);
+        if (wanted == !released)
+            continue;
+        NativeShortcut native;
+        native.key = entry->nativeKey();
+        native.mods = entry->nativeMods();
+        native.ok = false;
+        if (wanted)
+            grabs.append(native);
+        else
+            ungrabs.append(native);
+    }
+    staleGrabs.clear();
+    if (ungrabs.isEmpty() && grabs.isEmpty())
+        return;
+
+    {
+        MAQxtRegistrationTimer timer(statistics, ungrabs.size() + grabs.size());
+        updateShortcuts(ungrabs, grabs);
+    }
+    foreach (const NativeShortcut& ungrab, ungrabs)
+    {
+        if (ungrab.ok)
+            releasedGrabs.insert(MAQxtGlobalShortcutTable::pack(ungrab.key, ungrab.mods));
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok)
+            releasedGrabs.remove(MAQxtGlobalShortcutTable::pack(grab.key, grab.mods));
+        else
+            qWarning() << "MAQxtGlobalShortcut failed to re-register native shortcut" << grab.key << grab.mods;
+    }
+}
+
+bool MAQxtGlobalShortcutPrivate::moveSubscriptions(QVector<SubscriptionMove>& moves, bool atomic)
+{
+    // Net change of subscribers per combination; only a combination that
+    // gains its first or loses its last subscriber needs the server.
+    QHash<quint64, int> balance;
+    foreach (const SubscriptionMove& move, moves)
+    {
+        if (move.leaves)
+            --balance[move.from];
+        if (move.joins)
+            ++balance[move.to];
+    }
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> grabs;
+    QSet<quint64> failed;
+    for (QHash<quint64, int>::const_iterator it = balance.constBegin(); it != balance.constEnd(); ++it)
+    {
+        const int before = subscriberCount(it.key());
+        const int after = before + it.value();
+        NativeShortcut native;
+        native.key = quint32(it.key() >> 32);
+        native.mods = quint32(it.key());
+        native.ok = false;
+        if (before > 0 && after == 0)
+        {
+            // Nothing to release if the grab was dropped while disabled.
+            if (!releasedGrabs.remove(it.key()))
+                ungrabs.append(native);
+        }
+        else if (before == 0 && after > 0)
+        {
+            // Keycode 0 is a key sequence without a key in the layout; the
+            // window system would take it for any key. The first chord of a
+            // multi-chord shortcut is grabbed already.
+            if (!native.key || chordTrie.child(MAQxtGlobalShortcutTrie::Root, it.key()) != MAQxtGlobalShortcutTrie::None)
+                failed.insert(it.key());
+            else
+                grabs.append(native);
+        }
+    }
+    if (!ungrabs.isEmpty() || !grabs.isEmpty())
+    {
+        MAQxtRegistrationTimer timer(statistics, ungrabs.size() + grabs.size());
+        updateShortcuts(ungrabs, grabs);
+    }
+    QSet<quint64> failedUngrabs;
+    foreach (const NativeShortcut& ungrab, ungrabs)
+    {
+        if (!ungrab.ok)
+            failedUngrabs.insert(MAQxtGlobalShortcutTable::pack(ungrab.key, ungrab.mods));
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (!grab.ok)
+            failed.insert(MAQxtGlobalShortcutTable::pack(grab.key, grab.mods));
+    }
+
+    if (atomic && !failed.isEmpty())
+    {
+        // Undo what did succeed and put back what was released.
+        QVector<NativeShortcut> rollbackUngrabs;
+        QVector<NativeShortcut> rollbackGrabs;
+        foreach (const NativeShortcut& grab, grabs)
+        {
+            if (grab.ok)
+                rollbackUngrabs.append(grab);
+        }
+        foreach (const NativeShortcut& ungrab, ungrabs)
+        {
+            if (ungrab.ok)
+                rollbackGrabs.append(ungrab);
+        }
+        {
+            MAQxtRegistrationTimer timer(statistics, rollbackUngrabs.size() + rollbackGrabs.size());
+            updateShortcuts(rollbackUngrabs, rollbackGrabs);
+        }
+        foreach (const NativeShortcut& grab, rollbackGrabs)
+        {
+            if (!grab.ok)
+                qWarning() << "MAQxtGlobalShortcut failed to restore native shortcut" << grab.key << grab.mods;
+        }
+        for (int i = 0; i < moves.size(); ++i)
+            moves[i].ok = !moves.at(i).joins || !failed.contains(moves.at(i).to);
+        return false;
+    }
+
+    // Leave first, so a combination moved between shortcuts keeps its grab.
+    for (int i = 0; i < moves.size(); ++i)
+    {
+        SubscriptionMove& move = moves[i];
+        move.ok = true;
+        if (move.leaves)
+        {
+            unsubscribe(move.from, move.shortcut);
+            move.ok = !failedUngrabs.contains(move.from);
+        }
+    }
+    for (int i = 0; i < moves.size(); ++i)
+    {
+        SubscriptionMove& move = moves[i];
+        if (!move.joins)
+            continue;
+        move.ok = !failed.contains(move.to);
+        if (move.ok)
+            subscribe(move.to, move.shortcut);
+    }
+    return failed.isEmpty();
+}
+
+QVector<quint64> MAQxtGlobalShortcutPrivate::nativeChords(const QKeySequence& shortcut)
+{
+    QVector<quint64> path(shortcut.count());
+    for (int i = 0; i < path.size(); ++i)
+    {
+        Qt::Key key;
+        Qt::KeyboardModifiers mods;
+        splitChord(chordAt(shortcut, i), key, mods);
+        const quint32 nativeKey = cachedNativeKeycode(key, mods);
+        if (!nativeKey)
+            return QVector<quint64>();
+        path[i] = MAQxtGlobalShortcutTable::pack(nativeKey, nativeModifiers(mods));
+    }
+    return path;
+}
+
+bool MAQxtGlobalShortcutPrivate::setChordShortcut(const QKeySequence& shortcut)
+{
+    splitShortcut(shortcut, key, mods);
+    chords = shortcut;
+    const QVector<quint64> path = nativeChords(shortcut);
+    // The following chords are grabbed while a prefix is pending, which
+    // passive shortcuts must not do.
+    bool res = !passive && !path.isEmpty() && !shortcuts.find(path.first());
+    if (res)
+    {
+        cancelChord();
+        const bool grab = chordTrie.child(MAQxtGlobalShortcutTrie::Root, path.first()) == MAQxtGlobalShortcutTrie::None;
+        res = chordTrie.insert(path, &qxt_p());
+        if (res && grab)
+        {
+            MAQxtRegistrationTimer timer(statistics, 1);
+            res = registerShortcut(quint32(path.first() >> 32), quint32(path.first()));
+            if (!res)
+                chordTrie.remove(path, &qxt_p());
+        }
+        invalidateSnapshot();
+    }
+    if (res && !qxt_chord_timer)
+        qxt_chord_timer = qxt_main_thread_object(new MAQxtChordTimer);
+    if (!res)
+        qWarning() << "MAQxtGlobalShortcut failed to register:" << shortcut.toString();
+    return res;
+}
+
+bool MAQxtGlobalShortcutPrivate::unsetChordShortcut()
+{
+    const QVector<quint64> path = nativeChords(chords);
+    cancelChord();
+    bool res = !path.isEmpty() && chordTrie.remove(path, &qxt_p());
+    invalidateSnapshot();
+    if (res && chordTrie.child(MAQxtGlobalShortcutTrie::Root, path.first()) == MAQxtGlobalShortcutTrie::None)
+    {
+        MAQxtRegistrationTimer timer(statistics, 1);
+        res = unregisterShortcut(quint32(path.first() >> 32), quint32(path.first()));
+    }
+    if (!res)
+        qWarning() << "MAQxtGlobalShortcut failed to unregister:" << chords.toString();
+    key = Qt::Key(0);
+    mods = Qt::KeyboardModifiers(0);
+    chords = QKeySequence();
+    return res;
+}
+
+bool MAQxtGlobalShortcutPrivate::dispatchChord(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    const quint64 chord = MAQxtGlobalShortcutTable::pack(nativeKey, nativeMods);
+    int node = chordTrie.child(pendingChord, chord);
+    if (node == MAQxtGlobalShortcutTrie::None && pendingChord != MAQxtGlobalShortcutTrie::Root)
+    {
+        // Anything else typed while a prefix is pending starts over.
+        cancelChord();
+        node = chordTrie.child(MAQxtGlobalShortcutTrie::Root, chord);
+    }
+    if (node == MAQxtGlobalShortcutTrie::None)
+        return false;
+
+    MAQxtGlobalShortcut* shortcut = chordTrie.shortcut(node);
+    if (!shortcut)
+    {
+        advanceChord(node);
+        return true;
+    }
+    cancelChord();
+    MAQxtGlobalShortcutPrivate& d = shortcut->qxt_d();
+    if (!d.enabled)
+        return true;
+    if (statistics.enabled)
+    {
+        const qint64 age = nativeEventAge(eventTime);
+        if (age >= 0)
+            statistics.addLatency(age);
+    }
+    if (nativeReleaseEvents())
+    {
+        const HeldKey held = { nativeKey, false, 0, shortcut, eventTime, eventTime };
+        heldKeys.append(held);
+        updateHeldKeyBits();
+    }
+    d.notify(PressEvent, eventTime, 0);
+    return true;
+}
+
+void MAQxtGlobalShortcutPrivate::advanceChord(int node)
+{
+    // Trade the grabs of the previous level for the chords that may follow
+    // this one, except those grabbed for good anyway.
+    QVector<NativeShortcut> ungrabs = chordGrabs;
+    QVector<NativeShortcut> grabs;
+    foreach (quint64 chord, chordTrie.chords(node))
+    {
+        if ((shortcuts.find(chord) && !releasedGrabs.contains(chord))
+            || chordTrie.child(MAQxtGlobalShortcutTrie::Root, chord) != MAQxtGlobalShortcutTrie::None)
+            continue;
+        NativeShortcut grab;
+        grab.key = quint32(chord >> 32);
+        grab.mods = quint32(chord);
+        grab.ok = false;
+        grabs.append(grab);
+    }
+    {
+        MAQxtRegistrationTimer timer(statistics, ungrabs.size() + grabs.size());
+        updateShortcuts(ungrabs, grabs);
+    }
+    chordGrabs.clear();
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok)
+            chordGrabs.append(grab);
+    }
+    pendingChord = node;
+    invalidateSnapshot();
+    chordClock.start();
+    if (qxt_chord_timer)
+        qxt_chord_timer->arm();
+}
+
+void MAQxtGlobalShortcutPrivate::cancelChord()
+{
+    if (pendingChord == MAQxtGlobalShortcutTrie::Root)
+        return;
+    pendingChord = MAQxtGlobalShortcutTrie::Root;
+    invalidateSnapshot();
+    if (chordGrabs.isEmpty())
+        return;
+    QVector<NativeShortcut> grabs;
+    MAQxtRegistrationTimer timer(statistics, chordGrabs.size());
+    updateShortcuts(chordGrabs, grabs);
+    chordGrabs.clear();
+}
+
+void MAQxtGlobalShortcutPrivate::chordTimedOut()
+{
+    MAQxtGlobalShortcutLocker locker;
+    // A prefix reached after the timer was armed re-arms it.
+    if (pendingChord != MAQxtGlobalShortcutTrie::Root && chordClock.elapsed() >= chordTimeout)
+        cancelChord();
+}
+
+void MAQxtGlobalShortcutPrivate::rebuildChords()
+{
+    if (chordTrie.isEmpty())
+        return;
+    cancelChord();
+
+    const QList<quint64> oldRoots = chordTrie.chords(MAQxtGlobalShortcutTrie::Root);
+    const QList<MAQxtGlobalShortcut*> owners = chordTrie.shortcuts();
+    QList<QVector<quint64> > paths;
+    chordTrie.clear();
+    invalidateSnapshot();
+    foreach (MAQxtGlobalShortcut* owner, owners)
+    {
+        const QVector<quint64> path = nativeChords(owner->qxt_d().chords);
+        paths.append(path);
+        if (path.isEmpty() || shortcuts.find(path.first()) || !chordTrie.insert(path, owner))
+            qWarning() << "MAQxtGlobalShortcut failed to re-register after a keyboard layout change:"
+                       << owner->qxt_d().chords.toString();
+    }
+
+    const QList<quint64> newRoots = chordTrie.chords(MAQxtGlobalShortcutTrie::Root);
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> grabs;
+    foreach (quint64 chord, oldRoots)
+    {
+        if (newRoots.contains(chord))
+            continue;
+        NativeShortcut ungrab;
+        ungrab.key = quint32(chord >> 32);
+        ungrab.mods = quint32(chord);
+        ungrab.ok = false;
+        ungrabs.append(ungrab);
+    }
+    foreach (quint64 chord, newRoots)
+    {
+        if (oldRoots.contains(chord))
+            continue;
+        NativeShortcut grab;
+        grab.key = quint32(chord >> 32);
+        grab.mods = quint32(chord);
+        grab.ok = false;
+        grabs.append(grab);
+    }
+    if (ungrabs.isEmpty() && grabs.isEmpty())
+        return;
+    {
+        MAQxtRegistrationTimer timer(statistics, ungrabs.size() + grabs.size());
+        updateShortcuts(ungrabs, grabs);
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok)
+            continue;
+        const quint64 chord = MAQxtGlobalShortcutTable::pack(grab.key, grab.mods);
+        for (int i = 0; i < owners.size(); ++i)
+        {
+            if (!paths.at(i).isEmpty() && paths.at(i).first() == chord && chordTrie.remove(paths.at(i), owners.at(i)))
+                qWarning() << "MAQxtGlobalShortcut failed to re-register after a keyboard layout change:"
+                           << owners.at(i)->qxt_d().chords.toString();
+        }
+    }
+}
+
+bool MAQxtGlobalShortcutPrivate::isGrabbedByUs(quint64 chord)
+{
+    if (shortcuts.find(chord) || chordTrie.child(MAQxtGlobalShortcutTrie::Root, chord) != MAQxtGlobalShortcutTrie::None)
+        return true;
+    foreach (const NativeShortcut& grab, chordGrabs)
+    {
+        if (MAQxtGlobalShortcutTable::pack(grab.key, grab.mods) == chord)
+            return true;
+    }
+    return false;
+}
+
+QVector<bool> MAQxtGlobalShortcutPrivate::probeShortcuts(const QList<QKeySequence>& candidates)
+{
+    MAQxtGlobalShortcutLocker locker;
+    // Every distinct native chord is grabbed once, all in one update, and
+    // the grabs that succeeded are released again in a second one.
+    QVector<bool> available(candidates.size(), false);
+    QVector<QVector<quint64> > paths(candidates.size());
+    QHash<quint64, int> probed; // native chord -> index into 'grabs'
+    QVector<NativeShortcut> grabs;
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        if (candidates.at(i).isEmpty())
+            continue;
+        paths[i] = nativeChords(candidates.at(i));
+        // The first chord would be grabbed for good; ours are not free.
+        if (paths.at(i).isEmpty() || isGrabbedByUs(paths.at(i).first()))
+        {
+            paths[i].clear();
+            continue;
+        }
+        foreach (quint64 chord, paths.at(i))
+        {
+            // Chords we hold are left alone, probing would release them.
+            if (probed.contains(chord) || isGrabbedByUs(chord))
+                continue;
+            NativeShortcut grab;
+            grab.key = quint32(chord >> 32);
+            grab.mods = quint32(chord);
+            grab.ok = false;
+            probed.insert(chord, grabs.size());
+            grabs.append(grab);
+        }
+    }
+
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> none;
+    {
+        MAQxtRegistrationTimer timer(statistics, grabs.size());
+        probing = true;
+        updateShortcuts(none, grabs);
+        probing = false;
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok)
+            ungrabs.append(grab);
+    }
+    if (!ungrabs.isEmpty())
+    {
+        MAQxtRegistrationTimer timer(statistics, ungrabs.size());
+        updateShortcuts(ungrabs, none);
+    }
+
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        if (paths.at(i).isEmpty())
+            continue;
+        available[i] = true;
+        foreach (quint64 chord, paths.at(i))
+        {
+            const int index = probed.value(chord, -1);
+            if (index >= 0 && !grabs.at(index).ok)
+                available[i] = false;
+        }
+    }
+    return available;
+}
+
+namespace
+{
+    // Start and end state of a shortcut touched by a batch.
+    struct MAQxtBatchState
+    {
+        MAQxtGlobalShortcut* shortcut;
+        Qt::Key key;
+        Qt::KeyboardModifiers mods;
+        QKeySequence sequence;
+        bool enabled;
+        Qt::Key newKey;
+        Qt::KeyboardModifiers newMods;
+        QKeySequence newSequence;
+        bool newEnabled;
+        bool chorded;   // multi-chord before or after; applied one by one
+        bool chordOk;
+        int lastChange; // last Set/Unset operation
+        int move;       // index into the subscription moves or -1
+    };
+}
+
+bool MAQxtGlobalShortcutPrivate::applyBatch(QVector<BatchOperation>& operations, bool atomic)
+{
+    MAQxtGlobalShortcutLocker locker;
+
+    // Fold the operations into one final state per shortcut, so that a
+    // shortcut changed several times costs a single native update.
+    QVector<MAQxtBatchState> states;
+    QHash<MAQxtGlobalShortcut*, int> stateIndex;
+    QVector<int> operationState(operations.size());
+    for (int i = 0; i < operations.size(); ++i)
+    {
+        const BatchOperation& op = operations.at(i);
+        int index = stateIndex.value(op.shortcut, -1);
+        if (index < 0)
+        {
+            const MAQxtGlobalShortcutPrivate& d = op.shortcut->qxt_d();
+            MAQxtBatchState state;
+            state.shortcut = op.shortcut;
+            state.key = state.newKey = d.key;
+            state.mods = state.newMods = d.mods;
+            state.enabled = state.newEnabled = d.enabled;
+            state.sequence = state.newSequence = op.shortcut->shortcut();
+            state.chorded = !d.chords.isEmpty();
+            state.chordOk = true;
+            state.lastChange = state.move = -1;
+            index = states.size();
+            states.append(state);
+            stateIndex.insert(op.shortcut, index);
+        }
+        operationState[i] = index;
+
+        MAQxtBatchState& state = states[index];
+        switch (op.type)
+        {
+        case BatchOperation::Set:
+            splitShortcut(op.sequence, state.newKey, state.newMods);
+            state.newSequence = op.sequence;
+            state.chorded |= op.sequence.count() > 1;
+            state.lastChange = i;
+            break;
+        case BatchOperation::Unset:
+            state.newKey = Qt::Key(0);
+            state.newMods = Qt::KeyboardModifiers(0);
+            state.newSequence = QKeySequence();
+            state.lastChange = i;
+            break;
+        case BatchOperation::Enable:
+            state.newEnabled = op.enabled;
+            break;
+        }
+    }
+
+    QVector<SubscriptionMove> moves;
+    for (int i = 0; i < states.size(); ++i)
+    {
+        MAQxtBatchState& state = states[i];
+        if (state.chorded)
+            continue;
+        SubscriptionMove move;
+        move.shortcut = state.shortcut;
+        move.from = state.shortcut->qxt_d().nativeCombination(state.key, state.mods);
+        move.leaves = state.key != 0 && isSubscribed(move.from, state.shortcut);
+        move.to = state.shortcut->qxt_d().nativeCombination(state.newKey, state.newMods);
+        move.joins = state.newKey != 0;
+        move.ok = false;
+        if (move.leaves && move.joins && move.from == move.to)
+            continue;
+        if (!move.leaves && !move.joins)
+            continue;
+        state.move = moves.size();
+        moves.append(move);
+    }
+
+    bool res = moveSubscriptions(moves, atomic);
+    for (int i = 0; i < operations.size(); ++i)
+    {
+        const MAQxtBatchState& state = states.at(operationState.at(i));
+        operations[i].ok = state.lastChange != i || state.move < 0 || !moves.at(state.move).joins || moves.at(state.move).ok;
+    }
+    if (!res && atomic)
+        return false;
+
+    foreach (const MAQxtBatchState& state, states)
+    {
+        if (state.chorded)
+            continue;
+        if (state.move >= 0 && moves.at(state.move).joins && !moves.at(state.move).ok)
+            qWarning() << "MAQxtGlobalShortcut failed to register:" << QKeySequence(state.newKey + state.newMods).toString();
+        MAQxtGlobalShortcutPrivate& d = state.shortcut->qxt_d();
+        d.key = state.newKey;
+        d.mods = state.newMods;
+        d.setEnabled(state.newEnabled);
+    }
+
+    // Multi-chord shortcuts share their grabs through the trie and cannot
+    // be folded into the native update above.
+    int applied = 0;
+    for (; applied < states.size(); ++applied)
+    {
+        MAQxtBatchState& state = states[applied];
+        if (!state.chorded)
+            continue;
+        MAQxtGlobalShortcutPrivate& d = state.shortcut->qxt_d();
+        if (state.lastChange >= 0 && state.newSequence != state.shortcut->shortcut())
+        {
+            if (d.key != 0)
+                d.unsetShortcut();
+            if (!state.newSequence.isEmpty())
+                state.chordOk = d.setShortcut(state.newSequence);
+            res &= state.chordOk;
+        }
+        d.setEnabled(state.newEnabled);
+        if (!state.chordOk && atomic)
+        {
+            ++applied;
+            break;
+        }
+    }
+    for (int i = 0; i < operations.size(); ++i)
+    {
+        const MAQxtBatchState& state = states.at(operationState.at(i));
+        if (state.chorded && state.lastChange == i)
+            operations[i].ok = state.chordOk;
+    }
+    if (res || !atomic)
+        return res;
+
+    // A multi-chord shortcut failed after the rest had been switched; put
+    // every shortcut touched so far back the way it was.
+    while (applied-- > 0)
+    {
+        const MAQxtBatchState& state = states.at(applied);
+        if (!state.chorded)
+            continue;
+        MAQxtGlobalShortcutPrivate& d = state.shortcut->qxt_d();
+        if (state.sequence != state.shortcut->shortcut())
+        {
+            if (d.key != 0)
+                d.unsetShortcut();
+            if (!state.sequence.isEmpty() && !d.setShortcut(state.sequence))
+                qWarning() << "MAQxtGlobalShortcut failed to restore:" << state.sequence.toString();
+        }
+        d.setEnabled(state.enabled);
+    }
+    QVector<SubscriptionMove> undo;
+    foreach (const MAQxtBatchState& state, states)
+    {
+        if (state.move < 0)
+            continue;
+        // Restore the enabled flag while the new combination still has
+        // its subscriber, then move the subscription back.
+        state.shortcut->qxt_d().setEnabled(state.enabled);
+        const SubscriptionMove& move = moves.at(state.move);
+        SubscriptionMove back;
+        back.shortcut = move.shortcut;
+        back.from = move.to;
+        back.leaves = move.joins && move.ok;
+        back.to = move.from;
+        back.joins = move.leaves;
+        back.ok = false;
+        undo.append(back);
+    }
+    moveSubscriptions(undo, false);
+    foreach (const SubscriptionMove& back, undo)
+    {
+        if (back.joins && !back.ok)
+            qWarning() << "MAQxtGlobalShortcut failed to restore native shortcut" << quint32(back.to >> 32) << quint32(back.to);
+    }
+    foreach (const MAQxtBatchState& state, states)
+    {
+        if (state.chorded)
+            continue;
+        MAQxtGlobalShortcutPrivate& d = state.shortcut->qxt_d();
+        d.key = state.key;
+        d.mods = state.mods;
+        d.setEnabled(state.enabled);
+    }
+    return false;
+}
+
+quint32 MAQxtGlobalShortcutPrivate::cachedNativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers)
+{
+    // Keypad keys share their Qt::Key with the main block and resolve differently.
+    const int id = key | (modifiers & Qt::KeypadModifier);
+    QHash<int, quint32>::const_iterator it = keycodes.constFind(id);
+    if (it != keycodes.constEnd())
+        return it.value();
+    quint32 native;
+    if (!keycodeCache.find(id, native))
+    {
+        native = nativeKeycode(key, modifiers);
+        keycodeCache.insert(id, native);
+    }
+    keycodes.insert(id, native);
+    return native;
+}
+
+bool MAQxtGlobalShortcutPrivate::isKeyPressed(Qt::Key key)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (!keyStateTracked)
+        return false;
+    const quint32 nativeKey = cachedNativeKeycode(key, Qt::NoModifier);
+    return nativeKey && keyState.isPressed(nativeKey);
+}
+
+bool MAQxtGlobalShortcutPrivate::setKeycodeCacheFile(const QString& fileName)
+{
+    MAQxtGlobalShortcutLocker locker;
+    static bool saveInstalled = false;
+    if (!saveInstalled && !fileName.isEmpty())
+    {
+        qAddPostRoutine(saveKeycodeCache);
+        saveInstalled = true;
+    }
+    const bool res = keycodeCache.open(fileName, fileName.isEmpty() ? 0 : nativeLayoutFingerprint());
+    // Keycodes resolved before are kept as well.
+    for (QHash<int, quint32>::const_iterator it = keycodes.constBegin(); it != keycodes.constEnd(); ++it)
+    {
+        quint32 native;
+        if (!keycodeCache.find(it.key(), native))
+            keycodeCache.insert(it.key(), it.value());
+    }
     return res;
 }
 
-void MAQxtGlobalShortcutPrivate::activateShortcut(quint32 nativeKey, quint32 nativeMods)
+QString MAQxtGlobalShortcutPrivate::keycodeCacheFile()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return keycodeCache.name();
+}
+
+void MAQxtGlobalShortcutPrivate::saveKeycodeCache()
+{
+    MAQxtGlobalShortcutLocker locker;
+    keycodeCache.close();
+}
+
+Qt::KeyboardModifiers MAQxtGlobalShortcutPrivate::keyboardModifiers()
+{
+    static const Qt::KeyboardModifier modifiers[] = { Qt::ShiftModifier, Qt::ControlModifier, Qt::AltModifier, Qt::MetaModifier };
+    // Cleared while untracked; the tables behind nativeModifiers() are fixed.
+    const quint32 native = keyState.modifiers();
+    Qt::KeyboardModifiers res = Qt::NoModifier;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (native & nativeModifiers(modifiers[i]))
+            res |= modifiers[i];
+    }
+    return res;
+}
+
+void MAQxtGlobalShortcutPrivate::keyboardLayoutChanged()
+{
+    MAQxtGlobalShortcutLocker locker;
+    keycodes.clear();
+    if (keycodeCache.isOpen())
+        keycodeCache.reset(nativeLayoutFingerprint());
+    rebuildChords();
+
+    // Move every shortcut whose key now lives on a different keycode.
+    QVector<SubscriptionMove> moves;
+    foreach (const MAQxtGlobalShortcutTable::Entry& entry, shortcuts.entries())
+    {
+        for (MAQxtGlobalShortcut* s = entry.shortcut; s; s = s->qxt_d().nextSubscriber)
+        {
+            const MAQxtGlobalShortcutPrivate& d = s->qxt_d();
+            SubscriptionMove move;
+            move.shortcut = s;
+            move.from = entry.key & ~MAQxtGlobalShortcutTable::DisabledFlag;
+            move.leaves = true;
+            move.to = d.nativeCombination(d.key, d.mods);
+            move.joins = (move.to >> 32) != 0;
+            move.ok = false;
+            if (move.to == move.from)
+                continue;
+            if (!move.joins)
+                qWarning() << "MAQxtGlobalShortcut: no key for" << QKeySequence(d.key + d.mods).toString() << "in the new keyboard layout";
+            moves.append(move);
+        }
+    }
+    if (moves.isEmpty())
+        return;
+
+    moveSubscriptions(moves, false);
+    foreach (const SubscriptionMove& move, moves)
+    {
+        if (move.joins && !move.ok)
+            qWarning() << "MAQxtGlobalShortcut failed to re-register after a keyboard layout change:"
+                       << QKeySequence(move.shortcut->qxt_d().key + move.shortcut->qxt_d().mods).toString();
+    }
+}
+
+MAQxtGlobalShortcutPrivate::DispatchSnapshot::DispatchSnapshot() : modifierUnion(0), wideKeys(false), statistics(false)
+{
+    memset(keyBits, 0, sizeof(keyBits));
+}
+
+void MAQxtGlobalShortcutPrivate::DispatchSnapshot::add(quint64 combination)
+{
+    const quint32 nativeKey = quint32(combination >> 32);
+    modifierUnion |= quint32(combination);
+    if (nativeKey < 256)
+        keyBits[nativeKey >> 5] |= 1u << (nativeKey & 31);
+    else
+        wideKeys = true;
+}
+
+bool MAQxtGlobalShortcutPrivate::DispatchSnapshot::isChord(quint64 combination) const
+{
+    int low = 0;
+    int high = chords.size();
+    while (low < high)
+    {
+        const int middle = (low + high) / 2;
+        if (chords.at(middle) < combination)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < chords.size() && chords.at(low) == combination;
+}
+
+void MAQxtGlobalShortcutPrivate::lock()
+{
+    mutex.lock();
+    ++lockDepth;
+}
+
+void MAQxtGlobalShortcutPrivate::unlock()
+{
+    if (lockDepth == 1)
+    {
+        // Key events arriving from here on see what the writer changed.
+        if (snapshotStale)
+            publishSnapshot();
+        if (!pendingEmissions.isEmpty())
+            emitPending();
+    }
+    --lockDepth;
+    mutex.unlock();
+}
+
+void MAQxtGlobalShortcutPrivate::emitPending()
+{
+    EmissionBatch batch;
+    batch.thread = QThread::currentThread();
+    batch.emissions = pendingEmissions;
+    batch.current = -1;
+    pendingEmissions.clear();
+    emissionBatches.append(&batch);
+    for (int i = 0; i < batch.emissions.size(); ++i)
+    {
+        const Emission emission = batch.emissions.at(i);
+        if (!emission.shortcut)
+            continue;
+        if (!emission.released)
+            emission.shortcut->qxt_d().repeatCount = emission.value;
+        qxt_emission_mutex.lock();
+        batch.current = i;
+        qxt_emission_mutex.unlock();
+        --lockDepth;
+        mutex.unlock();
+        // Receivers that change shortcuts emit what they cause themselves.
+        if (emission.released)
+            emit emission.shortcut->released(emission.value);
+        else
+            emit emission.shortcut->activated();
+        qxt_emission_mutex.lock();
+        batch.current = -1;
+        ++qxt_emissions_done;
+        qxt_emission_done.wakeAll();
+        qxt_emission_mutex.unlock();
+        mutex.lock();
+        ++lockDepth;
+    }
+    emissionBatches.removeOne(&batch);
+}
+
+void MAQxtGlobalShortcutPrivate::dropEmissions(MAQxtGlobalShortcut* shortcut)
+{
+    // Waiting lets go of the mutex, which callers further out would not
+    // expect.
+    Q_ASSERT_X(lockDepth == 1, "MAQxtGlobalShortcut", "deleted with the shortcut mutex held");
+    for (;;)
+    {
+        for (int i = 0; i < pendingEmissions.size(); ++i)
+        {
+            if (pendingEmissions.at(i).shortcut == shortcut)
+                pendingEmissions[i].shortcut = 0;
+        }
+        QMutexLocker emissionLocker(&qxt_emission_mutex);
+        bool busy = false;
+        foreach (EmissionBatch* batch, emissionBatches)
+        {
+            for (int i = 0; i < batch->emissions.size(); ++i)
+            {
+                if (batch->emissions.at(i).shortcut != shortcut)
+                    continue;
+                // A receiver on this thread deleting the shortcut returns
+                // to an emitter that does not touch it any more.
+                if (i == batch->current && batch->thread != QThread::currentThread())
+                    busy = true;
+                else
+                    batch->emissions[i].shortcut = 0;
+            }
+        }
+        if (!busy)
+            return;
+        // The receiver may need the mutex; it is given up entirely until
+        // an emission is done, and the batches looked at again after.
+        const quint64 done = qxt_emissions_done;
+        const int depth = lockDepth;
+        lockDepth = 0;
+        for (int i = 0; i < depth; ++i)
+            mutex.unlock();
+        while (qxt_emissions_done == done)
+            qxt_emission_done.wait(&qxt_emission_mutex);
+        emissionLocker.unlock();
+        for (int i = 0; i < depth; ++i)
+            mutex.lock();
+        lockDepth = depth;
+    }
+}
+
+void MAQxtGlobalShortcutPrivate::invalidateSnapshot()
+{
+    snapshotStale = true;
+}
+
+void MAQxtGlobalShortcutPrivate::publishSnapshot()
+{
+    DispatchSnapshot* fresh = new DispatchSnapshot;
+    foreach (const MAQxtGlobalShortcutTable::Entry& entry, shortcuts.entries())
+    {
+        const quint64 combination = entry.key & ~MAQxtGlobalShortcutTable::DisabledFlag;
+        fresh->table.insert(combination, entry.shortcut, entry.isEnabled());
+        fresh->add(combination);
+    }
+    fresh->chords = chordTrie.chords(MAQxtGlobalShortcutTrie::Root).toVector();
+    if (pendingChord != MAQxtGlobalShortcutTrie::Root)
+        fresh->chords += chordTrie.chords(pendingChord).toVector();
+    std::sort(fresh->chords.begin(), fresh->chords.end());
+    foreach (quint64 chord, fresh->chords)
+        fresh->add(chord);
+    fresh->statistics = statistics.enabled;
+    snapshot.publish(fresh);
+    snapshotStale = false;
+}
+
+void MAQxtGlobalShortcutPrivate::activateShortcut(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    if (trace.isActive())
+        trace.record(eventTime, nativeKey, nativeMods, false);
+    pressKey(nativeKey, nativeMods, eventTime);
+}
+
+void MAQxtGlobalShortcutPrivate::releaseShortcut(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    if (trace.isActive())
+        trace.record(eventTime, nativeKey, nativeMods, true);
+    releaseKey(nativeKey, nativeMods, eventTime);
+}
+
+void MAQxtGlobalShortcutPrivate::pressKey(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    MAQxtRcuPointer<DispatchSnapshot>::Reader reader(snapshot);
+    const DispatchSnapshot* current = reader.data();
+    if (!current)
+        return;
+    // A held key repeats whatever the modifiers do meanwhile.
+    const bool held = mayBeHeld(nativeKey);
+    const quint64 combination = MAQxtGlobalShortcutTable::pack(nativeKey, nativeMods);
+    const MAQxtGlobalShortcutTable::Entry* entry = 0;
+    if (current->mayContain(nativeKey, nativeMods))
+    {
+        entry = current->table.find(combination);
+        if (!held && (entry ? !entry->isEnabled() : !current->isChord(combination)))
+        {
+            if (current->statistics)
+                (entry ? statistics.uncountedDisabledHits : statistics.uncountedMisses).ref();
+            return;
+        }
+    }
+    else if (!held)
+    {
+        if (current->statistics)
+            statistics.uncountedRejects.ref();
+        return;
+    }
+
+    MAQxtGlobalShortcutLocker locker;
+    // Writers publish before they release the mutex, so a snapshot that is
+    // still current is the live state and stays so while the mutex is held.
+    if (snapshotStale || snapshot.data() != current)
+        entry = shortcuts.find(combination);
+    reader.leave();
+    dispatchPress(nativeKey, nativeMods, eventTime, entry);
+}
+
+void MAQxtGlobalShortcutPrivate::releaseKey(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    // Only the release of a key that activated something does anything.
+    if (!mayBeHeld(nativeKey))
+        return;
+    MAQxtGlobalShortcutLocker locker;
+    dispatchRelease(nativeKey, nativeMods, eventTime);
+}
+
+void MAQxtGlobalShortcutPrivate::dispatchPress(quint32 nativeKey, quint32 nativeMods, quint32 eventTime,
+                                               const MAQxtGlobalShortcutTable::Entry* entry)
+{
+    if (!heldKeys.isEmpty())
+    {
+        const int index = heldKeyIndex(nativeKey, nativeMods);
+        if (index >= 0 && eventTime - heldKeys.at(index).lastTime <= qxt_max_repeat_gap)
+        {
+            heldKeys[index].lastTime = eventTime;
+            const HeldKey held = heldKeys.at(index);
+            if (held.chordShortcut)
+            {
+                if (held.chordShortcut->qxt_d().enabled)
+                    held.chordShortcut->qxt_d().notify(RepeatEvent, eventTime, 0);
+                return;
+            }
+            const MAQxtGlobalShortcutTable::Entry* entry = shortcuts.find(held.combination);
+            if (entry && entry->isEnabled())
+                notifySubscribers(entry, RepeatEvent, eventTime, 0);
+            return;
+        }
+        if (index >= 0)
+        {
+            heldKeys.remove(index);
+            updateHeldKeyBits();
+        }
+    }
+    if (!(nativeMods & PassiveFlag) && !chordTrie.isEmpty() && dispatchChord(nativeKey, nativeMods, eventTime))
+        return;
+    if (statistics.enabled)
+        countActivation(entry, eventTime);
+    if (!entry || !entry->isEnabled())
+        return;
+    if (nativeReleaseEvents())
+    {
+        const HeldKey held = { nativeKey, (nativeMods & PassiveFlag) != 0, entry->key, 0, eventTime, eventTime };
+        heldKeys.append(held);
+        updateHeldKeyBits();
+    }
+    notifySubscribers(entry, PressEvent, eventTime, 0);
+}
+
+void MAQxtGlobalShortcutPrivate::dispatchRelease(quint32 nativeKey, quint32 nativeMods, quint32 eventTime)
+{
+    const int index = heldKeyIndex(nativeKey, nativeMods);
+    if (index < 0)
+        return;
+    const HeldKey held = heldKeys.at(index);
+    heldKeys.remove(index);
+    updateHeldKeyBits();
+    const int holdDuration = int(eventTime - held.pressTime);
+    if (held.chordShortcut)
+    {
+        if (held.chordShortcut->qxt_d().enabled)
+            held.chordShortcut->qxt_d().notify(ReleaseEvent, eventTime, holdDuration);
+        return;
+    }
+    const MAQxtGlobalShortcutTable::Entry* entry = shortcuts.find(held.combination);
+    if (entry && entry->isEnabled())
+        notifySubscribers(entry, ReleaseEvent, eventTime, holdDuration);
+}
+
+void MAQxtGlobalShortcutPrivate::updateHeldKeyBits()
+{
+    quint32 bits[8];
+    int wideKeys = 0;
+    memset(bits, 0, sizeof(bits));
+    foreach (const HeldKey& held, heldKeys)
+    {
+        if (held.nativeKey < 256)
+            bits[held.nativeKey >> 5] |= 1u << (held.nativeKey & 31);
+        else
+            ++wideKeys;
+    }
+    for (int i = 0; i < 8; ++i)
+        qxt_atomic_store_release(heldKeyBits[i], int(bits[i]));
+    qxt_atomic_store_release(heldWideKeys, wideKeys);
+}
+
+int MAQxtGlobalShortcutPrivate::heldKeyIndex(quint32 nativeKey, quint32 nativeMods)
+{
+    // A passive shortcut's key is seen again by the grab of another one.
+    const bool passive = (nativeMods & PassiveFlag) != 0;
+    for (int i = 0; i < heldKeys.size(); ++i)
+    {
+        if (heldKeys.at(i).nativeKey == nativeKey && heldKeys.at(i).passive == passive)
+            return i;
+    }
+    return -1;
+}
+
+void MAQxtGlobalShortcutPrivate::notifySubscribers(const MAQxtGlobalShortcutTable::Entry* entry, KeyEvent event,
+                                                   quint32 eventTime, int holdDuration)
+{
+    // Signals are only queued here, no receiver runs before the mutex is
+    // released.
+    for (MAQxtGlobalShortcut* s = entry->shortcut; s; s = s->qxt_d().nextSubscriber)
+    {
+        MAQxtGlobalShortcutPrivate& d = s->qxt_d();
+        if (d.enabled)
+            d.notify(event, eventTime, holdDuration);
+    }
+}
+
+void MAQxtGlobalShortcutPrivate::notify(KeyEvent event, quint32 eventTime, int holdDuration)
+{
+    switch (event)
+    {
+    case PressEvent:
+        lastActivation = eventTime;
+        queueActivated(0);
+        break;
+    case RepeatEvent:
+        ++pendingRepeats;
+        if (repeatPolicy == MAQxtGlobalShortcut::AllowRepeats
+            || (repeatPolicy == MAQxtGlobalShortcut::ThrottleRepeats && eventTime - lastActivation >= quint32(repeatInterval)))
+        {
+            lastActivation = eventTime;
+            queueActivated(pendingRepeats);
+        }
+        else if (repeatPolicy == MAQxtGlobalShortcut::CoalesceRepeats && !coalescing && qxt_repeat_coalescer)
+        {
+            coalescing = true;
+            coalescedShortcuts.append(&qxt_p());
+            qxt_repeat_coalescer->schedule();
+        }
+        break;
+    case ReleaseEvent:
+    {
+        // Repeats still waiting for the event loop go out first.
+        if (coalescing)
+        {
+            coalescedShortcuts.removeOne(&qxt_p());
+            coalescing = false;
+            queueActivated(pendingRepeats);
+        }
+        pendingRepeats = 0;
+        const Emission emission = { &qxt_p(), true, holdDuration };
+        pendingEmissions.append(emission);
+        break;
+    }
+    }
+}
+
+void MAQxtGlobalShortcutPrivate::queueActivated(int repeats)
+{
+    pendingRepeats = 0;
+    if (statistics.enabled)
+    {
+        ++statistics.activations;
+        ++activations;
+    }
+    const Emission emission = { &qxt_p(), false, repeats };
+    pendingEmissions.append(emission);
+}
+
+void MAQxtGlobalShortcutPrivate::flushCoalescedRepeats()
+{
+    MAQxtGlobalShortcutLocker locker;
+    qxt_repeat_coalescer->pending = false;
+    while (!coalescedShortcuts.isEmpty())
+    {
+        MAQxtGlobalShortcutPrivate& d = coalescedShortcuts.takeFirst()->qxt_d();
+        d.coalescing = false;
+        if (d.enabled && d.pendingRepeats > 0)
+            d.queueActivated(d.pendingRepeats);
+    }
+}
+
+void MAQxtGlobalShortcutPrivate::dropRepeatState()
+{
+    if (coalescing)
+    {
+        coalescedShortcuts.removeOne(&qxt_p());
+        coalescing = false;
+    }
+    pendingRepeats = 0;
+    for (int i = heldKeys.size() - 1; i >= 0; --i)
+    {
+        if (heldKeys.at(i).chordShortcut == &qxt_p())
+            heldKeys.remove(i);
+    }
+    updateHeldKeyBits();
+}
+
+void MAQxtGlobalShortcutPrivate::countActivation(const MAQxtGlobalShortcutTable::Entry* entry, quint32 eventTime)
 {
-    MAQxtGlobalShortcut* shortcut = shortcuts.value(qMakePair(nativeKey, nativeMods));
-    if (shortcut && shortcut->isEnabled())
-        emit shortcut->activated();
+    if (!entry)
+    {
+        ++statistics.lookupMisses;
+        return;
+    }
+    if (!entry->isEnabled())
+    {
+        ++statistics.disabledHits;
+        return;
+    }
+    const qint64 age = nativeEventAge(eventTime);
+    if (age >= 0)
+        statistics.addLatency(age);
 }
 
 /*!
@@ -105,6 +1784,22 @@ void MAQxtGlobalShortcutPrivate::activateShortcut(quint32 nativeKey, quint32 nat
     shortcut->setShortcut(QKeySequence("Ctrl+Shift+F12"));
     \endcode
 
+    Any number of shortcuts may use the same key sequence; they share one
+    native registration and each enabled one emits activated().
+
+    Use MAQxtGlobalShortcutBatch to change many shortcuts at once.
+
+    By default activated() is emitted from the event loop of the main thread.
+    See setDeliveryMode() for taking activations on a separate thread, so
+    that they are not held up while the main thread is busy.
+
+    Shortcuts may be created, changed and deleted from any thread. Key
+    events that match no shortcut are turned away without taking a lock,
+    so busy typing does not contend with threads changing shortcuts.
+    Signals are emitted without any lock held, so receivers may change
+    shortcuts too. Deleting a shortcut waits for the receivers of its
+    signals that run on other threads at the time.
+
     \bold {Note:} Since MAQxt 0.6 MAQxtGlobalShortcut no more requires MAQxtApplication.
  */
 
@@ -112,8 +1807,23 @@ void MAQxtGlobalShortcutPrivate::activateShortcut(quint32 nativeKey, quint32 nat
     \fn MAQxtGlobalShortcut::activated()
 
     This signal is emitted when the user types the shortcut's key sequence.
+    While the last key of the sequence is held, auto-repeat emits it again
+    as allowed by repeatPolicy(); repeatCount() tells the two apart.
 
-    \sa shortcut
+    \sa shortcut, released()
+ */
+
+/*!
+    \fn MAQxtGlobalShortcut::released(int holdDuration)
+
+    This signal is emitted when the last key of the shortcut's key sequence
+    is released after an activation. \a holdDuration is the time in
+    milliseconds it was held. Any repeats coalesced until then are emitted
+    with activated() first.
+
+    Not emitted on Windows, which does not report the release of hot keys.
+
+    \sa activated(), repeatPolicy
  */
 
 /*!
@@ -137,11 +1847,19 @@ MAQxtGlobalShortcut::MAQxtGlobalShortcut(const QKeySequence& shortcut, QObject*
 
 /*!
     Destructs the MAQxtGlobalShortcut.
+
+    A receiver of its signals running on another thread at the time is
+    waited for. A receiver that in turn waits for the deleting thread, such
+    as one connected with Qt::BlockingQueuedConnection to an object living
+    there, never returns; disconnect it before deleting the shortcut.
  */
 MAQxtGlobalShortcut::~MAQxtGlobalShortcut()
 {
+    MAQxtGlobalShortcutLocker locker;
+    // Unregistered first, so that no key event queues signals meanwhile.
     if (qxt_d().key != 0)
         qxt_d().unsetShortcut();
+    MAQxtGlobalShortcutPrivate::dropEmissions(this);
 }
 
 /*!
@@ -149,32 +1867,93 @@ MAQxtGlobalShortcut::~MAQxtGlobalShortcut()
     \brief the shortcut key sequence
 
     \bold {Note:} Notice that corresponding key press and release events are not
-    delivered for registered global shortcuts even if they are disabled.
-    Also, comma separated key sequences are not supported.
-    Only the first part is used:
+    delivered for registered global shortcuts even if they are disabled,
+    unless ungrabWhenDisabled() is set.
 
-    \code
-    qxtShortcut->setShortcut(QKeySequence("Ctrl+Alt+A,Ctrl+Alt+B"));
-    Q_ASSERT(qxtShortcut->shortcut() == QKeySequence("Ctrl+Alt+A"));
-    \endcode
+    Comma separated key sequences such as "Ctrl+K,Ctrl+C" are supported.
+    Only their first chord is grabbed permanently, and it may be shared by
+    any number of shortcuts; the following chords are grabbed while a
+    prefix is pending, until the sequence completes, another grabbed key is
+    pressed or chordTimeout() passes. A sequence cannot start with the
+    whole of another one, nor with a chord used as a shortcut on its own.
+
+    \sa chordTimeout()
  */
 QKeySequence MAQxtGlobalShortcut::shortcut() const
 {
+    MAQxtGlobalShortcutLocker locker;
+    if (!qxt_d().chords.isEmpty())
+        return qxt_d().chords;
     return QKeySequence(qxt_d().key | qxt_d().mods);
 }
 
 bool MAQxtGlobalShortcut::setShortcut(const QKeySequence& shortcut)
 {
+    // Key events see either the old or the new sequence, never neither.
+    MAQxtGlobalShortcutLocker locker;
     if (qxt_d().key != 0)
         qxt_d().unsetShortcut();
     return qxt_d().setShortcut(shortcut);
 }
 
+/*!
+    Sets the first of \a candidates that is available as the shortcut and
+    returns its index, or -1 if none of them could be set; the previous
+    shortcut is unset either way.
+
+    All candidates are probed at once, see availableShortcuts().
+
+    \sa setShortcut(), availableShortcuts()
+ */
+int MAQxtGlobalShortcut::setFirstAvailableShortcut(const QList<QKeySequence>& candidates)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (qxt_d().key != 0)
+        qxt_d().unsetShortcut();
+    const QVector<bool> available = MAQxtGlobalShortcutPrivate::probeShortcuts(candidates);
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        // Another application may take a candidate after the probe.
+        if (available.at(i) && qxt_d().setShortcut(candidates.at(i)))
+            return i;
+    }
+    return -1;
+}
+
+/*!
+    Returns those of \a candidates that could be set as a shortcut right
+    now, in their original order.
+
+    A candidate is not available when another application holds one of its
+    chords, when its first chord is in use by a shortcut of this
+    application, or when it cannot be mapped to the current keyboard
+    layout. All candidates are probed with a single pipelined grab and
+    release; on X11 this costs about one server round-trip however many
+    there are, unlike calling setShortcut() for each of them.
+
+    The answer may be outdated by the time it is used; setShortcut() can
+    still fail.
+
+    \sa setFirstAvailableShortcut()
+ */
+QList<QKeySequence> MAQxtGlobalShortcut::availableShortcuts(const QList<QKeySequence>& candidates)
+{
+    const QVector<bool> available = MAQxtGlobalShortcutPrivate::probeShortcuts(candidates);
+    QList<QKeySequence> shortcuts;
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        if (available.at(i))
+            shortcuts.append(candidates.at(i));
+    }
+    return shortcuts;
+}
+
 /*!
     \property MAQxtGlobalShortcut::enabled
     \brief whether the shortcut is enabled
 
-    A disabled shortcut does not get activated.
+    A disabled shortcut does not get activated. It keeps its key registered
+    unless ungrabWhenDisabled() is set.
 
     The default value is \c true.
 
@@ -187,7 +1966,7 @@ bool MAQxtGlobalShortcut::isEnabled() const
 
 void MAQxtGlobalShortcut::setEnabled(bool enabled)
 {
-    qxt_d().enabled = enabled;
+    qxt_d().setEnabled(enabled);
 }
 
 /*!
@@ -197,5 +1976,560 @@ void MAQxtGlobalShortcut::setEnabled(bool enabled)
  */
 void MAQxtGlobalShortcut::setDisabled(bool disabled)
 {
-    qxt_d().enabled = !disabled;
+    qxt_d().setEnabled(!disabled);
+}
+
+/*!
+    \property MAQxtGlobalShortcut::passive
+    \brief whether the shortcut observes its key sequence without grabbing it
+
+    A passive shortcut is activated like any other, but does not take the
+    keys away from the application that has the focus, and cannot collide
+    with another application's registration. It suits monitoring rather
+    than commands. Passive and grabbing shortcuts on the same key sequence
+    are independent of each other.
+
+    Passive shortcuts are available on X11 servers with XInput 2.1, where
+    they select raw key events on the root window. They cannot have more
+    than one chord. Elsewhere setting a key sequence on a passive shortcut
+    fails.
+
+    Changing the property re-registers the current key sequence and returns
+    whether that succeeded. The default value is \c false.
+
+    \sa shortcut
+ */
+bool MAQxtGlobalShortcut::isPassive() const
+{
+    return qxt_d().passive;
+}
+
+bool MAQxtGlobalShortcut::setPassive(bool passive)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (passive == qxt_d().passive)
+        return true;
+    const QKeySequence sequence = shortcut();
+    if (qxt_d().key != 0)
+        qxt_d().unsetShortcut();
+    qxt_d().passive = passive;
+    return sequence.isEmpty() || qxt_d().setShortcut(sequence);
+}
+
+/*!
+    \enum MAQxtGlobalShortcut::RepeatPolicy
+
+    This enum describes what auto-repeat of a held shortcut does.
+
+    \value AllowRepeats every repeat emits activated(). This is the default.
+    \value DropRepeats repeats are ignored; activated() is emitted once per
+    press.
+    \value ThrottleRepeats a repeat emits activated() only once
+    repeatInterval() has passed since the previous activation.
+    \value CoalesceRepeats repeats that arrive while the main thread is busy
+    are merged into one activated(), emitted from its event loop.
+
+    In every case repeatCount() gives the number of repeats an activation
+    stands for. Repeats are told from presses in the backend, before any
+    signal is emitted. On Windows, which reports repeats as presses, the
+    policy has no effect.
+ */
+
+/*!
+    \property MAQxtGlobalShortcut::repeatPolicy
+    \brief what auto-repeat of the held shortcut does
+
+    The default value is AllowRepeats.
+
+    \sa repeatInterval, repeatCount()
+ */
+MAQxtGlobalShortcut::RepeatPolicy MAQxtGlobalShortcut::repeatPolicy() const
+{
+    return qxt_d().repeatPolicy;
+}
+
+void MAQxtGlobalShortcut::setRepeatPolicy(RepeatPolicy policy)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (policy == CoalesceRepeats && !qxt_repeat_coalescer)
+        qxt_repeat_coalescer = qxt_main_thread_object(new MAQxtRepeatCoalescer);
+    qxt_d().repeatPolicy = policy;
+}
+
+/*!
+    \property MAQxtGlobalShortcut::repeatInterval
+    \brief the minimum time in milliseconds between activations from repeats
+
+    Only used with ThrottleRepeats. The default value is 500.
+
+    \sa repeatPolicy
+ */
+int MAQxtGlobalShortcut::repeatInterval() const
+{
+    return qxt_d().repeatInterval;
+}
+
+void MAQxtGlobalShortcut::setRepeatInterval(int msecs)
+{
+    MAQxtGlobalShortcutLocker locker;
+    qxt_d().repeatInterval = qMax(msecs, 0);
+}
+
+/*!
+    Returns the number of auto-repeats the current activation stands for:
+    0 for the press itself, 1 for a single repeat and more for repeats
+    throttled or coalesced into one activation.
+
+    Only meaningful in a slot connected to activated().
+
+    \sa repeatPolicy
+ */
+int MAQxtGlobalShortcut::repeatCount() const
+{
+    return qxt_d().repeatCount;
+}
+
+/*!
+    Returns the time in milliseconds a multi-chord shortcut waits for its
+    next chord. The default is 1000.
+
+    \sa setChordTimeout(), shortcut
+ */
+int MAQxtGlobalShortcut::chordTimeout()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::chordTimeout;
+}
+
+/*!
+    Sets the time in milliseconds a multi-chord shortcut waits for its next
+    chord to \a msecs.
+
+    \sa chordTimeout()
+ */
+void MAQxtGlobalShortcut::setChordTimeout(int msecs)
+{
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutPrivate::chordTimeout = qMax(msecs, 0);
+}
+
+/*!
+    Returns whether disabled shortcuts release their native registration.
+
+    \sa setUngrabWhenDisabled(), enabled
+ */
+bool MAQxtGlobalShortcut::ungrabWhenDisabled()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::ungrabWhenDisabled;
+}
+
+/*!
+    Sets whether disabled shortcuts release their native registration to
+    \a ungrab. The default is \c false: a disabled shortcut keeps its key
+    registered, so other applications do not see it, but does not emit
+    activated().
+
+    When \c true, a key sequence is released while all shortcuts using it
+    are disabled and taken again when one of them is enabled. Changes are
+    applied once per event loop iteration, so any number of enable and
+    disable calls in between cost a single native update, and none if they
+    cancel out. Taking a key back can fail if another application has
+    registered it meanwhile.
+
+    Call this function from the main thread only.
+
+    \sa ungrabWhenDisabled(), enabled
+ */
+void MAQxtGlobalShortcut::setUngrabWhenDisabled(bool ungrab)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (!qxt_grab_sync)
+        qxt_grab_sync = qxt_main_thread_object(new MAQxtGrabSync);
+    if (ungrab == MAQxtGlobalShortcutPrivate::ungrabWhenDisabled)
+        return;
+    MAQxtGlobalShortcutPrivate::ungrabWhenDisabled = ungrab;
+    foreach (const MAQxtGlobalShortcutTable::Entry& entry, MAQxtGlobalShortcutPrivate::shortcuts.entries())
+        MAQxtGlobalShortcutPrivate::scheduleGrabSync(entry.key & ~MAQxtGlobalShortcutTable::DisabledFlag);
+}
+
+/*!
+    \enum MAQxtGlobalShortcut::DeliveryMode
+
+    This enum describes how activations reach the activated() signal.
+
+    \value EventLoopDelivery activated() is emitted by the main thread's event
+    loop. This is the default.
+    \value ListenerThreadDelivery activated() is emitted on a dedicated
+    listener thread as soon as the key is pressed. Receivers connected with
+    Qt::DirectConnection run on that thread; keep them short.
+    \value QueuedDelivery a dedicated listener thread collects activations
+    and hands them to the main thread through a lock-free queue. All
+    activations pending at a time are delivered by a single posted event.
+
+    \sa setDeliveryMode()
+ */
+
+/*!
+    Returns the current delivery mode.
+
+    \sa setDeliveryMode()
+ */
+MAQxtGlobalShortcut::DeliveryMode MAQxtGlobalShortcut::deliveryMode()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::deliveryMode;
+}
+
+/*!
+    Sets the delivery \a mode for all global shortcuts and returns \c true on
+    success. Registered shortcuts are moved over.
+
+    The listener thread modes are supported on X11, where the listener
+    uses its own connection to the X server, and by the evdev backend,
+    which always reads its devices on a listener thread. Call this function
+    from the main thread only.
+
+    \sa deliveryMode()
+ */
+bool MAQxtGlobalShortcut::setDeliveryMode(DeliveryMode mode)
+{
+    // The native switch joins listener threads, which may be waiting for
+    // the shortcut mutex, so it cannot be held throughout; switches are
+    // kept apart by a mutex of their own.
+    QMutexLocker switchLocker(&qxt_delivery_mode_mutex);
+    {
+        MAQxtGlobalShortcutLocker locker;
+        if (mode == MAQxtGlobalShortcutPrivate::deliveryMode)
+            return true;
+    }
+    if (!MAQxtGlobalShortcutPrivate::setNativeDeliveryMode(mode))
+        return false;
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutPrivate::deliveryMode = mode;
+    return true;
+}
+
+/*!
+    Starts reading key events from the file descriptor \a fd and returns
+    \c true on success.
+
+    Only the evdev backend supports this; elsewhere it returns \c false.
+    \a fd must read like a Linux input device, a stream of \c input_event
+    records: an opened \c /dev/input/event* node, or the read end of a pipe
+    that replays a recording, which exercises the shortcuts without any
+    device. Reading stops at the end of the stream. The descriptor stays
+    owned by the caller.
+
+    Without explicitly added devices, the evdev backend reads all keyboards
+    it is allowed to open under \c /dev/input once the first shortcut is set.
+
+    \sa removeInputDevice()
+ */
+bool MAQxtGlobalShortcut::addInputDevice(int fd)
+{
+#ifdef MAQXT_EVDEV_BACKEND
+    return MAQxtGlobalShortcutPrivate::addInputDevice(fd);
+#else
+    Q_UNUSED(fd);
+    return false;
+#endif
+}
+
+/*!
+    Stops reading key events from \a fd and returns \c true if it was being
+    read. The descriptor is not closed.
+
+    \sa addInputDevice()
+ */
+bool MAQxtGlobalShortcut::removeInputDevice(int fd)
+{
+#ifdef MAQXT_EVDEV_BACKEND
+    return MAQxtGlobalShortcutPrivate::removeInputDevice(fd);
+#else
+    Q_UNUSED(fd);
+    return false;
+#endif
+}
+
+/*!
+    Returns whether the keyboard state is being tracked.
+
+    \sa setKeyStateTracked(), isKeyPressed(), keyboardModifiers()
+ */
+bool MAQxtGlobalShortcut::isKeyStateTracked()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::keyStateTracked;
+}
+
+/*!
+    Starts or stops tracking which keys are held down, depending on
+    \a tracked, and returns \c true on success.
+
+    While tracked, the backend follows every key press and release it sees,
+    whichever window has the focus and whether or not another client has
+    grabbed the keyboard, so that isKeyPressed() and keyboardModifiers()
+    answer from memory instead of asking the window system. The state is
+    read from the window system once when tracking starts, and again when
+    the focus moves between the application's windows.
+
+    Supported on X11, where XInput 2.1 raw key events are selected for it,
+    and by the evdev backend. Keys held on several keyboards at once count
+    as one.
+
+    \sa isKeyStateTracked()
+ */
+bool MAQxtGlobalShortcut::setKeyStateTracked(bool tracked)
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (tracked == MAQxtGlobalShortcutPrivate::keyStateTracked)
+        return true;
+    if (!MAQxtGlobalShortcutPrivate::setNativeKeyStateTracked(tracked))
+        return false;
+    MAQxtGlobalShortcutPrivate::keyStateTracked = tracked;
+    if (!tracked)
+        MAQxtGlobalShortcutPrivate::keyState.clear();
+    return true;
+}
+
+/*!
+    Returns \c true if \a key is held down. Always returns \c false
+    unless the key state is tracked.
+
+    Answered from memory, this is cheap enough to call from within a slot
+    connected to activated(). Keys are told apart by their native keycode,
+    so \c Qt::Key_A is held as well when Shift+A is.
+
+    \sa setKeyStateTracked(), keyboardModifiers()
+ */
+bool MAQxtGlobalShortcut::isKeyPressed(Qt::Key key)
+{
+    return MAQxtGlobalShortcutPrivate::isKeyPressed(key);
+}
+
+/*!
+    Returns the Shift, Control, Alt and Meta modifiers in effect, or
+    \c Qt::NoModifier unless the key state is tracked.
+
+    Unlike QApplication::keyboardModifiers() this is also correct while
+    another application has the focus. It takes no lock and may be called
+    from any thread.
+
+    \sa setKeyStateTracked(), isKeyPressed()
+ */
+Qt::KeyboardModifiers MAQxtGlobalShortcut::keyboardModifiers()
+{
+    return MAQxtGlobalShortcutPrivate::keyboardModifiers();
+}
+
+/*!
+    Returns the file native keycodes are cached in, or an empty string if
+    they are not.
+
+    \sa setKeycodeCacheFile()
+ */
+QString MAQxtGlobalShortcut::keycodeCacheFile()
+{
+    return MAQxtGlobalShortcutPrivate::keycodeCacheFile();
+}
+
+/*!
+    Caches the native keycodes that key sequences resolve to in
+    \a fileName, and returns \c true if the file already held those of
+    the current keyboard mapping. An empty \a fileName turns the cache off.
+
+    Resolving a key to its native keycode can be costly, such as building
+    a reverse index of the keyboard layout on Mac OS X. With a cache file
+    set before the shortcuts, keys resolved in an earlier run are looked
+    up in the memory-mapped file instead, and the shortcuts go straight
+    to registration, best in a single MAQxtGlobalShortcutBatch.
+
+    The file is tied to a fingerprint of the keyboard mapping. A file made
+    for another mapping is ignored, as are all cached keycodes once the
+    mapping changes while running. Keycodes resolved since the file was
+    read are written when the cache is turned off or changed, and when the
+    application exits; the file is replaced as a whole, so that other
+    processes may read it at the same time.
+
+    \sa keycodeCacheFile()
+ */
+bool MAQxtGlobalShortcut::setKeycodeCacheFile(const QString& fileName)
+{
+    return MAQxtGlobalShortcutPrivate::setKeycodeCacheFile(fileName);
+}
+
+/*!
+    Returns whether statistics are being collected.
+
+    \sa setStatisticsEnabled(), statistics()
+ */
+bool MAQxtGlobalShortcut::isStatisticsEnabled()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::statistics.enabled;
+}
+
+/*!
+    Starts or stops collecting statistics for all global shortcuts,
+    depending on \a enabled. Collected values are kept when stopping.
+
+    Statistics are off by default and cost a single branch per key event
+    while off. On X11, enabling them the first time makes a server
+    round-trip to relate X server time to the local clock.
+
+    \sa statistics(), resetStatistics()
+ */
+void MAQxtGlobalShortcut::setStatisticsEnabled(bool enabled)
+{
+    // Event times may take a server round-trip to interpret, which is
+    // made here rather than on the first key event.
+    if (enabled)
+        MAQxtGlobalShortcutPrivate::prepareNativeEventAge();
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutPrivate::statistics.enabled = enabled;
+    MAQxtGlobalShortcutPrivate::invalidateSnapshot();
+}
+
+/*!
+    Returns a snapshot of the statistics collected so far.
+
+    \sa setStatisticsEnabled(), MAQxtGlobalShortcutStatistics
+ */
+MAQxtGlobalShortcutStatistics MAQxtGlobalShortcut::statistics()
+{
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutStatistics statistics;
+    MAQxtGlobalShortcutPrivate::statistics.collect();
+    MAQxtGlobalShortcutPrivate::statistics.fill(statistics);
+    foreach (const MAQxtGlobalShortcutTable::Entry& entry, MAQxtGlobalShortcutPrivate::shortcuts.entries())
+    {
+        for (MAQxtGlobalShortcut* s = entry.shortcut; s; s = s->qxt_d().nextSubscriber)
+        {
+            MAQxtGlobalShortcutStatistics::Shortcut shortcut;
+            shortcut.shortcut = s;
+            shortcut.sequence = s->shortcut();
+            shortcut.activations = s->qxt_d().activations;
+            statistics.shortcuts.append(shortcut);
+        }
+    }
+    foreach (MAQxtGlobalShortcut* owner, MAQxtGlobalShortcutPrivate::chordTrie.shortcuts())
+    {
+        MAQxtGlobalShortcutStatistics::Shortcut shortcut;
+        shortcut.shortcut = owner;
+        shortcut.sequence = owner->shortcut();
+        shortcut.activations = owner->qxt_d().activations;
+        statistics.shortcuts.append(shortcut);
+    }
+    return statistics;
+}
+
+/*!
+    Clears all collected statistics.
+
+    \sa statistics()
+ */
+void MAQxtGlobalShortcut::resetStatistics()
+{
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutPrivate::statistics.reset();
+    foreach (const MAQxtGlobalShortcutTable::Entry& entry, MAQxtGlobalShortcutPrivate::shortcuts.entries())
+    {
+        for (MAQxtGlobalShortcut* s = entry.shortcut; s; s = s->qxt_d().nextSubscriber)
+            s->qxt_d().activations = 0;
+    }
+    foreach (MAQxtGlobalShortcut* owner, MAQxtGlobalShortcutPrivate::chordTrie.shortcuts())
+        owner->qxt_d().activations = 0;
+}
+
+/*!
+    \enum MAQxtGlobalShortcut::ReplaySpeed
+
+    This enum describes how fast replayTrace() feeds a trace.
+
+    \value RecordedSpeed events are spaced as they were recorded.
+    \value MaximumSpeed events are fed back to back.
+ */
+
+/*!
+    Starts recording the native key events that reach the shortcut
+    dispatch to \a device and returns \c true on success. A recording in
+    progress is stopped first.
+
+    Each event is stored with its timestamp, native keycode, native
+    modifier state and whether it was a press or a release, in 12 bytes.
+    Events are written in blocks, from whichever thread dispatches them;
+    \a device must stay open and must not be used otherwise until
+    stopTrace() is called. Recording costs a single branch per key event
+    while off.
+
+    \sa stopTrace(), replayTrace()
+ */
+bool MAQxtGlobalShortcut::startTrace(QIODevice* device)
+{
+    MAQxtGlobalShortcutLocker locker;
+    return MAQxtGlobalShortcutPrivate::trace.start(device);
+}
+
+/*!
+    Stops recording and writes out the events still buffered.
+
+    \sa startTrace()
+ */
+void MAQxtGlobalShortcut::stopTrace()
+{
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutPrivate::trace.stop();
+}
+
+/*!
+    Feeds the key events of the trace read from \a device through the
+    shortcut dispatch, as if the window system had reported them, and
+    returns the number of events replayed, or -1 if \a device holds no
+    trace of the current backend.
+
+    The events pass chord matching, the repeat policies and signal
+    emission exactly like live ones; their recorded timestamps are kept,
+    so the outcome does not depend on the speed. With \a speed
+    RecordedSpeed the call sleeps between the events as long as was
+    recorded, with MaximumSpeed it does not wait at all, which makes
+    replays usable as throughput benchmarks. Either way the call blocks
+    until the whole trace has been fed; receivers in other threads get
+    their signals queued as usual. Latencies collected during a replay are
+    meaningless.
+
+    Replayed events are not recorded to a trace started with startTrace();
+    live events arriving meanwhile are.
+
+    \sa startTrace()
+ */
+int MAQxtGlobalShortcut::replayTrace(QIODevice* device, ReplaySpeed speed)
+{
+    QVector<MAQxtGlobalShortcutTrace::Event> events;
+    if (!MAQxtGlobalShortcutTrace::read(device, events))
+        return -1;
+    QMutex sleepMutex;
+    QWaitCondition sleeper;
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < events.size(); ++i)
+    {
+        const MAQxtGlobalShortcutTrace::Event& event = events.at(i);
+        if (speed == RecordedSpeed)
+        {
+            // Native times wrap; the difference to the first event does not care.
+            const qint64 due = qint32(event.time - events.at(0).time);
+            const qint64 wait = due - clock.elapsed();
+            if (wait > 0)
+            {
+                QMutexLocker locker(&sleepMutex);
+                sleeper.wait(&sleepMutex, (unsigned long) wait);
+            }
+        }
+        if (event.release)
+            MAQxtGlobalShortcutPrivate::releaseKey(event.nativeKey, event.nativeMods, event.time);
+        else
+            MAQxtGlobalShortcutPrivate::pressKey(event.nativeKey, event.nativeMods, event.time);
+    }
+    return events.size();
 }
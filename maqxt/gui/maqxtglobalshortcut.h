@@ -26,8 +26,12 @@
 #define MAQXTGLOBALSHORTCUT_H
 
 #include "maqxt/core/maqxtglobal.h"
+#include "maqxtglobalshortcutstatistics.h"
 #include <QObject>
 #include <QKeySequence>
+#include <QList>
+#include <QString>
+class QIODevice;
 class MAQxtGlobalShortcutPrivate;
 
 class MAQXT_GUI_EXPORT MAQxtGlobalShortcut : public QObject
@@ -36,23 +40,89 @@ class MAQXT_GUI_EXPORT MAQxtGlobalShortcut : public QObject
     MAQXT_DECLARE_PRIVATE(MAQxtGlobalShortcut)
     Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled)
     Q_PROPERTY(QKeySequence shortcut READ shortcut WRITE setShortcut)
+    Q_PROPERTY(bool passive READ isPassive WRITE setPassive)
+    Q_PROPERTY(RepeatPolicy repeatPolicy READ repeatPolicy WRITE setRepeatPolicy)
+    Q_PROPERTY(int repeatInterval READ repeatInterval WRITE setRepeatInterval)
+    Q_ENUMS(DeliveryMode RepeatPolicy ReplaySpeed)
 
 public:
+    enum DeliveryMode
+    {
+        EventLoopDelivery,
+        ListenerThreadDelivery,
+        QueuedDelivery
+    };
+
+    enum RepeatPolicy
+    {
+        AllowRepeats,
+        DropRepeats,
+        ThrottleRepeats,
+        CoalesceRepeats
+    };
+
+    enum ReplaySpeed
+    {
+        RecordedSpeed,
+        MaximumSpeed
+    };
+
     explicit MAQxtGlobalShortcut(QObject* parent = 0);
     explicit MAQxtGlobalShortcut(const QKeySequence& shortcut, QObject* parent = 0);
     virtual ~MAQxtGlobalShortcut();
 
     QKeySequence shortcut() const;
     bool setShortcut(const QKeySequence& shortcut);
+    int setFirstAvailableShortcut(const QList<QKeySequence>& candidates);
+    static QList<QKeySequence> availableShortcuts(const QList<QKeySequence>& candidates);
 
     bool isEnabled() const;
 
+    bool isPassive() const;
+    bool setPassive(bool passive);
+
+    RepeatPolicy repeatPolicy() const;
+    void setRepeatPolicy(RepeatPolicy policy);
+    int repeatInterval() const;
+    void setRepeatInterval(int msecs);
+    int repeatCount() const;
+
+    static DeliveryMode deliveryMode();
+    static bool setDeliveryMode(DeliveryMode mode);
+
+    static bool addInputDevice(int fd);
+    static bool removeInputDevice(int fd);
+
+    static bool isKeyStateTracked();
+    static bool setKeyStateTracked(bool tracked);
+    static bool isKeyPressed(Qt::Key key);
+    static Qt::KeyboardModifiers keyboardModifiers();
+
+    static QString keycodeCacheFile();
+    static bool setKeycodeCacheFile(const QString& fileName);
+
+    static bool ungrabWhenDisabled();
+    static void setUngrabWhenDisabled(bool ungrab);
+
+    static int chordTimeout();
+    static void setChordTimeout(int msecs);
+
+    static bool isStatisticsEnabled();
+    static void setStatisticsEnabled(bool enabled);
+    static MAQxtGlobalShortcutStatistics statistics();
+    static void resetStatistics();
+
+    static bool startTrace(QIODevice* device);
+    static void stopTrace();
+    static int replayTrace(QIODevice* device, ReplaySpeed speed = MaximumSpeed);
+
 public Q_SLOTS:
     void setEnabled(bool enabled = true);
     void setDisabled(bool disabled = true);
 
 Q_SIGNALS:
     void activated();
+    void released(int holdDuration);
 };
 
 #endif // MAQXTGLOBALSHORTCUT_H
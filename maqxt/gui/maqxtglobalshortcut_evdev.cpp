@@ -0,0 +1,728 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcut_p.h"
+#include "maqxtspscring_p.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QEvent>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtDebug>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+// Kernels before 4.16 have no accessors for the event time.
+#ifndef input_event_sec
+#  define input_event_sec time.tv_sec
+#  define input_event_usec time.tv_usec
+#endif
+
+// The evdev backend reads key events straight from Linux input devices, so
+// it needs neither a window system nor a display: it serves Wayland
+// sessions, where clients cannot grab keys, and headless ones. Nothing is
+// grabbed; every device is read on a worker thread and the events are
+// matched against the shortcut table like those of the other backends.
+// Native keycodes are KEY_* codes and assume a US layout.
+
+// Indexed by Qt::Key - Qt::Key_Space.
+static const quint16 qxt_evdev_keycodes[] =
+{
+    KEY_SPACE, KEY_1, KEY_APOSTROPHE, KEY_3, KEY_4, KEY_5, KEY_7, KEY_APOSTROPHE,           // Space ! " # $ % & '
+    KEY_9, KEY_0, KEY_8, KEY_EQUAL, KEY_COMMA, KEY_MINUS, KEY_DOT, KEY_SLASH,               // ( ) * + , - . /
+    KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7,                                 // 0 - 7
+    KEY_8, KEY_9, KEY_SEMICOLON, KEY_SEMICOLON, KEY_COMMA, KEY_EQUAL, KEY_DOT, KEY_SLASH,   // 8 9 : ; < = > ?
+    KEY_2, KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G,                                 // @ A - G
+    KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M, KEY_N, KEY_O,                                 // H - O
+    KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W,                                 // P - W
+    KEY_X, KEY_Y, KEY_Z, KEY_LEFTBRACE, KEY_BACKSLASH, KEY_RIGHTBRACE, KEY_6, KEY_MINUS,    // X Y Z [ \ ] ^ _
+    KEY_GRAVE                                                                               // `
+};
+
+// Indexed by Qt::Key - Qt::Key_Escape.
+static const quint16 qxt_evdev_special_keycodes[] =
+{
+    KEY_ESC, KEY_TAB, KEY_TAB, KEY_BACKSPACE, KEY_ENTER, KEY_KPENTER, KEY_INSERT, KEY_DELETE,   // Escape Tab Backtab Backspace Return Enter Insert Delete
+    KEY_PAUSE, KEY_SYSRQ, KEY_SYSRQ, 0, 0, 0, 0, 0,                                             // Pause Print SysReq Clear
+    KEY_HOME, KEY_END, KEY_LEFT, KEY_UP, KEY_RIGHT, KEY_DOWN, KEY_PAGEUP, KEY_PAGEDOWN,         // Home End Left Up Right Down PageUp PageDown
+    0, 0, 0, 0, 0, 0, 0, 0,
+    KEY_LEFTSHIFT, KEY_LEFTCTRL, KEY_LEFTMETA, KEY_LEFTALT,
+    KEY_CAPSLOCK, KEY_NUMLOCK, KEY_SCROLLLOCK, 0,                                               // Shift Control Meta Alt CapsLock NumLock ScrollLock
+    0, 0, 0, 0, 0, 0, 0, 0,
+    KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8,                             // F1 - F8
+    KEY_F9, KEY_F10, KEY_F11, KEY_F12, KEY_F13, KEY_F14, KEY_F15, KEY_F16,                      // F9 - F16
+    KEY_F17, KEY_F18, KEY_F19, KEY_F20, KEY_F21, KEY_F22, KEY_F23, KEY_F24,                     // F17 - F24
+    0, 0, 0, 0, 0, 0, 0, 0,                                                                     // F25 - F32
+    0, 0, 0, KEY_LEFTMETA, KEY_RIGHTMETA, KEY_COMPOSE, 0, 0,                                    // F33 F34 F35 Super_L Super_R Menu Hyper_L Hyper_R
+    KEY_HELP                                                                                    // Help
+};
+
+// Indexed by Qt::Key - Qt::Key_Space, for keys with Qt::KeypadModifier.
+static const quint16 qxt_evdev_keypad_keycodes[] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0,                                                                     // Space ! " # $ % & '
+    0, 0, KEY_KPASTERISK, KEY_KPPLUS, KEY_KPCOMMA, KEY_KPMINUS, KEY_KPDOT, KEY_KPSLASH,         // ( ) * + , - . /
+    KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7,                     // 0 - 7
+    KEY_KP8, KEY_KP9, 0, 0, 0, KEY_KPEQUAL                                                      // 8 9 : ; < =
+};
+
+// Indexed by Qt::Key - Qt::Key_Escape, for keys with Qt::KeypadModifier;
+// these are the keypad digits with NumLock off.
+static const quint16 qxt_evdev_keypad_special_keycodes[] =
+{
+    0, 0, 0, 0, 0, KEY_KPENTER, KEY_KP0, KEY_KPDOT,                                             // Escape Tab Backtab Backspace Return Enter Insert Delete
+    0, 0, 0, KEY_KP5, 0, 0, 0, 0,                                                               // Pause Print SysReq Clear
+    KEY_KP7, KEY_KP1, KEY_KP4, KEY_KP8, KEY_KP6, KEY_KP2, KEY_KP9, KEY_KP3                      // Home End Left Up Right Down PageUp PageDown
+};
+
+// The modifier keys, in the order of their bits in Device::modifierKeys.
+static const quint16 qxt_evdev_modifier_keys[] =
+{
+    KEY_LEFTSHIFT, KEY_RIGHTSHIFT, KEY_LEFTCTRL, KEY_RIGHTCTRL, KEY_LEFTALT, KEY_RIGHTALT, KEY_LEFTMETA, KEY_RIGHTMETA
+};
+
+// The native modifiers are our own: evdev has no notion of them.
+enum { QxtEvdevShift = 0x1, QxtEvdevControl = 0x2, QxtEvdevAlt = 0x4, QxtEvdevMeta = 0x8 };
+
+// Indexed by MAQxtGlobalShortcutPrivate::modifierIndex().
+static const quint32 qxt_evdev_modifiers[] =
+    MAQXT_MODIFIER_TABLE(QxtEvdevShift, QxtEvdevControl, QxtEvdevAlt, QxtEvdevMeta);
+
+#define QXT_EVDEV_TABLE_SIZE(table) quint32(sizeof(table) / sizeof(table[0]))
+
+static quint32 qxt_evdev_keycode(Qt::Key key, Qt::KeyboardModifiers modifiers)
+{
+    const quint32 code = key;
+    if (modifiers & Qt::KeypadModifier)
+    {
+        if (code - Qt::Key_Space < QXT_EVDEV_TABLE_SIZE(qxt_evdev_keypad_keycodes) && qxt_evdev_keypad_keycodes[code - Qt::Key_Space])
+            return qxt_evdev_keypad_keycodes[code - Qt::Key_Space];
+        if (code - Qt::Key_Escape < QXT_EVDEV_TABLE_SIZE(qxt_evdev_keypad_special_keycodes) && qxt_evdev_keypad_special_keycodes[code - Qt::Key_Escape])
+            return qxt_evdev_keypad_special_keycodes[code - Qt::Key_Escape];
+    }
+    if (code - Qt::Key_Space < QXT_EVDEV_TABLE_SIZE(qxt_evdev_keycodes))
+        return qxt_evdev_keycodes[code - Qt::Key_Space];
+    if (code - Qt::Key_Escape < QXT_EVDEV_TABLE_SIZE(qxt_evdev_special_keycodes))
+        return qxt_evdev_special_keycodes[code - Qt::Key_Escape];
+    switch (code)
+    {
+    case Qt::Key_BraceLeft:
+        return KEY_LEFTBRACE;
+    case Qt::Key_Bar:
+        return KEY_BACKSLASH;
+    case Qt::Key_BraceRight:
+        return KEY_RIGHTBRACE;
+    case Qt::Key_AsciiTilde:
+        return KEY_GRAVE;
+    case Qt::Key_Back:
+        return KEY_BACK;
+    case Qt::Key_Forward:
+        return KEY_FORWARD;
+    case Qt::Key_Stop:
+        return KEY_STOP;
+    case Qt::Key_Refresh:
+        return KEY_REFRESH;
+    case Qt::Key_VolumeDown:
+        return KEY_VOLUMEDOWN;
+    case Qt::Key_VolumeMute:
+        return KEY_MUTE;
+    case Qt::Key_VolumeUp:
+        return KEY_VOLUMEUP;
+    case Qt::Key_MediaPlay:
+    case Qt::Key_MediaTogglePlayPause:
+        return KEY_PLAYPAUSE;
+    case Qt::Key_MediaStop:
+        return KEY_STOPCD;
+    case Qt::Key_MediaPrevious:
+        return KEY_PREVIOUSSONG;
+    case Qt::Key_MediaNext:
+        return KEY_NEXTSONG;
+    case Qt::Key_MediaRecord:
+        return KEY_RECORD;
+    case Qt::Key_MediaPause:
+        return KEY_PAUSECD;
+    case Qt::Key_HomePage:
+        return KEY_HOMEPAGE;
+    case Qt::Key_Favorites:
+        return KEY_BOOKMARKS;
+    case Qt::Key_Search:
+        return KEY_SEARCH;
+    case Qt::Key_LaunchMail:
+        return KEY_MAIL;
+    case Qt::Key_Calculator:
+        return KEY_CALC;
+    case Qt::Key_Explorer:
+        return KEY_FILE;
+    case Qt::Key_Sleep:
+        return KEY_SLEEP;
+    case Qt::Key_PowerOff:
+        return KEY_POWER;
+    case Qt::Key_Eject:
+        return KEY_EJECTCD;
+    default:
+        return 0;
+    }
+}
+
+static quint32 qxt_evdev_modifiers_of(quint8 modifierKeys)
+{
+    quint32 mods = 0;
+    if (modifierKeys & 0x03)
+        mods |= QxtEvdevShift;
+    if (modifierKeys & 0x0c)
+        mods |= QxtEvdevControl;
+    if (modifierKeys & 0x30)
+        mods |= QxtEvdevAlt;
+    if (modifierKeys & 0xc0)
+        mods |= QxtEvdevMeta;
+    return mods;
+}
+
+static int qxt_evdev_modifier_bit(quint16 code)
+{
+    for (quint32 i = 0; i < QXT_EVDEV_TABLE_SIZE(qxt_evdev_modifier_keys); ++i)
+    {
+        if (qxt_evdev_modifier_keys[i] == code)
+            return 1 << i;
+    }
+    return 0;
+}
+
+// Passive combinations registered; they are matched by dispatching every
+// event a second time with PassiveFlag set. Written under the shortcut
+// mutex, read by the listener.
+static QAtomicInt qxt_evdev_passive_count;
+
+// Reads the devices on a thread of its own. The descriptors are watched by
+// epoll, each wakeup reads a batch of input_event records with a single
+// read(); an eventfd stops the thread. Descriptors handed in through
+// MAQxtGlobalShortcut::addInputDevice() may be anything that reads like
+// an input device, such as a pipe replaying a recording.
+class MAQxtGlobalShortcutListener : public QThread
+{
+public:
+    explicit MAQxtGlobalShortcutListener(bool queued);
+    ~MAQxtGlobalShortcutListener();
+
+    bool open();
+    void stop();
+    void setQueued(bool queued);
+    void deliverQueued();
+
+    bool addDevice(int fd, bool owned);
+    bool removeDevice(int fd);
+    void openKeyboards();
+    void setKeyStateTracked(bool tracked);
+
+protected:
+    void run();
+    bool event(QEvent* event);
+
+private:
+    struct Device
+    {
+        bool owned;         // opened by us, closed when dropped
+        quint8 modifierKeys; // bits of qxt_evdev_modifier_keys held down
+        int partial;        // bytes of an incomplete record in 'tail'
+        char tail[sizeof(struct input_event)];
+    };
+
+    struct Activation
+    {
+        quint32 nativeKey;
+        quint32 nativeMods;
+        quint32 time;
+        bool release;
+    };
+
+    void readDevice(int fd);
+    void dropDevice(int fd);
+    void syncKeyState();
+    quint8 heldModifierKeys() const;
+    void dispatch(quint32 nativeKey, quint32 nativeMods, quint32 time, bool release);
+    void deliver(const Activation& activation);
+
+    int epollFd;
+    int wakeFd;
+    // Guards 'devices'; never held while dispatching, since the shortcut
+    // mutex is taken there and addDevice() may be called with it held.
+    QMutex devicesMutex;
+    QHash<int, Device> devices;
+    bool trackKeys; // follow MAQxtGlobalShortcutPrivate::keyState, under devicesMutex
+    QAtomicInt queued;
+    QAtomicInt pending; // a delivery event has been posted
+    MAQxtSpscRing<Activation, 256> activations;
+};
+
+static const QEvent::Type qxt_evdev_delivery_event = QEvent::Type(QEvent::registerEventType());
+static MAQxtGlobalShortcutListener* qxt_evdev_listener = 0;
+static bool qxt_evdev_queued = true;
+
+MAQxtGlobalShortcutListener::MAQxtGlobalShortcutListener(bool queued)
+    : epollFd(-1), wakeFd(-1), trackKeys(false), queued(queued), pending(0)
+{
+}
+
+MAQxtGlobalShortcutListener::~MAQxtGlobalShortcutListener()
+{
+    foreach (int fd, devices.keys())
+        dropDevice(fd);
+    if (wakeFd >= 0)
+        close(wakeFd);
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+bool MAQxtGlobalShortcutListener::open()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd < 0 || wakeFd < 0)
+        return false;
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == 0;
+}
+
+void MAQxtGlobalShortcutListener::stop()
+{
+    const quint64 one = 1;
+    if (write(wakeFd, &one, sizeof(one)) != sizeof(one))
+        qWarning() << "MAQxtGlobalShortcut failed to wake the input listener:" << strerror(errno);
+    wait();
+}
+
+void MAQxtGlobalShortcutListener::setQueued(bool queued)
+{
+    qxt_atomic_store_release(this->queued, queued);
+}
+
+bool MAQxtGlobalShortcutListener::addDevice(int fd, bool owned)
+{
+    QMutexLocker locker(&devicesMutex);
+    if (fd < 0 || devices.contains(fd))
+        return false;
+    // Have real devices stamp their events with the clock nativeEventAge()
+    // reads; anything else keeps the times it carries.
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        return false;
+    Device device;
+    device.owned = owned;
+    device.modifierKeys = 0;
+    device.partial = 0;
+    devices.insert(fd, device);
+    return true;
+}
+
+bool MAQxtGlobalShortcutListener::removeDevice(int fd)
+{
+    QMutexLocker locker(&devicesMutex);
+    if (!devices.contains(fd))
+        return false;
+    dropDevice(fd);
+    return true;
+}
+
+void MAQxtGlobalShortcutListener::dropDevice(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, 0);
+    if (devices.value(fd).owned)
+        close(fd);
+    devices.remove(fd);
+    // Keys held on it would stay down otherwise.
+    if (trackKeys)
+        syncKeyState();
+}
+
+void MAQxtGlobalShortcutListener::openKeyboards()
+{
+    const QDir directory(QLatin1String("/dev/input"));
+    foreach (const QString& name, directory.entryList(QStringList(QLatin1String("event*")), QDir::System))
+    {
+        const int fd = ::open(QFile::encodeName(directory.filePath(name)).constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        // Anything with letter keys is taken for a keyboard.
+        unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+        memset(keys, 0, sizeof(keys));
+        const int bits = 8 * sizeof(unsigned long);
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 || !(keys[KEY_A / bits] & (1UL << (KEY_A % bits))) || !addDevice(fd, true))
+            close(fd);
+    }
+}
+
+void MAQxtGlobalShortcutListener::run()
+{
+    struct epoll_event events[16];
+    for (;;)
+    {
+        const int count = epoll_wait(epollFd, events, 16, -1);
+        if (count < 0 && errno != EINTR)
+        {
+            qWarning() << "MAQxtGlobalShortcut failed to wait for input:" << strerror(errno);
+            return;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            if (events[i].data.fd == wakeFd)
+                return;
+            readDevice(events[i].data.fd);
+        }
+    }
+}
+
+void MAQxtGlobalShortcutListener::setKeyStateTracked(bool tracked)
+{
+    QMutexLocker locker(&devicesMutex);
+    trackKeys = tracked;
+    if (tracked)
+        syncKeyState();
+}
+
+// Asks every device which keys are down; those that cannot tell, such as
+// pipes, add nothing. Called with devicesMutex held.
+void MAQxtGlobalShortcutListener::syncKeyState()
+{
+    quint8 held[MAQxtKeyState::KeyCount / 8];
+    memset(held, 0, sizeof(held));
+    unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+    const int bits = 8 * sizeof(unsigned long);
+    foreach (int fd, devices.keys())
+    {
+        memset(keys, 0, sizeof(keys));
+        if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) < 0)
+            continue;
+        for (int code = 0; code < MAQxtKeyState::KeyCount; ++code)
+        {
+            if (keys[code / bits] & (1UL << (code % bits)))
+                held[code >> 3] |= 1 << (code & 7);
+        }
+    }
+    MAQxtGlobalShortcutPrivate::keyState.reset(held, qxt_evdev_modifiers_of(heldModifierKeys()));
+}
+
+quint8 MAQxtGlobalShortcutListener::heldModifierKeys() const
+{
+    // Modifiers held on one keyboard apply to the keys of all others.
+    quint8 modifierKeys = 0;
+    foreach (const Device& device, devices)
+        modifierKeys |= device.modifierKeys;
+    return modifierKeys;
+}
+
+void MAQxtGlobalShortcutListener::readDevice(int fd)
+{
+    struct input_event records[64];
+    QVarLengthArray<Activation, 64> batch;
+    {
+        QMutexLocker locker(&devicesMutex);
+        QHash<int, Device>::iterator device = devices.find(fd);
+        if (device == devices.end())
+            return; // removed while we waited
+        // Pipes may split a record between two reads.
+        char* buffer = reinterpret_cast<char*>(records);
+        memcpy(buffer, device->tail, device->partial);
+        const ssize_t size = read(fd, buffer + device->partial, sizeof(records) - device->partial);
+        if (size <= 0)
+        {
+            if (size < 0 && (errno == EAGAIN || errno == EINTR))
+                return;
+            // End of a replay, or an unplugged device.
+            dropDevice(fd);
+            return;
+        }
+        const int bytes = device->partial + int(size);
+        const int count = bytes / int(sizeof(struct input_event));
+        device->partial = bytes % int(sizeof(struct input_event));
+        memcpy(device->tail, buffer + bytes - device->partial, device->partial);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const struct input_event& record = records[i];
+            if (record.type == EV_SYN && record.code == SYN_DROPPED)
+            {
+                // The kernel's buffer overflowed; ask the device which keys
+                // are down now, if it is one.
+                unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+                memset(keys, 0, sizeof(keys));
+                if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0)
+                {
+                    const int bits = 8 * sizeof(unsigned long);
+                    device->modifierKeys = 0;
+                    for (quint32 m = 0; m < QXT_EVDEV_TABLE_SIZE(qxt_evdev_modifier_keys); ++m)
+                    {
+                        const int code = qxt_evdev_modifier_keys[m];
+                        if (keys[code / bits] & (1UL << (code % bits)))
+                            device->modifierKeys |= 1 << m;
+                    }
+                }
+                if (trackKeys)
+                    syncKeyState();
+                continue;
+            }
+            if (record.type != EV_KEY || record.value > 2)
+                continue;
+            // Like X, report the modifiers in effect before the event.
+            const Activation activation = {
+                record.code, qxt_evdev_modifiers_of(heldModifierKeys()),
+                quint32(quint64(record.input_event_sec) * 1000 + record.input_event_usec / 1000), record.value == 0
+            };
+            batch.append(activation);
+            if (const int bit = qxt_evdev_modifier_bit(record.code))
+            {
+                if (record.value)
+                    device->modifierKeys |= bit;
+                else
+                    device->modifierKeys &= ~bit;
+            }
+            if (trackKeys)
+            {
+                MAQxtGlobalShortcutPrivate::keyState.setPressed(record.code, record.value != 0);
+                MAQxtGlobalShortcutPrivate::keyState.setModifiers(qxt_evdev_modifiers_of(heldModifierKeys()));
+            }
+        }
+    }
+    // Auto-repeat (value 2) is passed on as a press; a press of a held key
+    // is taken for a repeat.
+    const bool passive = qxt_atomic_load_relaxed(qxt_evdev_passive_count) != 0;
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        const Activation& activation = batch[i];
+        dispatch(activation.nativeKey, activation.nativeMods, activation.time, activation.release);
+        if (passive)
+            dispatch(activation.nativeKey, activation.nativeMods | MAQxtGlobalShortcutPrivate::PassiveFlag, activation.time, activation.release);
+    }
+}
+
+void MAQxtGlobalShortcutListener::dispatch(quint32 nativeKey, quint32 nativeMods, quint32 time, bool release)
+{
+    const Activation activation = { nativeKey, nativeMods, time, release };
+    if (!qxt_atomic_load_relaxed(queued))
+    {
+        deliver(activation);
+        return;
+    }
+    // A full ring means the main thread has not run for 256 events;
+    // dropping the newest ones is the least surprising.
+    if (activations.push(activation) && pending.testAndSetOrdered(0, 1))
+        QCoreApplication::postEvent(this, new QEvent(qxt_evdev_delivery_event));
+}
+
+void MAQxtGlobalShortcutListener::deliver(const Activation& activation)
+{
+    if (activation.release)
+        MAQxtGlobalShortcutPrivate::releaseShortcut(activation.nativeKey, activation.nativeMods, activation.time);
+    else
+        MAQxtGlobalShortcutPrivate::activateShortcut(activation.nativeKey, activation.nativeMods, activation.time);
+}
+
+bool MAQxtGlobalShortcutListener::event(QEvent* event)
+{
+    if (event->type() != qxt_evdev_delivery_event)
+        return QThread::event(event);
+    deliverQueued();
+    return true;
+}
+
+void MAQxtGlobalShortcutListener::deliverQueued()
+{
+    // Clear the flag first: anything pushed after this point either gets
+    // drained below or posts a new event.
+    qxt_atomic_store_release(pending, 0);
+    Activation activation;
+    while (activations.pop(activation))
+        deliver(activation);
+}
+
+static void qxt_evdev_stop_listener()
+{
+    if (qxt_evdev_listener)
+    {
+        qxt_evdev_listener->stop();
+        delete qxt_evdev_listener;
+        qxt_evdev_listener = 0;
+    }
+}
+
+// Starts the listener on first use. Keyboards are looked for only when no
+// device has been added explicitly by then.
+static MAQxtGlobalShortcutListener* qxt_evdev_start_listener(bool openKeyboards)
+{
+    if (qxt_evdev_listener)
+        return qxt_evdev_listener;
+    MAQxtGlobalShortcutListener* listener = new MAQxtGlobalShortcutListener(qxt_evdev_queued);
+    if (!listener->open())
+    {
+        qWarning() << "MAQxtGlobalShortcut failed to set up the input listener:" << strerror(errno);
+        delete listener;
+        return 0;
+    }
+    if (openKeyboards)
+        listener->openKeyboards();
+    qAddPostRoutine(qxt_evdev_stop_listener);
+    listener->start();
+    qxt_evdev_listener = listener;
+    return listener;
+}
+
+bool MAQxtGlobalShortcutPrivate::addInputDevice(int fd)
+{
+    MAQxtGlobalShortcutListener* listener = qxt_evdev_start_listener(false);
+    return listener && listener->addDevice(fd, false);
+}
+
+bool MAQxtGlobalShortcutPrivate::removeInputDevice(int fd)
+{
+    return qxt_evdev_listener && qxt_evdev_listener->removeDevice(fd);
+}
+
+bool MAQxtGlobalShortcutPrivate::nativeReleaseEvents()
+{
+    // Every device reports releases, and auto-repeat as a separate value.
+    return true;
+}
+
+quint32 MAQxtGlobalShortcutPrivate::nativeModifiers(Qt::KeyboardModifiers modifiers)
+{
+    return qxt_evdev_modifiers[modifierIndex(modifiers)];
+}
+
+quint32 MAQxtGlobalShortcutPrivate::nativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers)
+{
+    return qxt_evdev_keycode(key, modifiers);
+}
+
+quint64 MAQxtGlobalShortcutPrivate::nativeLayoutFingerprint()
+{
+    // Keys resolve through the fixed tables above.
+    quint64 hash = MAQxtKeycodeCache::fingerprint(MAQxtKeycodeCache::FingerprintBasis, "evdev", 5);
+    hash = MAQxtKeycodeCache::fingerprint(hash, qxt_evdev_keycodes, sizeof(qxt_evdev_keycodes));
+    hash = MAQxtKeycodeCache::fingerprint(hash, qxt_evdev_special_keycodes, sizeof(qxt_evdev_special_keycodes));
+    hash = MAQxtKeycodeCache::fingerprint(hash, qxt_evdev_keypad_keycodes, sizeof(qxt_evdev_keypad_keycodes));
+    return MAQxtKeycodeCache::fingerprint(hash, qxt_evdev_keypad_special_keycodes, sizeof(qxt_evdev_keypad_special_keycodes));
+}
+
+bool MAQxtGlobalShortcutPrivate::registerShortcut(quint32 nativeKey, quint32 nativeMods)
+{
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> grabs(1);
+    grabs[0].key = nativeKey;
+    grabs[0].mods = nativeMods;
+    updateShortcuts(ungrabs, grabs);
+    return grabs.at(0).ok;
+}
+
+bool MAQxtGlobalShortcutPrivate::unregisterShortcut(quint32 nativeKey, quint32 nativeMods)
+{
+    QVector<NativeShortcut> ungrabs(1);
+    QVector<NativeShortcut> grabs;
+    ungrabs[0].key = nativeKey;
+    ungrabs[0].mods = nativeMods;
+    updateShortcuts(ungrabs, grabs);
+    return ungrabs.at(0).ok;
+}
+
+void MAQxtGlobalShortcutPrivate::updateShortcuts(QVector<NativeShortcut>& ungrabs, QVector<NativeShortcut>& grabs)
+{
+    // Nothing is grabbed, a registration only needs the devices read.
+    const bool listening = grabs.isEmpty() || qxt_evdev_start_listener(true);
+    int passive = qxt_atomic_load_relaxed(qxt_evdev_passive_count);
+    for (int i = 0; i < ungrabs.size(); ++i)
+    {
+        const int id = registrations.id(ungrabs.at(i).key, ungrabs.at(i).mods);
+        ungrabs[i].ok = id != 0;
+        if (!id)
+            continue;
+        registrations.remove(id);
+        if (ungrabs.at(i).mods & PassiveFlag)
+            --passive;
+    }
+    for (int i = 0; i < grabs.size(); ++i)
+    {
+        grabs[i].ok = listening;
+        if (!listening || registrations.id(grabs.at(i).key, grabs.at(i).mods))
+            continue;
+        registrations.add(grabs.at(i).key, grabs.at(i).mods);
+        if (grabs.at(i).mods & PassiveFlag)
+            ++passive;
+    }
+    qxt_atomic_store_release(qxt_evdev_passive_count, passive);
+}
+
+void MAQxtGlobalShortcutPrivate::deliverQueuedActivations()
+{
+    if (qxt_evdev_listener)
+        qxt_evdev_listener->deliverQueued();
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeDeliveryMode(MAQxtGlobalShortcut::DeliveryMode mode)
+{
+    // The devices are always read on the listener thread; the event loop
+    // modes differ only in whether the main thread is woken per event.
+    qxt_evdev_queued = mode != MAQxtGlobalShortcut::ListenerThreadDelivery;
+    if (qxt_evdev_listener)
+        qxt_evdev_listener->setQueued(qxt_evdev_queued);
+    return true;
+}
+
+void MAQxtGlobalShortcutPrivate::prepareNativeEventAge()
+{
+}
+
+qint64 MAQxtGlobalShortcutPrivate::nativeEventAge(quint32 eventTime)
+{
+    // Devices stamp events with CLOCK_MONOTONIC, see addDevice().
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const qint32 age = qint32(quint32(quint64(now.tv_sec) * 1000 + now.tv_nsec / 1000000) - eventTime);
+    return age < 0 ? -1 : age;
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeKeyStateTracked(bool tracked)
+{
+    // Every key of the devices read is seen anyway.
+    MAQxtGlobalShortcutListener* listener = tracked ? qxt_evdev_start_listener(true) : qxt_evdev_listener;
+    if (listener)
+        listener->setKeyStateTracked(tracked);
+    return listener || !tracked;
+}
@@ -24,229 +24,439 @@
  ****************************************************************************/
 #include <Carbon/Carbon.h>
 #include "maqxtglobalshortcut_p.h"
-#include <QMap>
-#include <QHash>
+#include "maqxtkeyboardlayoutindex_p.h"
 #include <QtDebug>
-#include <QApplication>
+#include <QCoreApplication>
 
-typedef QPair<uint, uint> Identifier;
-static QMap<quint32, EventHotKeyRef> keyRefs;
-static QHash<Identifier, quint32> keyIDs;
-static quint32 hotKeySerial = 0;
-static bool qxt_mac_handler_installed = false;
+// Indexed by Qt::Key - Qt::Key_Escape.
+static const quint32 qxt_mac_special_keycodes[] =
+{
+    kVK_Escape,                 // Key_Escape
+    kVK_Tab,                    // Key_Tab
+    kVK_Tab,                    // Key_Backtab
+    kVK_Delete,                 // Key_Backspace
+    kVK_Return,                 // Key_Return
+    kVK_ANSI_KeypadEnter,       // Key_Enter
+    0,                          // Key_Insert
+    kVK_ForwardDelete,          // Key_Delete
+    0,                          // Key_Pause
+    0,                          // Key_Print
+    0,                          // Key_SysReq
+    kVK_ANSI_KeypadClear,       // Key_Clear
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    kVK_Home,                   // Key_Home
+    kVK_End,                    // Key_End
+    kVK_LeftArrow,              // Key_Left
+    kVK_UpArrow,                // Key_Up
+    kVK_RightArrow,             // Key_Right
+    kVK_DownArrow,              // Key_Down
+    kVK_PageUp,                 // Key_PageUp
+    kVK_PageDown,               // Key_PageDown
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    kVK_Shift,                  // Key_Shift
+    kVK_Command,                // Key_Control
+    kVK_Control,                // Key_Meta
+    kVK_Option,                 // Key_Alt
+    kVK_CapsLock,               // Key_CapsLock
+    0,                          // Key_NumLock
+    0,                          // Key_ScrollLock
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    kVK_F1,                     // Key_F1
+    kVK_F2,                     // Key_F2
+    kVK_F3,                     // Key_F3
+    kVK_F4,                     // Key_F4
+    kVK_F5,                     // Key_F5
+    kVK_F6,                     // Key_F6
+    kVK_F7,                     // Key_F7
+    kVK_F8,                     // Key_F8
+    kVK_F9,                     // Key_F9
+    kVK_F10,                    // Key_F10
+    kVK_F11,                    // Key_F11
+    kVK_F12,                    // Key_F12
+    kVK_F13,                    // Key_F13
+    kVK_F14,                    // Key_F14
+    kVK_F15,                    // Key_F15
+    kVK_F16,                    // Key_F16
+    kVK_F17,                    // Key_F17
+    kVK_F18,                    // Key_F18
+    kVK_F19,                    // Key_F19
+    kVK_F20,                    // Key_F20
+    0,                          // Key_F21
+    0,                          // Key_F22
+    0,                          // Key_F23
+    0,                          // Key_F24
+    0,                          // Key_F25
+    0,                          // Key_F26
+    0,                          // Key_F27
+    0,                          // Key_F28
+    0,                          // Key_F29
+    0,                          // Key_F30
+    0,                          // Key_F31
+    0,                          // Key_F32
+    0,                          // Key_F33
+    0,                          // Key_F34
+    0,                          // Key_F35
+    0,                          // Key_Super_L
+    0,                          // Key_Super_R
+    0,                          // Key_Menu
+    0,                          // Key_Hyper_L
+    0,                          // Key_Hyper_R
+    kVK_Help,                   // Key_Help
+    0,                          // Key_Direction_L
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // Key_Direction_R
+    0,                          // Key_Back
+    0,                          // Key_Forward
+    0,                          // Key_Stop
+    0,                          // Key_Refresh
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    kVK_VolumeDown,             // Key_VolumeDown
+    kVK_Mute,                   // Key_VolumeMute
+    kVK_VolumeUp,               // Key_VolumeUp
+    0,                          // Key_BassBoost
+    0,                          // Key_BassUp
+    0,                          // Key_BassDown
+    0,                          // Key_TrebleUp
+    0,                          // Key_TrebleDown
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // Key_MediaPlay
+    0,                          // Key_MediaStop
+    0,                          // Key_MediaPrevious
+    0,                          // Key_MediaNext
+    0,                          // Key_MediaRecord
+    0,                          // Key_MediaPause
+    0,                          // Key_MediaTogglePlayPause
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // Key_HomePage
+    0,                          // Key_Favorites
+    0,                          // Key_Search
+    0,                          // Key_Standby
+    0,                          // Key_OpenUrl
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // unassigned
+    0,                          // Key_LaunchMail
+    0,                          // Key_LaunchMedia
+    0,                          // Key_Launch0
+    0,                          // Key_Launch1
+    0,                          // Key_Launch2
+    0,                          // Key_Launch3
+    0,                          // Key_Launch4
+    0,                          // Key_Launch5
+    0,                          // Key_Launch6
+    0,                          // Key_Launch7
+    0,                          // Key_Launch8
+    0,                          // Key_Launch9
+    0,                          // Key_LaunchA
+    0,                          // Key_LaunchB
+    0,                          // Key_LaunchC
+    0,                          // Key_LaunchD
+    0,                          // Key_LaunchE
+    0,                          // Key_LaunchF
+    0,                          // Key_MonBrightnessUp
+    0,                          // Key_MonBrightnessDown
+    0,                          // Key_KeyboardLightOnOff
+    0,                          // Key_KeyboardBrightnessUp
+    0,                          // Key_KeyboardBrightnessDown
+    0,                          // Key_PowerOff
+    0,                          // Key_WakeUp
+    0,                          // Key_Eject
+    0,                          // Key_ScreenSaver
+    0,                          // Key_WWW
+    0,                          // Key_Memo
+    0,                          // Key_LightBulb
+    0,                          // Key_Shop
+    0,                          // Key_History
+    0,                          // Key_AddFavorite
+    0,                          // Key_HotLinks
+    0,                          // Key_BrightnessAdjust
+    0,                          // Key_Finance
+    0,                          // Key_Community
+    0,                          // Key_AudioRewind
+    0,                          // Key_BackForward
+    0,                          // Key_ApplicationLeft
+    0,                          // Key_ApplicationRight
+    0,                          // Key_Book
+    0,                          // Key_CD
+    0,                          // Key_Calculator
+    0,                          // Key_ToDoList
+    0,                          // Key_ClearGrab
+    0,                          // Key_Close
+    0,                          // Key_Copy
+    0,                          // Key_Cut
+    0,                          // Key_Display
+    0,                          // Key_DOS
+    0,                          // Key_Documents
+    0,                          // Key_Excel
+    0,                          // Key_Explorer
+    0,                          // Key_Game
+    0,                          // Key_Go
+    0,                          // Key_iTouch
+    0,                          // Key_LogOff
+    0,                          // Key_Market
+    0,                          // Key_Meeting
+    0,                          // Key_MenuKB
+    0,                          // Key_MenuPB
+    0,                          // Key_MySites
+    0,                          // Key_News
+    0,                          // Key_OfficeHome
+    kVK_Option                  // Key_Option
+};
+
+// Indexed by Qt::Key - Qt::Key_Space, for keys with Qt::KeypadModifier.
+static const quint32 qxt_mac_keypad_keycodes[] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0,                                                         // Space ! " # $ % & '
+    0, 0, kVK_ANSI_KeypadMultiply, kVK_ANSI_KeypadPlus, 0, kVK_ANSI_KeypadMinus,
+    kVK_ANSI_KeypadDecimal, kVK_ANSI_KeypadDivide,                                  // ( ) * + , - . /
+    kVK_ANSI_Keypad0, kVK_ANSI_Keypad1, kVK_ANSI_Keypad2, kVK_ANSI_Keypad3,
+    kVK_ANSI_Keypad4, kVK_ANSI_Keypad5, kVK_ANSI_Keypad6, kVK_ANSI_Keypad7,         // 0 - 7
+    kVK_ANSI_Keypad8, kVK_ANSI_Keypad9, 0, 0, 0, kVK_ANSI_KeypadEquals              // 8 9 : ; < =
+};
+
+// Indexed by Qt::Key - Qt::Key_Escape, for keys with Qt::KeypadModifier.
+static const quint32 qxt_mac_keypad_special_keycodes[] =
+{
+    0, 0, 0, 0, 0, kVK_ANSI_KeypadEnter, 0, 0,                                      // Escape Tab Backtab Backspace Return Enter Insert Delete
+    0, 0, 0, kVK_ANSI_KeypadClear                                                   // Pause Print SysReq Clear
+};
+
+// Indexed by MAQxtGlobalShortcutPrivate::modifierIndex(); Qt's Control is Command.
+static const quint32 qxt_mac_modifiers[] =
+    MAQXT_MODIFIER_TABLE(shiftKey, cmdKey, optionKey, controlKey);
+
+#define QXT_MAC_TABLE_SIZE(table) quint32(sizeof(table) / sizeof(table[0]))
+
+// Character to virtual keycode, for the current input source; built on
+// first use after a change. Guarded by MAQxtGlobalShortcutPrivate::mutex.
+static MAQxtKeyboardLayoutIndex qxt_mac_layout_index;
+static bool qxt_mac_layout_index_valid = false;
 
 OSStatus qxt_mac_handle_hot_key(EventHandlerCallRef nextHandler, EventRef event, void* data)
 {
     Q_UNUSED(nextHandler);
     Q_UNUSED(data);
-    if (GetEventClass(event) == kEventClassKeyboard && GetEventKind(event) == kEventHotKeyPressed)
+    const UInt32 kind = GetEventKind(event);
+    if (GetEventClass(event) == kEventClassKeyboard && (kind == kEventHotKeyPressed || kind == kEventHotKeyReleased))
     {
         EventHotKeyID keyID;
         GetEventParameter(event, kEventParamDirectObject, typeEventHotKeyID, NULL, sizeof(keyID), NULL, &keyID);
-        Identifier id = keyIDs.key(keyID.id);
-        MAQxtGlobalShortcutPrivate::activateShortcut(id.second, id.first);
+        const MAQxtGlobalShortcutRegistry::Registration* registration = MAQxtGlobalShortcutPrivate::registrations.registration(keyID.id);
+        const quint32 eventTime = quint32(quint64(GetEventTime(event) * 1000));
+        if (registration && kind == kEventHotKeyPressed)
+            MAQxtGlobalShortcutPrivate::activateShortcut(registration->nativeKey, registration->nativeMods, eventTime);
+        else if (registration)
+            MAQxtGlobalShortcutPrivate::releaseShortcut(registration->nativeKey, registration->nativeMods, eventTime);
     }
     return noErr;
 }
 
+static void qxt_mac_input_source_changed(CFNotificationCenterRef center, void* observer, CFStringRef name,
+                                         const void* object, CFDictionaryRef userInfo)
+{
+    Q_UNUSED(center);
+    Q_UNUSED(observer);
+    Q_UNUSED(name);
+    Q_UNUSED(object);
+    Q_UNUSED(userInfo);
+    MAQxtGlobalShortcutLocker locker;
+    qxt_mac_layout_index_valid = false;
+    MAQxtGlobalShortcutPrivate::keyboardLayoutChanged();
+}
+
+bool MAQxtGlobalShortcutPrivate::nativeReleaseEvents()
+{
+    // Carbon reports the release of hot keys.
+    return true;
+}
+
 quint32 MAQxtGlobalShortcutPrivate::nativeModifiers(Qt::KeyboardModifiers modifiers)
 {
-    quint32 native = 0;
-    if (modifiers & Qt::ShiftModifier)
-        native |= shiftKey;
-    if (modifiers & Qt::ControlModifier)
-        native |= cmdKey;
-    if (modifiers & Qt::AltModifier)
-        native |= optionKey;
-    if (modifiers & Qt::MetaModifier)
-        native |= controlKey;
-    if (modifiers & Qt::KeypadModifier)
-        native |= kEventKeyModifierNumLockMask;
-    return native;
+    const quint32 native = qxt_mac_modifiers[modifierIndex(modifiers)];
+    return (modifiers & Qt::KeypadModifier) ? native | kEventKeyModifierNumLockMask : native;
 }
 
-quint32 MAQxtGlobalShortcutPrivate::nativeKeycode(Qt::Key key)
+quint32 MAQxtGlobalShortcutPrivate::nativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers)
 {
-    UTF16Char ch;
-    // Constants found in NSEvent.h from AppKit.framework
-    switch (key)
+    const quint32 code = key;
+    if (modifiers & Qt::KeypadModifier)
     {
-    case Qt::Key_Return:
-        return kVK_Return;
-    case Qt::Key_Enter:
-        return kVK_ANSI_KeypadEnter;
-    case Qt::Key_Tab:
-        return kVK_Tab;
-    case Qt::Key_Space:
-        return kVK_Space;
-    case Qt::Key_Backspace:
-        return kVK_Delete;
-    case Qt::Key_Control:
-        return kVK_Command;
-    case Qt::Key_Shift:
-        return kVK_Shift;
-    case Qt::Key_CapsLock:
-        return kVK_CapsLock;
-    case Qt::Key_Option:
-        return kVK_Option;
-    case Qt::Key_Meta:
-        return kVK_Control;
-    case Qt::Key_F17:
-        return kVK_F17;
-    case Qt::Key_VolumeUp:
-        return kVK_VolumeUp;
-    case Qt::Key_VolumeDown:
-        return kVK_VolumeDown;
-    case Qt::Key_F18:
-        return kVK_F18;
-    case Qt::Key_F19:
-        return kVK_F19;
-    case Qt::Key_F20:
-        return kVK_F20;
-    case Qt::Key_F5:
-        return kVK_F5;
-    case Qt::Key_F6:
-        return kVK_F6;
-    case Qt::Key_F7:
-        return kVK_F7;
-    case Qt::Key_F3:
-        return kVK_F3;
-    case Qt::Key_F8:
-        return kVK_F8;
-    case Qt::Key_F9:
-        return kVK_F9;
-    case Qt::Key_F11:
-        return kVK_F11;
-    case Qt::Key_F13:
-        return kVK_F13;
-    case Qt::Key_F16:
-        return kVK_F16;
-    case Qt::Key_F14:
-        return kVK_F14;
-    case Qt::Key_F10:
-        return kVK_F10;
-    case Qt::Key_F12:
-        return kVK_F12;
-    case Qt::Key_F15:
-        return kVK_F15;
-    case Qt::Key_Help:
-        return kVK_Help;
-    case Qt::Key_Home:
-        return kVK_Home;
-    case Qt::Key_PageUp:
-        return kVK_PageUp;
-    case Qt::Key_Delete:
-        return kVK_ForwardDelete;
-    case Qt::Key_F4:
-        return kVK_F4;
-    case Qt::Key_End:
-        return kVK_End;
-    case Qt::Key_F2:
-        return kVK_F2;
-    case Qt::Key_PageDown:
-        return kVK_PageDown;
-    case Qt::Key_F1:
-        return kVK_F1;
-    case Qt::Key_Left:
-        return kVK_LeftArrow;
-    case Qt::Key_Right:
-        return kVK_RightArrow;
-    case Qt::Key_Down:
-        return kVK_DownArrow;
-    case Qt::Key_Up:
-        return kVK_UpArrow;
-    default:
-        ;
+        if (code - Qt::Key_Space < QXT_MAC_TABLE_SIZE(qxt_mac_keypad_keycodes) && qxt_mac_keypad_keycodes[code - Qt::Key_Space])
+            return qxt_mac_keypad_keycodes[code - Qt::Key_Space];
+        if (code - Qt::Key_Escape < QXT_MAC_TABLE_SIZE(qxt_mac_keypad_special_keycodes) && qxt_mac_keypad_special_keycodes[code - Qt::Key_Escape])
+            return qxt_mac_keypad_special_keycodes[code - Qt::Key_Escape];
     }
+    if (code >= Qt::Key_Escape)
+        return code - Qt::Key_Escape < QXT_MAC_TABLE_SIZE(qxt_mac_special_keycodes) ? qxt_mac_special_keycodes[code - Qt::Key_Escape] : 0;
 
-    if (key == Qt::Key_Escape)	ch = 27;
-    else if (key == Qt::Key_Return) ch = 13;
-    else if (key == Qt::Key_Enter) ch = 3;
-    else if (key == Qt::Key_Tab) ch = 9;
-    else ch = key;
+    // Character keys depend on the keyboard layout.
+    if (!qxt_mac_layout_index_valid)
+    {
+        qxt_mac_layout_index_valid = true;
+        qxt_mac_layout_index.clear();
+        TISInputSourceRef currentKeyboard = TISCopyCurrentKeyboardInputSource();
+        if (currentKeyboard == NULL)
+            return 0;
+        CFDataRef currentLayoutData = (CFDataRef)TISGetInputSourceProperty(currentKeyboard, kTISPropertyUnicodeKeyLayoutData);
+        if (currentLayoutData != NULL)
+            qxt_mac_layout_index.build(CFDataGetBytePtr(currentLayoutData), int(CFDataGetLength(currentLayoutData)));
+        CFRelease(currentKeyboard);
+    }
+    // 0 stands for no keycode, as kVK_ANSI_A always has.
+    const int keycode = qxt_mac_layout_index.keycode(UTF16Char(key));
+    return keycode > 0 ? quint32(keycode) : 0;
+}
 
-    CFDataRef currentLayoutData;
-    TISInputSourceRef currentKeyboard = TISCopyCurrentKeyboardInputSource();
+static void qxt_mac_install_handler()
+{
+    EventTypeSpec t[2];
+    t[0].eventClass = kEventClassKeyboard;
+    t[0].eventKind = kEventHotKeyPressed;
+    t[1].eventClass = kEventClassKeyboard;
+    t[1].eventKind = kEventHotKeyReleased;
+    InstallApplicationEventHandler(&qxt_mac_handle_hot_key, 2, t, NULL, NULL);
+    CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(), NULL, &qxt_mac_input_source_changed,
+                                    kTISNotifySelectedKeyboardInputSourceChanged, NULL,
+                                    CFNotificationSuspensionBehaviorDeliverImmediately);
+}
 
+quint64 MAQxtGlobalShortcutPrivate::nativeLayoutFingerprint()
+{
+    // Character keys resolve through the 'uchr' data of the input source;
+    // hashing it is cheaper than indexing it.
+    TISInputSourceRef currentKeyboard = TISCopyCurrentKeyboardInputSource();
     if (currentKeyboard == NULL)
         return 0;
-
-    currentLayoutData = (CFDataRef)TISGetInputSourceProperty(currentKeyboard, kTISPropertyUnicodeKeyLayoutData);
-    CFRelease(currentKeyboard);
-    if (currentLayoutData == NULL)
-        return 0;
-
-    UCKeyboardLayout* header = (UCKeyboardLayout*)CFDataGetBytePtr(currentLayoutData);
-    UCKeyboardTypeHeader* table = header->keyboardTypeList;
-
-    uint8_t *data = (uint8_t*)header;
-    // God, would a little documentation for this shit kill you...
-    for (quint32 i=0; i < header->keyboardTypeCount; i++)
+    quint64 hash = 0;
+    CFDataRef currentLayoutData = (CFDataRef)TISGetInputSourceProperty(currentKeyboard, kTISPropertyUnicodeKeyLayoutData);
+    if (currentLayoutData != NULL)
     {
-        UCKeyStateRecordsIndex* stateRec = 0;
-        if (table[i].keyStateRecordsIndexOffset != 0)
-        {
-            stateRec = reinterpret_cast<UCKeyStateRecordsIndex*>(data + table[i].keyStateRecordsIndexOffset);
-            if (stateRec->keyStateRecordsIndexFormat != kUCKeyStateRecordsIndexFormat) stateRec = 0;
-        }
-
-        UCKeyToCharTableIndex* charTable = reinterpret_cast<UCKeyToCharTableIndex*>(data + table[i].keyToCharTableIndexOffset);
-        if (charTable->keyToCharTableIndexFormat != kUCKeyToCharTableIndexFormat) continue;
-
-        for (quint32 j=0; j < charTable->keyToCharTableCount; j++)
-        {
-            UCKeyOutput* keyToChar = reinterpret_cast<UCKeyOutput*>(data + charTable->keyToCharTableOffsets[j]);
-            for (quint32 k=0; k < charTable->keyToCharTableSize; k++)
-            {
-                if (keyToChar[k] & kUCKeyOutputTestForIndexMask)
-                {
-                    long idx = keyToChar[k] & kUCKeyOutputGetIndexMask;
-                    if (stateRec && idx < stateRec->keyStateRecordCount)
-                    {
-                        UCKeyStateRecord* rec = reinterpret_cast<UCKeyStateRecord*>(data + stateRec->keyStateRecordOffsets[idx]);
-                        if (rec->stateZeroCharData == ch) return k;
-                    }
-                }
-                else if (!(keyToChar[k] & kUCKeyOutputSequenceIndexMask) && keyToChar[k] < 0xFFFE)
-                {
-                    if (keyToChar[k] == ch) return k;
-                }
-            } // for k
-        } // for j
-    } // for i
-    return 0;
+        hash = MAQxtKeycodeCache::fingerprint(MAQxtKeycodeCache::FingerprintBasis, "carbon", 6);
+        hash = MAQxtKeycodeCache::fingerprint(hash, CFDataGetBytePtr(currentLayoutData), int(CFDataGetLength(currentLayoutData)));
+    }
+    CFRelease(currentKeyboard);
+    return hash;
 }
 
 bool MAQxtGlobalShortcutPrivate::registerShortcut(quint32 nativeKey, quint32 nativeMods)
 {
-    if (!qxt_mac_handler_installed)
-    {
-        EventTypeSpec t;
-        t.eventClass = kEventClassKeyboard;
-        t.eventKind = kEventHotKeyPressed;
-        InstallApplicationEventHandler(&qxt_mac_handle_hot_key, 1, &t, NULL, NULL);
-    }
+    // There is no way to observe keys without registering them.
+    if (nativeMods & PassiveFlag)
+        return false;
+    registrations.installHandler(qxt_mac_install_handler);
 
     EventHotKeyID keyID;
     keyID.signature = 'cute';
-    keyID.id = ++hotKeySerial;
+    keyID.id = registrations.add(nativeKey, nativeMods);
 
     EventHotKeyRef ref = 0;
     bool rv = !RegisterEventHotKey(nativeKey, nativeMods, keyID, GetApplicationEventTarget(), 0, &ref);
     if (rv)
-    {
-        keyIDs.insert(Identifier(nativeMods, nativeKey), keyID.id);
-        keyRefs.insert(keyID.id, ref);
-    }
+        registrations.setHandle(keyID.id, ref);
+    else
+        registrations.remove(keyID.id);
     return rv;
 }
 
 bool MAQxtGlobalShortcutPrivate::unregisterShortcut(quint32 nativeKey, quint32 nativeMods)
 {
-    Identifier id(nativeMods, nativeKey);
-    if (!keyIDs.contains(id)) return false;
+    const int id = registrations.id(nativeKey, nativeMods);
+    const MAQxtGlobalShortcutRegistry::Registration* registration = registrations.registration(id);
+    if (!registration)
+        return false;
 
-    EventHotKeyRef ref = keyRefs.take(keyIDs[id]);
-    keyIDs.remove(id);
+    EventHotKeyRef ref = static_cast<EventHotKeyRef>(registration->handle);
+    registrations.remove(id);
     return !UnregisterEventHotKey(ref);
 }
+
+void MAQxtGlobalShortcutPrivate::updateShortcuts(QVector<NativeShortcut>& ungrabs, QVector<NativeShortcut>& grabs)
+{
+    for (int i = 0; i < ungrabs.size(); ++i)
+        ungrabs[i].ok = unregisterShortcut(ungrabs.at(i).key, ungrabs.at(i).mods);
+    for (int i = 0; i < grabs.size(); ++i)
+        grabs[i].ok = registerShortcut(grabs.at(i).key, grabs.at(i).mods);
+}
+
+void MAQxtGlobalShortcutPrivate::deliverQueuedActivations()
+{
+    // Hot key events are handled as they arrive on the main thread.
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeDeliveryMode(MAQxtGlobalShortcut::DeliveryMode mode)
+{
+    // Carbon hot key events are dispatched to the application event target on the main thread.
+    return mode == MAQxtGlobalShortcut::EventLoopDelivery;
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeKeyStateTracked(bool tracked)
+{
+    // Carbon only reports the hot keys registered.
+    return !tracked;
+}
+
+void MAQxtGlobalShortcutPrivate::prepareNativeEventAge()
+{
+}
+
+qint64 MAQxtGlobalShortcutPrivate::nativeEventAge(quint32 eventTime)
+{
+    // Event times are seconds since boot, like GetCurrentEventTime().
+    return qint32(quint32(quint64(GetCurrentEventTime() * 1000)) - eventTime);
+}
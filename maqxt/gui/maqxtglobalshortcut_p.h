@@ -26,9 +26,50 @@
 #define MAQXTGLOBALSHORTCUT_P_H
 
 #include "maqxtglobalshortcut.h"
+#include "maqxtglobalshortcutregistry_p.h"
+#include "maqxtkeycodecache_p.h"
+#include "maqxtkeystate_p.h"
+#include "maqxtrcupointer_p.h"
+#include "maqxtglobalshortcutstatistics_p.h"
+#include "maqxtglobalshortcuttable_p.h"
+#include "maqxtglobalshortcuttrace_p.h"
+#include "maqxtglobalshortcuttrie_p.h"
 #include <QAbstractEventDispatcher>
+#include <QElapsedTimer>
 #include <QKeySequence>
 #include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QThread>
+#include <QVector>
+
+#if QT_VERSION >= 0x050000
+#include <QAbstractNativeEventFilter>
+#endif
+
+// Qt 5 dropped the Q_WS_* window system macros; Q_OS_MAC is defined by all
+// versions and always means the Carbon backend here. The evdev backend is
+// chosen at build time (MAQXT_EVDEV_BACKEND). The X11 and Windows backends
+// see their events through a native event filter.
+#if defined(Q_OS_MAC)
+#  define MAQXT_CARBON_BACKEND
+#elif !defined(MAQXT_EVDEV_BACKEND)
+#  define MAQXT_NATIVE_EVENT_FILTER
+#endif
+
+#if QT_VERSION >= 0x060000
+typedef QRecursiveMutex MAQxtRecursiveMutex;
+#else
+typedef QMutex MAQxtRecursiveMutex;
+#endif
+
+// Expands to the initializer of a table holding the native modifier mask for
+// every combination of Shift (S), Control (C), Alt (A) and Meta (M), indexed
+// by MAQxtGlobalShortcutPrivate::modifierIndex().
+#define MAQXT_MODIFIER_TABLE(S, C, A, M) \
+    { 0, (S), (C), (S) | (C), (A), (S) | (A), (C) | (A), (S) | (C) | (A), \
+      (M), (S) | (M), (C) | (M), (S) | (C) | (M), (A) | (M), (S) | (A) | (M), (C) | (A) | (M), (S) | (C) | (A) | (M) }
 
 class MAQxtGlobalShortcutPrivate : public MAQxtPrivate<MAQxtGlobalShortcut>
 {
@@ -37,30 +78,336 @@ public:
     MAQxtGlobalShortcutPrivate();
     ~MAQxtGlobalShortcutPrivate();
 
+    // Allocated from a pool, so that MAQxtPrivateInterface's new and delete
+    // do not hit the heap for every shortcut.
+    static void* operator new(size_t size);
+    static void operator delete(void* pointer);
+
+    struct NativeShortcut
+    {
+        quint32 key;
+        quint32 mods;
+        bool ok;
+    };
+
+    // A shortcut leaving the combination 'from' and/or joining 'to'.
+    struct SubscriptionMove
+    {
+        MAQxtGlobalShortcut* shortcut;
+        quint64 from;
+        quint64 to;
+        bool leaves;
+        bool joins;
+        bool ok;
+    };
+
+    struct BatchOperation
+    {
+        enum Type { Set, Unset, Enable };
+        Type type;
+        MAQxtGlobalShortcut* shortcut;
+        QKeySequence sequence;
+        bool enabled;
+        bool ok;
+    };
+
     bool enabled;
     Qt::Key key;
     Qt::KeyboardModifiers mods;
+    QKeySequence chords; // the whole sequence of a multi-chord shortcut, else empty
+    quint64 activations; // counted while statistics are enabled
+    MAQxtGlobalShortcut* nextSubscriber; // next shortcut on the same native combination
+    MAQxtGlobalShortcut::RepeatPolicy repeatPolicy;
+    int repeatInterval;     // for ThrottleRepeats, in milliseconds
+    quint32 lastActivation; // native time of the last activated() while the key is held
+    int pendingRepeats;     // repeats not passed on yet
+    int repeatCount;        // reported by repeatCount() during activated()
+    bool coalescing;        // listed in coalescedShortcuts
+    bool passive;           // observed without a grab, see PassiveFlag
 
     bool setShortcut(const QKeySequence& shortcut);
     bool unsetShortcut();
+    void setEnabled(bool enabled);
 
-    static bool error;
-#ifndef Q_WS_MAC
-    static int ref;
-    static QAbstractEventDispatcher::EventFilter prevEventFilter;
+    static bool applyBatch(QVector<BatchOperation>& operations, bool atomic);
+    // Tells for each candidate whether all its chords could be grabbed,
+    // without keeping any of the grabs.
+    static QVector<bool> probeShortcuts(const QList<QKeySequence>& candidates);
+    // Set while probing; backends do not warn about failed grabs then.
+    static bool probing;
+
+    // Set in the native modifiers of passive shortcuts. Backends observe
+    // such combinations instead of grabbing them, or fail to register them.
+    static const quint32 PassiveFlag = 0x80000000u;
+    quint64 nativeCombination(Qt::Key key, Qt::KeyboardModifiers mods) const;
+
+#ifdef MAQXT_NATIVE_EVENT_FILTER
+    // Handles one native event: an XEvent with Qt 4 on X11, an
+    // xcb_generic_event_t with Qt 5 and later, a MSG on Windows. Never
+    // consumes the event.
     static bool eventFilter(void* message);
-#endif // Q_WS_MAC
+    // Installs or removes the filter to match whether shortcuts exist.
+    static void syncEventFilter();
+#endif // MAQXT_NATIVE_EVENT_FILTER
+#ifdef MAQXT_EVDEV_BACKEND
+    // Reads key events from an input device descriptor, see
+    // MAQxtGlobalShortcut::addInputDevice().
+    static bool addInputDevice(int fd);
+    static bool removeInputDevice(int fd);
+#endif
 
-    static void activateShortcut(quint32 nativeKey, quint32 nativeMods);
+    // 'eventTime' is the native event's timestamp in milliseconds, in
+    // whatever time base nativeEventAge() understands.
+    static void activateShortcut(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+    // Called by backends that see key releases, with the same time base.
+    // Only PassiveFlag of 'nativeMods' is looked at.
+    static void releaseShortcut(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+    // Like the above, but not recorded to 'trace'.
+    static void pressKey(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+    static void releaseKey(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+    // Emits the repeats coalesced since the last call.
+    static void flushCoalescedRepeats();
+    // Dispatches the activations a listener thread has queued for the main
+    // thread right away. Only called by the main thread.
+    static void deliverQueuedActivations();
+    // Native registrations currently held by the backend.
+    static MAQxtGlobalShortcutRegistry registrations;
+    // Called by the backends when the keyboard mapping has changed.
+    static void keyboardLayoutChanged();
+    // Drops a pending chord prefix once the chord timeout has passed.
+    static void chordTimedOut();
+    static int chordTimeout;
+
+    // Releases the grabs of combinations whose subscribers are all disabled
+    // and takes back the others, for every combination in 'staleGrabs'.
+    static void syncGrabs();
+    static void scheduleGrabSync(quint64 key);
+    static bool ungrabWhenDisabled;
+    // Guards all shared state; shortcuts may be changed from any thread and
+    // activated on a backend listener thread. Recursive, since writers call
+    // each other. Only ever taken through MAQxtGlobalShortcutLocker.
+    static MAQxtRecursiveMutex mutex;
+    static void lock();
+    static void unlock();
+    static MAQxtGlobalShortcut::DeliveryMode deliveryMode;
+    static MAQxtGlobalShortcutStatisticsCollector statistics;
+    // Records what reaches activateShortcut() and releaseShortcut().
+    static MAQxtGlobalShortcutTrace trace;
+    // Keys held down and modifiers in effect, kept current by the backend
+    // while 'keyStateTracked' is set; see MAQxtGlobalShortcut::isKeyPressed().
+    static MAQxtKeyState keyState;
+    static bool keyStateTracked;
+    static bool isKeyPressed(Qt::Key key);
+    static Qt::KeyboardModifiers keyboardModifiers();
+    static bool setKeycodeCacheFile(const QString& fileName);
+    static QString keycodeCacheFile();
 
 private:
-    static quint32 nativeKeycode(Qt::Key keycode);
+    static inline int modifierIndex(Qt::KeyboardModifiers modifiers)
+    {
+        // Qt::ShiftModifier, ControlModifier, AltModifier and MetaModifier are bits 25 to 28.
+        return (int(modifiers) >> 25) & 0xf;
+    }
+
+    static quint32 nativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers);
     static quint32 nativeModifiers(Qt::KeyboardModifiers modifiers);
+    static quint32 cachedNativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers);
+
+    static void splitChord(int chord, Qt::Key& key, Qt::KeyboardModifiers& mods);
+    static inline int chordAt(const QKeySequence& sequence, uint index)
+    {
+#if QT_VERSION >= 0x060000
+        return sequence[index].toCombined();
+#else
+        return sequence[index];
+#endif
+    }
+    static void splitShortcut(const QKeySequence& shortcut, Qt::Key& key, Qt::KeyboardModifiers& mods);
+
+    // Multi-chord shortcuts live in 'chordTrie'. Only the first chords are
+    // grabbed for good; the chords that may follow a pending prefix are
+    // grabbed while it is pending.
+    bool setChordShortcut(const QKeySequence& shortcut);
+    bool unsetChordShortcut();
+    static QVector<quint64> nativeChords(const QKeySequence& shortcut);
+    // Whether we hold a native grab on 'chord', or may take one any time.
+    static bool isGrabbedByUs(quint64 chord);
+    static bool dispatchChord(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+    static void advanceChord(int node);
+    static void cancelChord();
+    static void rebuildChords();
 
     static bool registerShortcut(quint32 nativeKey, quint32 nativeMods);
     static bool unregisterShortcut(quint32 nativeKey, quint32 nativeMods);
+    // Releases 'ungrabs' and then registers 'grabs', setting 'ok' on each
+    // entry. Backends with a server round-trip pipeline all requests and
+    // wait for the server only once.
+    static void updateShortcuts(QVector<NativeShortcut>& ungrabs, QVector<NativeShortcut>& grabs);
+    // Moves the native grabs to the delivery path for 'mode'. Must not be
+    // called with the mutex held, a listener thread may have to be joined.
+    static bool setNativeDeliveryMode(MAQxtGlobalShortcut::DeliveryMode mode);
+    // Starts or stops following every key press and release into
+    // 'keyState', reading the current state when starting. Called with the
+    // mutex held; fails if the backend cannot observe all keys.
+    static bool setNativeKeyStateTracked(bool tracked);
+    // Identifies the keyboard mapping that nativeKeycode() resolves
+    // against, or 0 if the backend cannot tell. Much cheaper than
+    // resolving every key, at most a single server round-trip.
+    static quint64 nativeLayoutFingerprint();
+    // Does whatever nativeEventAge() needs up front, such as a server
+    // round-trip, when statistics are enabled. Called without the mutex.
+    static void prepareNativeEventAge();
+    // Milliseconds since the native event stamped 'eventTime', or -1 if
+    // the backend cannot tell. Only called while statistics are enabled,
+    // with the mutex held; never blocks.
+    static qint64 nativeEventAge(quint32 eventTime);
+    static void countActivation(const MAQxtGlobalShortcutTable::Entry* entry, quint32 eventTime);
 
-    static QHash<QPair<quint32, quint32>, MAQxtGlobalShortcut*> shortcuts;
+    // Key events are looked up in an immutable snapshot of the dispatch
+    // state without taking the mutex, which is only taken for a match, to
+    // queue its signals. Writers mark the snapshot stale, and the outermost
+    // unlock() publishes a fresh one before releasing the mutex. Under the
+    // mutex the entry found is used as long as the snapshot is current.
+    struct DispatchSnapshot
+    {
+        DispatchSnapshot();
+        void add(quint64 combination);
+        bool isChord(quint64 combination) const;
+
+        // False if no combination can match, judged from a bitmap of the
+        // keycodes below 256 and the union of all modifier masks.
+        inline bool mayContain(quint32 nativeKey, quint32 nativeMods) const
+        {
+            if (nativeMods & ~modifierUnion)
+                return false;
+            if (nativeKey < 256)
+                return keyBits[nativeKey >> 5] & (1u << (nativeKey & 31));
+            return wideKeys;
+        }
+
+        MAQxtGlobalShortcutTable table; // every single-chord combination
+        QVector<quint64> chords;        // sorted; first chords and those following the pending prefix
+        quint32 keyBits[8];
+        quint32 modifierUnion;
+        bool wideKeys;
+        bool statistics;                // collected when published
+    };
+    static MAQxtRcuPointer<DispatchSnapshot> snapshot;
+    static bool snapshotStale;
+    static void invalidateSnapshot();
+    static void publishSnapshot();
+    static void dispatchPress(quint32 nativeKey, quint32 nativeMods, quint32 eventTime, const MAQxtGlobalShortcutTable::Entry* entry);
+    static void dispatchRelease(quint32 nativeKey, quint32 nativeMods, quint32 eventTime);
+
+    // Key presses, auto-repeats and releases pass through the repeat policy
+    // of each shortcut before any signal is emitted. A press of a key that
+    // is held already is a repeat; this needs a backend that reports
+    // releases, and reports auto-repeat as presses only.
+    enum KeyEvent { PressEvent, RepeatEvent, ReleaseEvent };
+    struct HeldKey
+    {
+        quint32 nativeKey;
+        bool passive;
+        quint64 combination;                // table entry activated by the press
+        MAQxtGlobalShortcut* chordShortcut; // or the multi-chord shortcut completed by it
+        quint32 pressTime;
+        quint32 lastTime;                   // of the press or the latest repeat
+    };
+    static bool nativeReleaseEvents();
+    static int heldKeyIndex(quint32 nativeKey, quint32 nativeMods);
+    // Keycodes of 'heldKeys' for the dispatch without the mutex: bits for
+    // those below 256, and a count of the others.
+    static QAtomicInt heldKeyBits[8];
+    static QAtomicInt heldWideKeys;
+    static void updateHeldKeyBits();
+    static inline bool mayBeHeld(quint32 nativeKey)
+    {
+        if (nativeKey < 256)
+            return qxt_atomic_load_relaxed(heldKeyBits[nativeKey >> 5]) & (1 << (nativeKey & 31));
+        return qxt_atomic_load_relaxed(heldWideKeys) != 0;
+    }
+    static void notifySubscribers(const MAQxtGlobalShortcutTable::Entry* entry, KeyEvent event, quint32 eventTime, int holdDuration);
+    void notify(KeyEvent event, quint32 eventTime, int holdDuration);
+    void queueActivated(int repeats);
+    void dropRepeatState();
+
+    // Signals are queued while the mutex is held and emitted by the
+    // outermost unlock() of the same thread, with the mutex released, so
+    // that receivers may block or change shortcuts. A batch being emitted
+    // is listed in 'emissionBatches' until it is done.
+    struct Emission
+    {
+        MAQxtGlobalShortcut* shortcut; // cleared when it is deleted first
+        bool released;
+        int value;                     // repeats, or the hold duration
+    };
+    struct EmissionBatch
+    {
+        QThread* thread;
+        QVector<Emission> emissions;
+        int current;                   // being emitted, or -1
+    };
+    static int lockDepth; // of the thread holding the mutex
+    static QVector<Emission> pendingEmissions;
+    static QList<EmissionBatch*> emissionBatches;
+    static void emitPending();
+    // Forgets the queued signals of a shortcut about to be deleted, and
+    // waits for receivers of its signals running on other threads.
+    // Called with the mutex held once.
+    static void dropEmissions(MAQxtGlobalShortcut* shortcut);
+
+    // Shortcuts on the same native combination share one native grab, made
+    // for the first and released with the last of them.
+    static bool isSubscribed(quint64 key, const MAQxtGlobalShortcut* shortcut);
+    static int subscriberCount(quint64 key);
+    static void subscribe(quint64 key, MAQxtGlobalShortcut* shortcut);
+    static bool unsubscribe(quint64 key, MAQxtGlobalShortcut* shortcut);
+    static void updateEnabledFlag(quint64 key);
+    // Forgets a combination and all its subscribers.
+    static void dropSubscribers(quint64 key);
+    // Applies all moves with a single native update; in atomic mode
+    // nothing changes unless every grab succeeds.
+    static bool moveSubscriptions(QVector<SubscriptionMove>& moves, bool atomic);
+
+#ifdef MAQXT_NATIVE_EVENT_FILTER
+    // The native event filter is installed with the first shortcut and
+    // removed with the last one, always by the main thread.
+    static int ref;
+    static void scheduleFilterSync();
+#if QT_VERSION < 0x050000
+    // Qt 4 has a single filter slot; the one found there is called after ours.
+    static QAbstractEventDispatcher::EventFilter prevEventFilter;
+    static bool chainEventFilter(void* message);
+#endif
+#endif // MAQXT_NATIVE_EVENT_FILTER
+
+    static MAQxtGlobalShortcutTable shortcuts;
+    static MAQxtGlobalShortcutTrie chordTrie;
+    static int pendingChord;                    // trie node matched so far
+    static QVector<NativeShortcut> chordGrabs;  // grabs held for pendingChord
+    static QElapsedTimer chordClock;            // started when pendingChord was reached
+    static QSet<quint64> releasedGrabs;         // subscribed combinations not grabbed
+    static QSet<quint64> staleGrabs;            // combinations to look at in syncGrabs()
+    static QVector<HeldKey> heldKeys;           // activating keys not released yet
+    static QList<MAQxtGlobalShortcut*> coalescedShortcuts; // with repeats to flush
+    // Native keycodes resolved for the current keyboard layout, and those
+    // kept on disk from earlier runs; see MAQxtGlobalShortcut::setKeycodeCacheFile().
+    static QHash<int, quint32> keycodes;
+    static MAQxtKeycodeCache keycodeCache;
+    static void saveKeycodeCache();
+};
+
+// Holds MAQxtGlobalShortcutPrivate::mutex for its scope. When a thread's
+// outermost locker goes, the dispatch snapshot is brought up to date and
+// the signals queued meanwhile are emitted.
+class MAQxtGlobalShortcutLocker
+{
+public:
+    inline MAQxtGlobalShortcutLocker() { MAQxtGlobalShortcutPrivate::lock(); }
+    inline ~MAQxtGlobalShortcutLocker() { MAQxtGlobalShortcutPrivate::unlock(); }
+
+private:
+    Q_DISABLE_COPY(MAQxtGlobalShortcutLocker)
 };
 
 #endif // MAQXTGLOBALSHORTCUT_P_H
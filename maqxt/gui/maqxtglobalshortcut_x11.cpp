@@ -0,0 +1,1325 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcut_p.h"
+#include "maqxtspscring_p.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QThread>
+#include <QtDebug>
+#if QT_VERSION >= 0x060000
+#include <QGuiApplication>
+#else
+#include <QX11Info>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
+#include <X11/keysym.h>
+#include <X11/XF86keysym.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XInput2.h>
+#include <X11/extensions/XI2proto.h>
+#include <xcb/xcb.h>
+
+// Grabs are also made with NumLock (Mod2) set, so that they keep working
+// while it is on. The event filter masks it out again.
+static const quint16 qxt_x_lock_variants[] = { 0, XCB_MOD_MASK_2 };
+static const int qxt_x_lock_variant_count = sizeof(qxt_x_lock_variants) / sizeof(qxt_x_lock_variants[0]);
+
+// Indexed by Qt::Key - Qt::Key_Escape.
+static const quint32 qxt_x_special_keysyms[] =
+{
+    XK_Escape,                      // Key_Escape
+    XK_Tab,                         // Key_Tab
+    XK_ISO_Left_Tab,                // Key_Backtab
+    XK_BackSpace,                   // Key_Backspace
+    XK_Return,                      // Key_Return
+    XK_KP_Enter,                    // Key_Enter
+    XK_Insert,                      // Key_Insert
+    XK_Delete,                      // Key_Delete
+    XK_Pause,                       // Key_Pause
+    XK_Print,                       // Key_Print
+    XK_Sys_Req,                     // Key_SysReq
+    XK_Clear,                       // Key_Clear
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XK_Home,                        // Key_Home
+    XK_End,                         // Key_End
+    XK_Left,                        // Key_Left
+    XK_Up,                          // Key_Up
+    XK_Right,                       // Key_Right
+    XK_Down,                        // Key_Down
+    XK_Prior,                       // Key_PageUp
+    XK_Next,                        // Key_PageDown
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XK_Shift_L,                     // Key_Shift
+    XK_Control_L,                   // Key_Control
+    XK_Meta_L,                      // Key_Meta
+    XK_Alt_L,                       // Key_Alt
+    XK_Caps_Lock,                   // Key_CapsLock
+    XK_Num_Lock,                    // Key_NumLock
+    XK_Scroll_Lock,                 // Key_ScrollLock
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XK_F1,                          // Key_F1
+    XK_F2,                          // Key_F2
+    XK_F3,                          // Key_F3
+    XK_F4,                          // Key_F4
+    XK_F5,                          // Key_F5
+    XK_F6,                          // Key_F6
+    XK_F7,                          // Key_F7
+    XK_F8,                          // Key_F8
+    XK_F9,                          // Key_F9
+    XK_F10,                         // Key_F10
+    XK_F11,                         // Key_F11
+    XK_F12,                         // Key_F12
+    XK_F13,                         // Key_F13
+    XK_F14,                         // Key_F14
+    XK_F15,                         // Key_F15
+    XK_F16,                         // Key_F16
+    XK_F17,                         // Key_F17
+    XK_F18,                         // Key_F18
+    XK_F19,                         // Key_F19
+    XK_F20,                         // Key_F20
+    XK_F21,                         // Key_F21
+    XK_F22,                         // Key_F22
+    XK_F23,                         // Key_F23
+    XK_F24,                         // Key_F24
+    XK_F25,                         // Key_F25
+    XK_F26,                         // Key_F26
+    XK_F27,                         // Key_F27
+    XK_F28,                         // Key_F28
+    XK_F29,                         // Key_F29
+    XK_F30,                         // Key_F30
+    XK_F31,                         // Key_F31
+    XK_F32,                         // Key_F32
+    XK_F33,                         // Key_F33
+    XK_F34,                         // Key_F34
+    XK_F35,                         // Key_F35
+    XK_Super_L,                     // Key_Super_L
+    XK_Super_R,                     // Key_Super_R
+    XK_Menu,                        // Key_Menu
+    XK_Hyper_L,                     // Key_Hyper_L
+    XK_Hyper_R,                     // Key_Hyper_R
+    XK_Help,                        // Key_Help
+    0,                              // Key_Direction_L
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // Key_Direction_R
+    XF86XK_Back,                    // Key_Back
+    XF86XK_Forward,                 // Key_Forward
+    XF86XK_Stop,                    // Key_Stop
+    XF86XK_Refresh,                 // Key_Refresh
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XF86XK_AudioLowerVolume,        // Key_VolumeDown
+    XF86XK_AudioMute,               // Key_VolumeMute
+    XF86XK_AudioRaiseVolume,        // Key_VolumeUp
+    0,                              // Key_BassBoost
+    0,                              // Key_BassUp
+    0,                              // Key_BassDown
+    0,                              // Key_TrebleUp
+    0,                              // Key_TrebleDown
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XF86XK_AudioPlay,               // Key_MediaPlay
+    XF86XK_AudioStop,               // Key_MediaStop
+    XF86XK_AudioPrev,               // Key_MediaPrevious
+    XF86XK_AudioNext,               // Key_MediaNext
+    XF86XK_AudioRecord,             // Key_MediaRecord
+    XF86XK_AudioPause,              // Key_MediaPause
+    0,                              // Key_MediaTogglePlayPause
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XF86XK_HomePage,                // Key_HomePage
+    XF86XK_Favorites,               // Key_Favorites
+    XF86XK_Search,                  // Key_Search
+    XF86XK_Standby,                 // Key_Standby
+    XF86XK_OpenURL,                 // Key_OpenUrl
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    0,                              // unassigned
+    XF86XK_Mail,                    // Key_LaunchMail
+    XF86XK_AudioMedia,              // Key_LaunchMedia
+    XF86XK_MyComputer,              // Key_Launch0
+    XF86XK_Calculator,              // Key_Launch1
+    XF86XK_Launch0,                 // Key_Launch2
+    XF86XK_Launch1,                 // Key_Launch3
+    XF86XK_Launch2,                 // Key_Launch4
+    XF86XK_Launch3,                 // Key_Launch5
+    XF86XK_Launch4,                 // Key_Launch6
+    XF86XK_Launch5,                 // Key_Launch7
+    XF86XK_Launch6,                 // Key_Launch8
+    XF86XK_Launch7,                 // Key_Launch9
+    XF86XK_Launch8,                 // Key_LaunchA
+    XF86XK_Launch9,                 // Key_LaunchB
+    XF86XK_LaunchA,                 // Key_LaunchC
+    XF86XK_LaunchB,                 // Key_LaunchD
+    XF86XK_LaunchC,                 // Key_LaunchE
+    XF86XK_LaunchD,                 // Key_LaunchF
+    XF86XK_MonBrightnessUp,         // Key_MonBrightnessUp
+    XF86XK_MonBrightnessDown,       // Key_MonBrightnessDown
+    XF86XK_KbdLightOnOff,           // Key_KeyboardLightOnOff
+    XF86XK_KbdBrightnessUp,         // Key_KeyboardBrightnessUp
+    XF86XK_KbdBrightnessDown,       // Key_KeyboardBrightnessDown
+    XF86XK_PowerOff,                // Key_PowerOff
+    XF86XK_WakeUp,                  // Key_WakeUp
+    XF86XK_Eject,                   // Key_Eject
+    XF86XK_ScreenSaver,             // Key_ScreenSaver
+    XF86XK_WWW,                     // Key_WWW
+    XF86XK_Memo,                    // Key_Memo
+    XF86XK_LightBulb,               // Key_LightBulb
+    XF86XK_Shop,                    // Key_Shop
+    XF86XK_History,                 // Key_History
+    XF86XK_AddFavorite,             // Key_AddFavorite
+    XF86XK_HotLinks,                // Key_HotLinks
+    XF86XK_BrightnessAdjust,        // Key_BrightnessAdjust
+    XF86XK_Finance,                 // Key_Finance
+    XF86XK_Community,               // Key_Community
+    XF86XK_AudioRewind,             // Key_AudioRewind
+    XF86XK_BackForward,             // Key_BackForward
+    XF86XK_ApplicationLeft,         // Key_ApplicationLeft
+    XF86XK_ApplicationRight,        // Key_ApplicationRight
+    XF86XK_Book,                    // Key_Book
+    XF86XK_CD,                      // Key_CD
+    XF86XK_Calculater,              // Key_Calculator
+    XF86XK_ToDoList,                // Key_ToDoList
+    XF86XK_ClearGrab,               // Key_ClearGrab
+    XF86XK_Close,                   // Key_Close
+    XF86XK_Copy,                    // Key_Copy
+    XF86XK_Cut,                     // Key_Cut
+    XF86XK_Display,                 // Key_Display
+    XF86XK_DOS,                     // Key_DOS
+    XF86XK_Documents,               // Key_Documents
+    XF86XK_Excel,                   // Key_Excel
+    XF86XK_Explorer,                // Key_Explorer
+    XF86XK_Game,                    // Key_Game
+    XF86XK_Go,                      // Key_Go
+    XF86XK_iTouch,                  // Key_iTouch
+    XF86XK_LogOff,                  // Key_LogOff
+    XF86XK_Market,                  // Key_Market
+    XF86XK_Meeting,                 // Key_Meeting
+    XF86XK_MenuKB,                  // Key_MenuKB
+    XF86XK_MenuPB,                  // Key_MenuPB
+    XF86XK_MySites,                 // Key_MySites
+    XF86XK_News,                    // Key_News
+    XF86XK_OfficeHome,              // Key_OfficeHome
+    XF86XK_Option,                  // Key_Option
+    XF86XK_Paste,                   // Key_Paste
+    XF86XK_Phone,                   // Key_Phone
+    XF86XK_Calendar,                // Key_Calendar
+    XF86XK_Reply,                   // Key_Reply
+    XF86XK_Reload,                  // Key_Reload
+    XF86XK_RotateWindows,           // Key_RotateWindows
+    XF86XK_RotationPB,              // Key_RotationPB
+    XF86XK_RotationKB,              // Key_RotationKB
+    XF86XK_Save,                    // Key_Save
+    XF86XK_Send,                    // Key_Send
+    XF86XK_Spell,                   // Key_Spell
+    XF86XK_SplitScreen,             // Key_SplitScreen
+    XF86XK_Support,                 // Key_Support
+    XF86XK_TaskPane,                // Key_TaskPane
+    XF86XK_Terminal,                // Key_Terminal
+    XF86XK_Tools,                   // Key_Tools
+    XF86XK_Travel,                  // Key_Travel
+    XF86XK_Video,                   // Key_Video
+    XF86XK_Word,                    // Key_Word
+    XF86XK_Xfer,                    // Key_Xfer
+    XF86XK_ZoomIn,                  // Key_ZoomIn
+    XF86XK_ZoomOut,                 // Key_ZoomOut
+    XF86XK_Away,                    // Key_Away
+    XF86XK_Messenger,               // Key_Messenger
+    XF86XK_WebCam,                  // Key_WebCam
+    XF86XK_MailForward,             // Key_MailForward
+    XF86XK_Pictures,                // Key_Pictures
+    XF86XK_Music,                   // Key_Music
+    XF86XK_Battery,                 // Key_Battery
+    XF86XK_Bluetooth,               // Key_Bluetooth
+    XF86XK_WLAN,                    // Key_WLAN
+    XF86XK_UWB,                     // Key_UWB
+    XF86XK_AudioForward,            // Key_AudioForward
+    XF86XK_AudioRepeat,             // Key_AudioRepeat
+    XF86XK_AudioRandomPlay,         // Key_AudioRandomPlay
+    XF86XK_Subtitle,                // Key_Subtitle
+    XF86XK_AudioCycleTrack,         // Key_AudioCycleTrack
+    XF86XK_Time,                    // Key_Time
+    XF86XK_Hibernate,               // Key_Hibernate
+    XF86XK_View,                    // Key_View
+    XF86XK_TopMenu,                 // Key_TopMenu
+    XF86XK_PowerDown,               // Key_PowerDown
+    XF86XK_Suspend,                 // Key_Suspend
+    XF86XK_ContrastAdjust,          // Key_ContrastAdjust
+    XF86XK_LaunchE,                 // Key_LaunchG
+    XF86XK_LaunchF,                 // Key_LaunchH
+    0x1008ffa9,                     // Key_TouchpadToggle (XF86XK_TouchpadToggle)
+    0x1008ffb0,                     // Key_TouchpadOn (XF86XK_TouchpadOn)
+    0x1008ffb1,                     // Key_TouchpadOff (XF86XK_TouchpadOff)
+    0x1008ffb2,                     // Key_MicMute (XF86XK_AudioMicMute)
+    0x1008ffa3,                     // Key_Red (XF86XK_Red)
+    0x1008ffa4,                     // Key_Green (XF86XK_Green)
+    0x1008ffa5,                     // Key_Yellow (XF86XK_Yellow)
+    0x1008ffa6,                     // Key_Blue (XF86XK_Blue)
+    0,                              // Key_ChannelUp
+    0,                              // Key_ChannelDown
+    0,                              // Key_Guide
+    0,                              // Key_Info
+    0,                              // Key_Settings
+    0,                              // Key_MicVolumeUp
+    0,                              // Key_MicVolumeDown
+    0,                              // unassigned
+    XF86XK_New,                     // Key_New
+    XF86XK_Open,                    // Key_Open
+    XK_Find,                        // Key_Find
+    XK_Undo,                        // Key_Undo
+    XK_Redo                         // Key_Redo
+};
+
+// Indexed by Qt::Key - Qt::Key_Space, for keys with Qt::KeypadModifier.
+static const quint32 qxt_x_keypad_keysyms[] =
+{
+    XK_KP_Space, 0, 0, 0, 0, 0, 0, 0,                                                       // Space ! " # $ % & '
+    0, 0, XK_KP_Multiply, XK_KP_Add, XK_KP_Separator, XK_KP_Subtract, XK_KP_Decimal, XK_KP_Divide, // ( ) * + , - . /
+    XK_KP_0, XK_KP_1, XK_KP_2, XK_KP_3, XK_KP_4, XK_KP_5, XK_KP_6, XK_KP_7,                 // 0 - 7
+    XK_KP_8, XK_KP_9, 0, 0, 0, XK_KP_Equal                                                  // 8 9 : ; < =
+};
+
+// Indexed by Qt::Key - Qt::Key_Escape, for keys with Qt::KeypadModifier.
+static const quint32 qxt_x_keypad_special_keysyms[] =
+{
+    0, XK_KP_Tab, 0, 0, 0, XK_KP_Enter, XK_KP_Insert, XK_KP_Delete,                         // Escape Tab Backtab Backspace Return Enter Insert Delete
+    0, 0, 0, XK_KP_Begin, 0, 0, 0, 0,                                                       // Pause Print SysReq Clear
+    XK_KP_Home, XK_KP_End, XK_KP_Left, XK_KP_Up, XK_KP_Right, XK_KP_Down, XK_KP_Prior, XK_KP_Next // Home End Left Up Right Down PageUp PageDown
+};
+
+// Indexed by MAQxtGlobalShortcutPrivate::modifierIndex(); Mod1 is Alt and Mod4 is Meta.
+static const quint32 qxt_x_modifiers[] =
+    MAQXT_MODIFIER_TABLE(XCB_MOD_MASK_SHIFT, XCB_MOD_MASK_CONTROL, XCB_MOD_MASK_1, XCB_MOD_MASK_4);
+
+#define QXT_X_TABLE_SIZE(table) quint32(sizeof(table) / sizeof(table[0]))
+
+// The application's Xlib display. Qt 6 needs 6.2 or later for the X11
+// native interface, and has none on other platform plugins such as
+// Wayland's; nothing can be registered then.
+static Display* qxt_x_display()
+{
+#if QT_VERSION >= 0x060000
+    QNativeInterface::QX11Application* x11 = qGuiApp ? qGuiApp->nativeInterface<QNativeInterface::QX11Application>() : 0;
+    return x11 ? x11->display() : 0;
+#else
+    return QX11Info::display();
+#endif
+}
+
+static xcb_window_t qxt_x_root_window()
+{
+    Display* display = qxt_x_display();
+    return display ? xcb_window_t(DefaultRootWindow(display)) : xcb_window_t(XCB_WINDOW_NONE);
+}
+
+static quint32 qxt_x_keysym(Qt::Key key, Qt::KeyboardModifiers modifiers)
+{
+    const quint32 code = key;
+    if (modifiers & Qt::KeypadModifier)
+    {
+        if (code - Qt::Key_Space < QXT_X_TABLE_SIZE(qxt_x_keypad_keysyms) && qxt_x_keypad_keysyms[code - Qt::Key_Space])
+            return qxt_x_keypad_keysyms[code - Qt::Key_Space];
+        if (code - Qt::Key_Escape < QXT_X_TABLE_SIZE(qxt_x_keypad_special_keysyms) && qxt_x_keypad_special_keysyms[code - Qt::Key_Escape])
+            return qxt_x_keypad_special_keysyms[code - Qt::Key_Escape];
+    }
+    // Latin-1 keysyms have the same values as the Latin-1 keys.
+    if (code <= 0xff)
+        return code;
+    if (code - Qt::Key_Escape < QXT_X_TABLE_SIZE(qxt_x_special_keysyms))
+        return qxt_x_special_keysyms[code - Qt::Key_Escape];
+    // Qt derived the values of these key groups from their keysyms.
+    if (code == Qt::Key_AltGr)
+        return XK_ISO_Level3_Shift;
+    if ((code & 0xffffff00) == 0x01001100) // Multi_key, Kanji ... Hangul_Special, Mode_switch
+        return 0xff00 | (code & 0xff);
+    if ((code & 0xffffff00) == 0x01001200) // dead keys
+        return 0xfe00 | (code & 0xff);
+    if (code < 0x01000000)
+        return 0x01000000 | code; // Unicode keysym
+    switch (code)
+    {
+    case Qt::Key_Select:
+        return XK_Select;
+    case Qt::Key_Cancel:
+        return XK_Cancel;
+    case Qt::Key_Execute:
+        return XK_Execute;
+    case Qt::Key_Sleep:
+        return XF86XK_Sleep;
+    default:
+        return 0;
+    }
+}
+
+// Passive shortcuts select XInput 2 raw key events on the root window of
+// the grab connection instead of grabbing their keys, and so does key state
+// tracking. Raw events are sent whoever has the focus or a grab, but carry
+// no modifier state; that is followed from the raw events of the modifier
+// keys themselves. The selection is guarded by
+// MAQxtGlobalShortcutPrivate::mutex. What every raw event reads or updates
+// is kept in atomics instead, so that a stream of them costs no locking.
+static int qxt_x_xi_opcode = -1;
+static Display* qxt_x_raw_display = 0;        // raw events are selected there
+static QAtomicInt qxt_x_passive_count;        // passive combinations observed
+static QAtomicInt qxt_x_track_keys;           // keyStateTracked, for the raw events
+static QAtomicInt qxt_x_modifier_bits[256 / 4]; // core modifier mask of each keycode, a byte each
+static QAtomicInt qxt_x_modifier_down[256 / 32]; // modifier keys held, a bit each
+
+static inline quint32 qxt_x_modifier_mask(quint32 keycode)
+{
+    return (quint32(qxt_atomic_load_relaxed(qxt_x_modifier_bits[keycode >> 2])) >> (8 * (keycode & 3))) & 0xff;
+}
+
+static quint32 qxt_x_raw_mods()
+{
+    quint32 mods = 0;
+    for (int i = 0; i < 256 / 32; ++i)
+    {
+        quint32 down = quint32(qxt_atomic_load_relaxed(qxt_x_modifier_down[i]));
+        for (quint32 code = 32 * i; down; ++code, down >>= 1)
+        {
+            if (down & 1)
+                mods |= qxt_x_modifier_mask(code);
+        }
+    }
+    return mods & (ShiftMask | ControlMask | Mod1Mask | Mod4Mask);
+}
+
+// Raw events may come in on the main thread and the listener thread at
+// once, during a change of delivery mode.
+static void qxt_x_set_modifier_down(quint32 keycode, bool down)
+{
+    QAtomicInt& word = qxt_x_modifier_down[keycode >> 5];
+    const int bit = int(1u << (keycode & 31));
+    for (;;)
+    {
+        const int value = qxt_atomic_load_relaxed(word);
+        const int next = down ? value | bit : value & ~bit;
+        if (next == value || word.testAndSetOrdered(value, next))
+            return;
+    }
+}
+
+static bool qxt_x_select_raw_keys(Display* display, bool select)
+{
+    unsigned char bits[XIMaskLen(XI_LASTEVENT)];
+    memset(bits, 0, sizeof(bits));
+    if (select)
+    {
+        // Every client announces the version it speaks; raw events during
+        // grabs need 2.1.
+        int event, error, major = 2, minor = 2;
+        if (!XQueryExtension(display, "XInputExtension", &qxt_x_xi_opcode, &event, &error)
+            || XIQueryVersion(display, &major, &minor) != Success || (major == 2 && minor < 1))
+        {
+            qWarning("MAQxtGlobalShortcut: passive shortcuts need XInput 2.1");
+            return false;
+        }
+        XISetMask(bits, XI_RawKeyPress);
+        XISetMask(bits, XI_RawKeyRelease);
+    }
+    XIEventMask mask;
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof(bits);
+    mask.mask = bits;
+    XISelectEvents(display, DefaultRootWindow(display), &mask, 1);
+    XFlush(display);
+    return true;
+}
+
+// Reads the keys already held, when observation starts and whenever
+// events may have been missed. 'track' fills in the tracked key state too.
+static void qxt_x_sync_key_state(Display* display, bool track)
+{
+    char keys[32];
+    XQueryKeymap(display, keys);
+    for (int i = 0; i < 256 / 32; ++i)
+    {
+        quint32 down = 0;
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            const int code = 32 * i + bit;
+            if (qxt_x_modifier_mask(code) && (keys[code >> 3] & (1 << (code & 7))))
+                down |= 1u << bit;
+        }
+        qxt_atomic_store_release(qxt_x_modifier_down[i], int(down));
+    }
+    if (track)
+        MAQxtGlobalShortcutPrivate::keyState.reset(reinterpret_cast<const quint8*>(keys), qxt_x_raw_mods());
+}
+
+static void qxt_x_load_modifier_map(Display* display)
+{
+    quint8 bits[256];
+    memset(bits, 0, sizeof(bits));
+    XModifierKeymap* map = XGetModifierMapping(display);
+    if (map)
+    {
+        for (int i = 0; i < 8 * map->max_keypermod; ++i)
+        {
+            if (map->modifiermap[i])
+                bits[map->modifiermap[i]] |= 1 << (i / map->max_keypermod);
+        }
+        XFreeModifiermap(map);
+    }
+    for (int i = 0; i < 256 / 4; ++i)
+        qxt_atomic_store_release(qxt_x_modifier_bits[i], int(bits[4 * i] | bits[4 * i + 1] << 8 | bits[4 * i + 2] << 16 | quint32(bits[4 * i + 3]) << 24));
+    qxt_x_sync_key_state(display, MAQxtGlobalShortcutPrivate::keyStateTracked);
+}
+
+static void qxt_x_modifier_mapping_changed()
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (qxt_x_raw_display)
+        qxt_x_load_modifier_map(qxt_x_raw_display);
+}
+
+// Focus changes of our windows, including those caused by keyboard grabs of
+// other clients, are taken as a hint that events may have been missed.
+static void qxt_x_focus_changed()
+{
+    MAQxtGlobalShortcutLocker locker;
+    if (MAQxtGlobalShortcutPrivate::keyStateTracked && qxt_x_raw_display)
+        qxt_x_sync_key_state(qxt_x_raw_display, true);
+}
+
+// Follows the modifier and key state through a raw key event. Returns
+// whether passive shortcuts are observed, and the native modifiers to
+// dispatch the event with in 'mods'. Runs for every raw event and takes
+// no lock.
+static bool qxt_x_raw_key_mods(int type, quint32 keycode, quint32& mods)
+{
+    // Like core events, a modifier's own event has the state from before it.
+    const quint32 before = qxt_x_raw_mods();
+    mods = before | MAQxtGlobalShortcutPrivate::PassiveFlag;
+    const bool modifier = keycode < 256 && qxt_x_modifier_mask(keycode);
+    if (modifier)
+        qxt_x_set_modifier_down(keycode, type == XI_RawKeyPress);
+    if (qxt_atomic_load_relaxed(qxt_x_track_keys))
+    {
+        MAQxtGlobalShortcutPrivate::keyState.setPressed(keycode, type == XI_RawKeyPress);
+        MAQxtGlobalShortcutPrivate::keyState.setModifiers(modifier ? qxt_x_raw_mods() : before);
+    }
+    return qxt_atomic_load_relaxed(qxt_x_passive_count) != 0;
+}
+
+// Decodes a raw key event read through xcb and tells whether passive
+// shortcuts want it. The fields used lie in the first 32 bytes, where xcb
+// keeps the wire layout.
+static bool qxt_x_raw_key_event(const xcb_generic_event_t* event, quint32& keycode, quint32& nativeMods,
+                                quint32& time, bool& release)
+{
+    const xXIRawEvent* raw = (const xXIRawEvent*) event;
+    if (raw->extension != qxt_x_xi_opcode || (raw->evtype != XI_RawKeyPress && raw->evtype != XI_RawKeyRelease))
+        return false;
+    keycode = raw->detail;
+    time = raw->time;
+    release = raw->evtype == XI_RawKeyRelease;
+    return qxt_x_raw_key_mods(raw->evtype, raw->detail, nativeMods);
+}
+
+// Reads key events from a private X connection, so that activations do not
+// wait for the main thread's event loop. Key grabs are delivered to the
+// connection that made them; while a listener exists all grabs are made on
+// its connection. Keyboard mapping changes are still seen through Qt's own
+// connection.
+class MAQxtGlobalShortcutListener : public QThread
+{
+public:
+    explicit MAQxtGlobalShortcutListener(bool queued);
+    ~MAQxtGlobalShortcutListener();
+
+    bool open();
+    void stop();
+    void setQueued(bool queued);
+    void deliverQueued();
+
+    Display* display;
+    xcb_connection_t* connection;
+
+protected:
+    void run();
+    bool event(QEvent* event);
+
+private:
+    void dispatch(quint32 nativeKey, quint32 nativeMods, quint32 time, bool release);
+
+    struct Activation
+    {
+        quint32 nativeKey;
+        quint32 nativeMods;
+        quint32 time;
+        bool release;
+    };
+
+    xcb_window_t wakeWindow;
+    QAtomicInt queued;
+    QAtomicInt pending; // a delivery event has been posted
+    MAQxtSpscRing<Activation, 256> activations;
+};
+
+static const QEvent::Type qxt_x_delivery_event = QEvent::Type(QEvent::registerEventType());
+static MAQxtGlobalShortcutListener* qxt_x_listener = 0;
+
+MAQxtGlobalShortcutListener::MAQxtGlobalShortcutListener(bool queued)
+    : display(0), connection(0), wakeWindow(0), queued(queued), pending(0)
+{
+}
+
+MAQxtGlobalShortcutListener::~MAQxtGlobalShortcutListener()
+{
+    if (display)
+    {
+        if (wakeWindow)
+            xcb_destroy_window(connection, wakeWindow);
+        XCloseDisplay(display);
+    }
+}
+
+bool MAQxtGlobalShortcutListener::open()
+{
+    // Opened through Xlib for XKB's per-client controls; events are read
+    // with xcb only.
+    Display* application = qxt_x_display();
+    if (!application)
+        return false;
+    display = XOpenDisplay(DisplayString(application));
+    if (!display)
+        return false;
+    connection = XGetXCBConnection(display);
+    XSetEventQueueOwner(display, XCBOwnsEventQueue);
+    // Auto-repeat then comes as presses without releases in between, which
+    // tells it apart from the key being pressed again.
+    Bool supported;
+    XkbSetDetectableAutoRepeat(display, True, &supported);
+    // An unmapped window of our own to send the stop request to.
+    wakeWindow = xcb_generate_id(connection);
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, wakeWindow, qxt_x_root_window(),
+                      0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, 0);
+    xcb_flush(connection);
+    return true;
+}
+
+void MAQxtGlobalShortcutListener::stop()
+{
+    // With an empty event mask the event goes to the window's creator.
+    xcb_client_message_event_t message;
+    memset(&message, 0, sizeof(message));
+    message.response_type = XCB_CLIENT_MESSAGE;
+    message.format = 32;
+    message.window = wakeWindow;
+    xcb_send_event(connection, 0, wakeWindow, XCB_EVENT_MASK_NO_EVENT, (const char*) &message);
+    xcb_flush(connection);
+    wait();
+}
+
+void MAQxtGlobalShortcutListener::setQueued(bool queued)
+{
+    qxt_atomic_store_release(this->queued, queued);
+}
+
+void MAQxtGlobalShortcutListener::run()
+{
+    while (xcb_generic_event_t* event = xcb_wait_for_event(connection))
+    {
+        const quint8 type = event->response_type & ~0x80;
+        if (type == XCB_CLIENT_MESSAGE && ((xcb_client_message_event_t*) event)->window == wakeWindow)
+        {
+            free(event);
+            break;
+        }
+        quint32 keycode, nativeMods, time;
+        bool release;
+        if (type == XCB_KEY_PRESS || type == XCB_KEY_RELEASE)
+        {
+            // xcb_key_release_event_t is the same structure.
+            const xcb_key_press_event_t* key = (const xcb_key_press_event_t*) event;
+            dispatch(key->detail, key->state & (XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1 | XCB_MOD_MASK_4),
+                     key->time, type == XCB_KEY_RELEASE);
+        }
+        else if (type == XCB_GE_GENERIC && qxt_x_raw_key_event(event, keycode, nativeMods, time, release))
+        {
+            dispatch(keycode, nativeMods, time, release);
+        }
+        free(event);
+    }
+}
+
+void MAQxtGlobalShortcutListener::dispatch(quint32 nativeKey, quint32 nativeMods, quint32 time, bool release)
+{
+    if (!qxt_atomic_load_relaxed(queued))
+    {
+        if (release)
+            MAQxtGlobalShortcutPrivate::releaseShortcut(nativeKey, nativeMods, time);
+        else
+            MAQxtGlobalShortcutPrivate::activateShortcut(nativeKey, nativeMods, time);
+        return;
+    }
+    const Activation activation = { nativeKey, nativeMods, time, release };
+    // A full ring means the main thread has not run for 256 events;
+    // dropping the newest ones is the least surprising.
+    if (activations.push(activation) && pending.testAndSetOrdered(0, 1))
+        QCoreApplication::postEvent(this, new QEvent(qxt_x_delivery_event));
+}
+
+bool MAQxtGlobalShortcutListener::event(QEvent* event)
+{
+    if (event->type() != qxt_x_delivery_event)
+        return QThread::event(event);
+    deliverQueued();
+    return true;
+}
+
+void MAQxtGlobalShortcutListener::deliverQueued()
+{
+    // Clear the flag first: anything pushed after this point either gets
+    // drained below or posts a new event.
+    qxt_atomic_store_release(pending, 0);
+    Activation activation;
+    while (activations.pop(activation))
+    {
+        if (activation.release)
+            MAQxtGlobalShortcutPrivate::releaseShortcut(activation.nativeKey, activation.nativeMods, activation.time);
+        else
+            MAQxtGlobalShortcutPrivate::activateShortcut(activation.nativeKey, activation.nativeMods, activation.time);
+    }
+}
+
+static void qxt_x_stop_listener()
+{
+    if (qxt_x_listener)
+    {
+        qxt_x_listener->stop();
+        delete qxt_x_listener;
+        qxt_x_listener = 0;
+    }
+}
+
+// Local milliseconds minus X server time, guarded by the mutex. The server
+// does not tell its time directly; a property change on a scratch window
+// echoes it back.
+static bool qxt_x_server_time_known = false;
+static quint32 qxt_x_server_time_offset = 0;
+
+static quint32 qxt_x_local_time()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return quint32(clock.elapsed());
+}
+
+// Costs a connection and a blocking round-trip; never made on the dispatch
+// path.
+static bool qxt_x_measure_server_time(quint32& offset)
+{
+    bool res = false;
+    xcb_connection_t* connection = xcb_connect(DisplayString(qxt_x_display()), 0);
+    if (!xcb_connection_has_error(connection))
+    {
+        const xcb_window_t window = xcb_generate_id(connection);
+        const quint32 eventMask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+        xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, qxt_x_root_window(),
+                          0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, &eventMask);
+        xcb_change_property(connection, XCB_PROP_MODE_APPEND, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, 0, "");
+        xcb_flush(connection);
+        while (xcb_generic_event_t* event = xcb_wait_for_event(connection))
+        {
+            res = (event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY;
+            if (res)
+                offset = qxt_x_local_time() - ((xcb_property_notify_event_t*) event)->time;
+            free(event);
+            if (res)
+                break;
+        }
+    }
+    xcb_disconnect(connection);
+    return res;
+}
+
+void MAQxtGlobalShortcutPrivate::prepareNativeEventAge()
+{
+    {
+        MAQxtGlobalShortcutLocker locker;
+        if (qxt_x_server_time_known)
+            return;
+    }
+    quint32 offset;
+    if (!qxt_x_display() || !qxt_x_measure_server_time(offset))
+        return;
+    MAQxtGlobalShortcutLocker locker;
+    qxt_x_server_time_known = true;
+    qxt_x_server_time_offset = offset;
+}
+
+qint64 MAQxtGlobalShortcutPrivate::nativeEventAge(quint32 eventTime)
+{
+    if (!qxt_x_server_time_known)
+        return -1;
+    // Server time wraps every 49.7 days; the unsigned difference does not care.
+    qint32 age = qint32(qxt_x_local_time() - qxt_x_server_time_offset - eventTime);
+    if (age < 0)
+    {
+        // The measurement included its own round-trip; tighten it.
+        qxt_x_server_time_offset += age;
+        age = 0;
+    }
+    return age;
+}
+
+static xcb_connection_t* qxt_x_connection()
+{
+    if (qxt_x_listener)
+        return qxt_x_listener->connection;
+    Display* display = qxt_x_display();
+    return display ? XGetXCBConnection(display) : 0;
+}
+
+static Display* qxt_x_grab_display()
+{
+    if (qxt_x_listener)
+        return qxt_x_listener->display;
+    return qxt_x_display();
+}
+
+// Keeps raw key events selected on the current grab connection, or on none
+// unless 'select'. Returns false if they are wanted but cannot be had.
+static bool qxt_x_update_raw_selection(bool select)
+{
+    Display* display = qxt_x_grab_display();
+    if (qxt_x_raw_display && (!select || qxt_x_raw_display != display))
+    {
+        qxt_x_select_raw_keys(qxt_x_raw_display, false);
+        qxt_x_raw_display = 0;
+    }
+    if (select && display && !qxt_x_raw_display && qxt_x_select_raw_keys(display, true))
+    {
+        qxt_x_raw_display = display;
+        qxt_x_load_modifier_map(display);
+    }
+    return !select || qxt_x_raw_display;
+}
+
+// Selects raw key events while any passive combination is observed or the
+// key state is tracked, and settles the passive entries of a native update;
+// they never fail to be released, and are taken as long as the selection
+// can be made.
+static void qxt_x_update_passive(const QVector<MAQxtGlobalShortcutPrivate::NativeShortcut>& ungrabs,
+                                 QVector<MAQxtGlobalShortcutPrivate::NativeShortcut>& grabs)
+{
+    int count = qxt_atomic_load_relaxed(qxt_x_passive_count);
+    int added = 0;
+    foreach (const MAQxtGlobalShortcutPrivate::NativeShortcut& ungrab, ungrabs)
+    {
+        if ((ungrab.mods & MAQxtGlobalShortcutPrivate::PassiveFlag) && ungrab.key)
+            --count;
+    }
+    foreach (const MAQxtGlobalShortcutPrivate::NativeShortcut& grab, grabs)
+    {
+        if ((grab.mods & MAQxtGlobalShortcutPrivate::PassiveFlag) && grab.key)
+            ++added;
+    }
+    const bool ok = !added || qxt_x_update_raw_selection(true);
+    for (int i = 0; i < grabs.size(); ++i)
+    {
+        if (grabs.at(i).mods & MAQxtGlobalShortcutPrivate::PassiveFlag)
+            grabs[i].ok = ok && grabs.at(i).key;
+    }
+    if (ok)
+        count += added;
+    qxt_atomic_store_release(qxt_x_passive_count, count);
+    // Also follows the grab connection when the delivery mode changes.
+    qxt_x_update_raw_selection(count || MAQxtGlobalShortcutPrivate::keyStateTracked);
+}
+
+// Collects the results of a batch of checked requests. Only the first
+// xcb_request_check() waits for the server; by then every request issued
+// before it has been answered, so the remaining checks are local.
+static void qxt_x_check_cookies(xcb_connection_t* connection, const QVector<xcb_void_cookie_t>& cookies,
+                                QVector<MAQxtGlobalShortcutPrivate::NativeShortcut>& grabs, const char* what)
+{
+    int next = 0;
+    for (int i = 0; i < grabs.size(); ++i)
+    {
+        // Passive entries have no requests, see qxt_x_update_passive(),
+        // nor have those on keycode 0, see updateShortcuts().
+        if (grabs.at(i).mods & MAQxtGlobalShortcutPrivate::PassiveFlag)
+            continue;
+        if (!grabs.at(i).key)
+        {
+            grabs[i].ok = false;
+            continue;
+        }
+        grabs[i].ok = true;
+        for (int j = 0; j < qxt_x_lock_variant_count; ++j)
+        {
+            xcb_generic_error_t* error = xcb_request_check(connection, cookies.at(next++));
+            if (error)
+            {
+                if (grabs.at(i).ok && !MAQxtGlobalShortcutPrivate::probing)
+                    qWarning("MAQxtGlobalShortcut: %s of keycode %u, modifiers 0x%x failed with X error %d",
+                             what, grabs.at(i).key, grabs.at(i).mods, int(error->error_code));
+                grabs[i].ok = false;
+                free(error);
+            }
+        }
+    }
+}
+
+#if QT_VERSION >= 0x050000
+// Qt 5 reads the event stream through xcb and initializes XKB on it, so the
+// server reports keymap changes as XKB events instead of MappingNotify and
+// nobody keeps the keysym tables of the Xlib display up to date.
+static int qxt_x_xkb_event_type()
+{
+    static int eventType = -1;
+    if (eventType < 0)
+    {
+        int opcode, eventBase, error, major = XkbMajorVersion, minor = XkbMinorVersion;
+        // An impossible response type when the extension is missing.
+        eventType = XkbQueryExtension(qxt_x_display(), &opcode, &eventBase, &error, &major, &minor) ? eventBase : 0x100;
+    }
+    return eventType;
+}
+
+static void qxt_x_refresh_keyboard_mapping(int request, int firstKeycode, int count)
+{
+    XMappingEvent mapping;
+    memset(&mapping, 0, sizeof(mapping));
+    mapping.type = MappingNotify;
+    mapping.display = qxt_x_display();
+    mapping.request = request;
+    mapping.first_keycode = firstKeycode;
+    mapping.count = count;
+    XRefreshKeyboardMapping(&mapping);
+}
+
+bool MAQxtGlobalShortcutPrivate::eventFilter(void* message)
+{
+    // Every event of the application passes here; only the response type
+    // is looked at unless it is one of the few we care about.
+    const xcb_generic_event_t* event = static_cast<const xcb_generic_event_t*>(message);
+    const int type = event->response_type & ~0x80;
+    if (type == XCB_KEY_PRESS)
+    {
+        const xcb_key_press_event_t* key = (const xcb_key_press_event_t*) event;
+        activateShortcut(key->detail,
+            // XCB_MOD_MASK_1 == Alt, XCB_MOD_MASK_4 == Meta
+            key->state & (XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1 | XCB_MOD_MASK_4), key->time);
+    }
+    else if (type == XCB_KEY_RELEASE)
+    {
+        // Qt turns on detectable auto-repeat, so this is a real release.
+        const xcb_key_release_event_t* key = (const xcb_key_release_event_t*) event;
+        releaseShortcut(key->detail, 0, key->time);
+    }
+    else if (type == XCB_GE_GENERIC)
+    {
+        quint32 keycode, nativeMods, time;
+        bool release;
+        if (qxt_x_raw_key_event(event, keycode, nativeMods, time, release))
+        {
+            if (release)
+                releaseShortcut(keycode, nativeMods, time);
+            else
+                activateShortcut(keycode, nativeMods, time);
+        }
+    }
+    else if (type == XCB_FOCUS_IN || type == XCB_FOCUS_OUT)
+    {
+        qxt_x_focus_changed();
+    }
+    else if (type == XCB_MAPPING_NOTIFY)
+    {
+        const xcb_mapping_notify_event_t* mapping = (const xcb_mapping_notify_event_t*) event;
+        if (mapping->request != XCB_MAPPING_POINTER)
+        {
+            qxt_x_refresh_keyboard_mapping(mapping->request, mapping->first_keycode, mapping->count);
+            qxt_x_modifier_mapping_changed();
+            keyboardLayoutChanged();
+        }
+    }
+    else if (type == qxt_x_xkb_event_type())
+    {
+        // The second byte of every XKB event is its XKB type.
+        const quint8 xkbType = ((const quint8*) event)[1];
+        if (xkbType == XkbNewKeyboardNotify || xkbType == XkbMapNotify)
+        {
+            int minKeycode, maxKeycode;
+            XDisplayKeycodes(qxt_x_display(), &minKeycode, &maxKeycode);
+            qxt_x_refresh_keyboard_mapping(MappingKeyboard, minKeycode, maxKeycode - minKeycode + 1);
+            qxt_x_modifier_mapping_changed();
+            keyboardLayoutChanged();
+        }
+    }
+    return false;
+}
+#else
+bool MAQxtGlobalShortcutPrivate::eventFilter(void* message)
+{
+    XEvent* event = static_cast<XEvent*>(message);
+    if (event->type == KeyPress)
+    {
+        XKeyEvent* key = (XKeyEvent*) event;
+        activateShortcut(key->keycode, 
+            // Mod1Mask == Alt, Mod4Mask == Meta
+            key->state & (ShiftMask | ControlMask | Mod1Mask | Mod4Mask), key->time);
+    }
+    else if (event->type == KeyRelease)
+    {
+        // Without detectable auto-repeat each repeat is a release and a
+        // press with the same time; only the press is passed on.
+        XKeyEvent* key = (XKeyEvent*) event;
+        if (XEventsQueued(key->display, QueuedAfterReading))
+        {
+            XEvent next;
+            XPeekEvent(key->display, &next);
+            if (next.type == KeyPress && next.xkey.keycode == key->keycode && next.xkey.time == key->time)
+                return false;
+        }
+        releaseShortcut(key->keycode, 0, key->time);
+    }
+    else if (event->type == GenericEvent && event->xcookie.extension == qxt_x_xi_opcode)
+    {
+        XGenericEventCookie* cookie = &event->xcookie;
+        if (XGetEventData(cookie->display, cookie))
+        {
+            if (cookie->evtype == XI_RawKeyPress || cookie->evtype == XI_RawKeyRelease)
+            {
+                const XIRawEvent* raw = static_cast<const XIRawEvent*>(cookie->data);
+                quint32 nativeMods;
+                if (qxt_x_raw_key_mods(raw->evtype, raw->detail, nativeMods))
+                {
+                    if (raw->evtype == XI_RawKeyPress)
+                        activateShortcut(raw->detail, nativeMods, raw->time);
+                    else
+                        releaseShortcut(raw->detail, nativeMods, raw->time);
+                }
+            }
+            XFreeEventData(cookie->display, cookie);
+        }
+    }
+    else if (event->type == FocusIn || event->type == FocusOut)
+    {
+        qxt_x_focus_changed();
+    }
+    else if (event->type == MappingNotify && event->xmapping.request != MappingPointer)
+    {
+        // Sent to every client on keymap changes, XKB ones included.
+        XRefreshKeyboardMapping(&event->xmapping);
+        qxt_x_modifier_mapping_changed();
+        keyboardLayoutChanged();
+    }
+    return false;
+}
+#endif
+
+bool MAQxtGlobalShortcutPrivate::nativeReleaseEvents()
+{
+    // The grabbing client gets the release of a grabbed key.
+    return true;
+}
+
+quint32 MAQxtGlobalShortcutPrivate::nativeModifiers(Qt::KeyboardModifiers modifiers)
+{
+    // Qt::GroupSwitchModifier has no mask to grab with: XKB keeps the
+    // group apart from the modifiers. nativeKeycode() refuses it.
+    return qxt_x_modifiers[modifierIndex(modifiers)];
+}
+
+quint32 MAQxtGlobalShortcutPrivate::nativeKeycode(Qt::Key key, Qt::KeyboardModifiers modifiers)
+{
+    // splitChord() leaves Qt::GroupSwitchModifier in the key.
+    if ((quint32(key) | quint32(modifiers)) & Qt::GroupSwitchModifier)
+        return 0;
+    const KeySym keysym = qxt_x_keysym(key, modifiers);
+    Display* display = qxt_x_display();
+    return keysym && display ? XKeysymToKeycode(display, keysym) : 0;
+}
+
+quint64 MAQxtGlobalShortcutPrivate::nativeLayoutFingerprint()
+{
+    // The keysyms of every keycode, which XKeysymToKeycode() searches.
+    Display* display = qxt_x_display();
+    if (!display)
+        return 0;
+    int minKeycode, maxKeycode, perKeycode;
+    XDisplayKeycodes(display, &minKeycode, &maxKeycode);
+    KeySym* keysyms = XGetKeyboardMapping(display, KeyCode(minKeycode), maxKeycode - minKeycode + 1, &perKeycode);
+    if (!keysyms)
+        return 0;
+    const quint32 shape[] = { quint32(minKeycode), quint32(maxKeycode), quint32(perKeycode) };
+    quint64 hash = MAQxtKeycodeCache::fingerprint(MAQxtKeycodeCache::FingerprintBasis, "x11", 3);
+    hash = MAQxtKeycodeCache::fingerprint(hash, shape, sizeof(shape));
+    for (int i = 0; i < (maxKeycode - minKeycode + 1) * perKeycode; ++i)
+    {
+        // Keysyms fit 29 bits; the same for 32 and 64-bit processes.
+        const quint32 keysym = quint32(keysyms[i]);
+        hash = MAQxtKeycodeCache::fingerprint(hash, &keysym, sizeof(keysym));
+    }
+    XFree(keysyms);
+    return hash;
+}
+
+bool MAQxtGlobalShortcutPrivate::registerShortcut(quint32 nativeKey, quint32 nativeMods)
+{
+    QVector<NativeShortcut> ungrabs;
+    QVector<NativeShortcut> grabs(1);
+    grabs[0].key = nativeKey;
+    grabs[0].mods = nativeMods;
+    updateShortcuts(ungrabs, grabs);
+    return grabs.at(0).ok;
+}
+
+bool MAQxtGlobalShortcutPrivate::unregisterShortcut(quint32 nativeKey, quint32 nativeMods)
+{
+    QVector<NativeShortcut> ungrabs(1);
+    QVector<NativeShortcut> grabs;
+    ungrabs[0].key = nativeKey;
+    ungrabs[0].mods = nativeMods;
+    updateShortcuts(ungrabs, grabs);
+    return ungrabs.at(0).ok;
+}
+
+void MAQxtGlobalShortcutPrivate::updateShortcuts(QVector<NativeShortcut>& ungrabs, QVector<NativeShortcut>& grabs)
+{
+    xcb_connection_t* connection = qxt_x_connection();
+    const xcb_window_t window = qxt_x_root_window();
+    if (!connection || window == XCB_WINDOW_NONE)
+    {
+        // Not running on X11; nothing is grabbed or released.
+        for (int i = 0; i < ungrabs.size(); ++i)
+            ungrabs[i].ok = false;
+        for (int i = 0; i < grabs.size(); ++i)
+            grabs[i].ok = false;
+        return;
+    }
+    QVector<xcb_void_cookie_t> ungrabCookies;
+    QVector<xcb_void_cookie_t> grabCookies;
+    ungrabCookies.reserve(ungrabs.size() * qxt_x_lock_variant_count);
+    grabCookies.reserve(grabs.size() * qxt_x_lock_variant_count);
+    // Keycode 0 is XCB_GRAB_ANY, which would take every key with these
+    // modifiers; it only comes from keys missing in the layout and fails.
+    foreach (const NativeShortcut& ungrab, ungrabs)
+    {
+        if ((ungrab.mods & PassiveFlag) || !ungrab.key)
+            continue;
+        for (int i = 0; i < qxt_x_lock_variant_count; ++i)
+            ungrabCookies.append(xcb_ungrab_key_checked(connection, ungrab.key, window, ungrab.mods | qxt_x_lock_variants[i]));
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if ((grab.mods & PassiveFlag) || !grab.key)
+            continue;
+        for (int i = 0; i < qxt_x_lock_variant_count; ++i)
+            grabCookies.append(xcb_grab_key_checked(connection, 1, window, grab.mods | qxt_x_lock_variants[i], grab.key,
+                                                    XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC));
+    }
+    for (int i = 0; i < ungrabs.size(); ++i)
+    {
+        if (ungrabs.at(i).mods & PassiveFlag)
+            ungrabs[i].ok = ungrabs.at(i).key != 0;
+    }
+    qxt_x_update_passive(ungrabs, grabs);
+    qxt_x_check_cookies(connection, ungrabCookies, ungrabs, "ungrab");
+    qxt_x_check_cookies(connection, grabCookies, grabs, "grab");
+    foreach (const NativeShortcut& ungrab, ungrabs)
+    {
+        if (ungrab.ok)
+            registrations.remove(registrations.id(ungrab.key, ungrab.mods));
+    }
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok)
+            registrations.add(grab.key, grab.mods);
+    }
+
+    // Don't leave half-grabbed combinations behind.
+    foreach (const NativeShortcut& grab, grabs)
+    {
+        if (grab.ok || (grab.mods & PassiveFlag) || !grab.key)
+            continue;
+        for (int i = 0; i < qxt_x_lock_variant_count; ++i)
+            xcb_ungrab_key(connection, grab.key, window, grab.mods | qxt_x_lock_variants[i]);
+    }
+    xcb_flush(connection);
+}
+
+void MAQxtGlobalShortcutPrivate::deliverQueuedActivations()
+{
+    if (qxt_x_listener)
+        qxt_x_listener->deliverQueued();
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeDeliveryMode(MAQxtGlobalShortcut::DeliveryMode mode)
+{
+    const bool queued = mode == MAQxtGlobalShortcut::QueuedDelivery;
+    if ((mode != MAQxtGlobalShortcut::EventLoopDelivery) == (qxt_x_listener != 0))
+    {
+        if (qxt_x_listener)
+            qxt_x_listener->setQueued(queued);
+        return true;
+    }
+
+    MAQxtGlobalShortcutListener* previous = qxt_x_listener;
+    MAQxtGlobalShortcutListener* listener = 0;
+    if (previous)
+    {
+        // Join before taking the mutex, the listener may be waiting for it.
+        // Presses arriving until the grabs have moved are dropped.
+        previous->stop();
+    }
+    else
+    {
+        listener = new MAQxtGlobalShortcutListener(queued);
+        if (!listener->open())
+        {
+            qWarning() << "MAQxtGlobalShortcut failed to open a connection for the listener thread";
+            delete listener;
+            return false;
+        }
+        static bool cleanupInstalled = false;
+        if (!cleanupInstalled)
+        {
+            qAddPostRoutine(qxt_x_stop_listener);
+            cleanupInstalled = true;
+        }
+    }
+
+    {
+        MAQxtGlobalShortcutLocker locker;
+        cancelChord();
+        QVector<NativeShortcut> natives;
+        natives.reserve(shortcuts.size());
+        foreach (const MAQxtGlobalShortcutTable::Entry& entry, shortcuts.entries())
+        {
+            // Grabs released for disabled shortcuts are taken on the new
+            // connection when they are enabled again.
+            if (releasedGrabs.contains(entry.key & ~MAQxtGlobalShortcutTable::DisabledFlag))
+                continue;
+            NativeShortcut native;
+            native.key = entry.nativeKey();
+            native.mods = entry.nativeMods();
+            native.ok = false;
+            natives.append(native);
+        }
+        foreach (quint64 chord, chordTrie.chords(MAQxtGlobalShortcutTrie::Root))
+        {
+            NativeShortcut native;
+            native.key = quint32(chord >> 32);
+            native.mods = quint32(chord);
+            native.ok = false;
+            natives.append(native);
+        }
+        QVector<NativeShortcut> none;
+        MAQxtRegistrationTimer timer(statistics, 2 * natives.size());
+        updateShortcuts(natives, none);
+        qxt_x_listener = listener;
+        updateShortcuts(none, natives);
+        foreach (const NativeShortcut& native, natives)
+        {
+            if (native.ok)
+                continue;
+            qWarning() << "MAQxtGlobalShortcut failed to move native shortcut" << native.key << native.mods;
+            dropSubscribers(MAQxtGlobalShortcutTable::pack(native.key, native.mods));
+        }
+    }
+
+    if (listener)
+        listener->start();
+    if (previous)
+    {
+        previous->deliverQueued();
+        delete previous;
+    }
+    return true;
+}
+
+bool MAQxtGlobalShortcutPrivate::setNativeKeyStateTracked(bool tracked)
+{
+    if (!qxt_x_update_raw_selection(tracked || qxt_atomic_load_relaxed(qxt_x_passive_count)))
+        return false;
+    qxt_atomic_store_release(qxt_x_track_keys, tracked);
+    // Raw events may have been selected for passive shortcuts already.
+    if (tracked)
+        qxt_x_sync_key_state(qxt_x_raw_display, true);
+    return true;
+}
@@ -0,0 +1,174 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcutbatch.h"
+#include "maqxtglobalshortcut_p.h"
+
+class MAQxtGlobalShortcutBatchPrivate : public MAQxtPrivate<MAQxtGlobalShortcutBatch>
+{
+public:
+    MAQXT_DECLARE_PUBLIC(MAQxtGlobalShortcutBatch)
+    MAQxtGlobalShortcutBatchPrivate() : mode(MAQxtGlobalShortcutBatch::BestEffort) {}
+
+    MAQxtGlobalShortcutBatch::Mode mode;
+    QVector<MAQxtGlobalShortcutPrivate::BatchOperation> operations;
+
+    int append(MAQxtGlobalShortcutPrivate::BatchOperation::Type type, MAQxtGlobalShortcut* shortcut,
+               const QKeySequence& sequence = QKeySequence(), bool enabled = true);
+};
+
+int MAQxtGlobalShortcutBatchPrivate::append(MAQxtGlobalShortcutPrivate::BatchOperation::Type type, MAQxtGlobalShortcut* shortcut,
+                                            const QKeySequence& sequence, bool enabled)
+{
+    MAQxtGlobalShortcutPrivate::BatchOperation op;
+    op.type = type;
+    op.shortcut = shortcut;
+    op.sequence = sequence;
+    op.enabled = enabled;
+    op.ok = false;
+    operations.append(op);
+    return operations.size() - 1;
+}
+
+/*!
+    \class MAQxtGlobalShortcutBatch
+    \inmodule MAQxtGui
+    \brief The MAQxtGlobalShortcutBatch class applies many shortcut changes at once.
+
+    Setting shortcuts one by one costs one native registration, and on X11
+    one server round-trip, per shortcut. A batch collects set, unset and
+    enable operations and applies them together in apply(), which talks to
+    the window system once regardless of the number of entries.
+
+    Example usage:
+    \code
+    MAQxtGlobalShortcutBatch batch(MAQxtGlobalShortcutBatch::Atomic);
+    foreach (const Binding& binding, keymap)
+        batch.setShortcut(binding.shortcut, binding.sequence);
+    if (!batch.apply())
+        reportConflicts(batch);
+    \endcode
+
+    Operations are applied in the order they were added; the shortcuts
+    must stay alive until apply() returns.
+ */
+
+/*!
+    \enum MAQxtGlobalShortcutBatch::Mode
+
+    This enum describes what happens if some entries fail to register.
+
+    \value BestEffort Entries that could be registered are kept.
+    \value Atomic A failure rolls back the whole batch, leaving every shortcut as it was.
+ */
+
+/*!
+    Constructs an empty batch with \a mode.
+ */
+MAQxtGlobalShortcutBatch::MAQxtGlobalShortcutBatch(Mode mode)
+{
+    MAQXT_INIT_PRIVATE(MAQxtGlobalShortcutBatch);
+    qxt_d().mode = mode;
+}
+
+/*!
+    Destructs the batch. Operations that were not applied are discarded.
+ */
+MAQxtGlobalShortcutBatch::~MAQxtGlobalShortcutBatch()
+{
+}
+
+/*!
+    Returns the mode of the batch.
+ */
+MAQxtGlobalShortcutBatch::Mode MAQxtGlobalShortcutBatch::mode() const
+{
+    return qxt_d().mode;
+}
+
+/*!
+    Adds an operation that sets the key \a sequence of \a shortcut and
+    returns its index.
+
+    \sa MAQxtGlobalShortcut::setShortcut()
+ */
+int MAQxtGlobalShortcutBatch::setShortcut(MAQxtGlobalShortcut* shortcut, const QKeySequence& sequence)
+{
+    return qxt_d().append(MAQxtGlobalShortcutPrivate::BatchOperation::Set, shortcut, sequence);
+}
+
+/*!
+    Adds an operation that clears the key sequence of \a shortcut and
+    returns its index.
+ */
+int MAQxtGlobalShortcutBatch::unsetShortcut(MAQxtGlobalShortcut* shortcut)
+{
+    return qxt_d().append(MAQxtGlobalShortcutPrivate::BatchOperation::Unset, shortcut);
+}
+
+/*!
+    Adds an operation that sets \a shortcut \a enabled and returns its index.
+
+    \sa MAQxtGlobalShortcut::setEnabled()
+ */
+int MAQxtGlobalShortcutBatch::setEnabled(MAQxtGlobalShortcut* shortcut, bool enabled)
+{
+    return qxt_d().append(MAQxtGlobalShortcutPrivate::BatchOperation::Enable, shortcut, QKeySequence(), enabled);
+}
+
+/*!
+    Returns the number of operations in the batch.
+ */
+int MAQxtGlobalShortcutBatch::count() const
+{
+    return qxt_d().operations.size();
+}
+
+/*!
+    Applies all operations and returns \c true if every entry succeeded.
+
+    In \l Atomic mode nothing is changed unless all entries succeed. Use
+    result() to find out which entries failed.
+ */
+bool MAQxtGlobalShortcutBatch::apply()
+{
+    return MAQxtGlobalShortcutPrivate::applyBatch(qxt_d().operations, qxt_d().mode == Atomic);
+}
+
+/*!
+    Returns whether the operation at \a index succeeded the last time the
+    batch was applied.
+ */
+bool MAQxtGlobalShortcutBatch::result(int index) const
+{
+    return qxt_d().operations.at(index).ok;
+}
+
+/*!
+    Removes all operations from the batch.
+ */
+void MAQxtGlobalShortcutBatch::clear()
+{
+    qxt_d().operations.clear();
+}
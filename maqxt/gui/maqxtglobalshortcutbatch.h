@@ -0,0 +1,59 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTBATCH_H
+#define MAQXTGLOBALSHORTCUTBATCH_H
+
+#include "maqxt/core/maqxtglobal.h"
+#include <QKeySequence>
+class MAQxtGlobalShortcut;
+class MAQxtGlobalShortcutBatchPrivate;
+
+class MAQXT_GUI_EXPORT MAQxtGlobalShortcutBatch
+{
+    MAQXT_DECLARE_INLINE_PRIVATE(MAQxtGlobalShortcutBatch, 8 * sizeof(void*))
+
+public:
+    enum Mode
+    {
+        BestEffort,
+        Atomic
+    };
+
+    explicit MAQxtGlobalShortcutBatch(Mode mode = BestEffort);
+    ~MAQxtGlobalShortcutBatch();
+
+    Mode mode() const;
+
+    int setShortcut(MAQxtGlobalShortcut* shortcut, const QKeySequence& sequence);
+    int unsetShortcut(MAQxtGlobalShortcut* shortcut);
+    int setEnabled(MAQxtGlobalShortcut* shortcut, bool enabled = true);
+
+    int count() const;
+    bool apply();
+    bool result(int index) const;
+    void clear();
+};
+
+#endif // MAQXTGLOBALSHORTCUTBATCH_H
@@ -0,0 +1,280 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcutprofile.h"
+#include "maqxtglobalshortcut_p.h"
+#include <QCoreApplication>
+#include <QPointer>
+#include <QSet>
+#include <QThread>
+
+class MAQxtGlobalShortcutProfilePrivate : public MAQxtPrivate<MAQxtGlobalShortcutProfile>
+{
+public:
+    MAQXT_DECLARE_PUBLIC(MAQxtGlobalShortcutProfile)
+
+    struct Binding
+    {
+        QPointer<MAQxtGlobalShortcut> shortcut;
+        QKeySequence sequence;
+    };
+
+    QString name;
+    QList<Binding> bindings;
+
+    int indexOf(const MAQxtGlobalShortcut* shortcut) const;
+};
+
+// All profiles and the active one, guarded by MAQxtGlobalShortcutPrivate::mutex.
+static QList<MAQxtGlobalShortcutProfile*> qxt_profiles;
+static MAQxtGlobalShortcutProfile* qxt_active_profile = 0;
+
+int MAQxtGlobalShortcutProfilePrivate::indexOf(const MAQxtGlobalShortcut* shortcut) const
+{
+    for (int i = 0; i < bindings.size(); ++i)
+    {
+        if (bindings.at(i).shortcut == shortcut)
+            return i;
+    }
+    return -1;
+}
+
+/*!
+    \class MAQxtGlobalShortcutProfile
+    \inmodule MAQxtGui
+    \brief The MAQxtGlobalShortcutProfile class switches between named sets of shortcuts.
+
+    A profile binds key sequences to existing MAQxtGlobalShortcut objects,
+    for example one profile per mode of an application. Activating a
+    profile sets the shortcuts it binds and unsets those of the previously
+    active profile that it does not bind. Shortcuts bound by no profile are
+    left alone.
+
+    Example usage:
+    \code
+    MAQxtGlobalShortcutProfile editing("editing");
+    editing.setShortcut(saveShortcut, QKeySequence("Ctrl+Alt+S"));
+    editing.setShortcut(markShortcut, QKeySequence("Ctrl+Alt+Space"));
+
+    MAQxtGlobalShortcutProfile playback("playback");
+    playback.setShortcut(pauseShortcut, QKeySequence("Ctrl+Alt+Space"));
+
+    editing.activate();
+    ...
+    playback.activate(); // Ctrl+Alt+Space stays grabbed, now for pauseShortcut
+    \endcode
+
+    The switch is applied as one atomic MAQxtGlobalShortcutBatch: only
+    key combinations that the new profile gains or loses are grabbed or
+    released, and key events are dispatched either entirely before or
+    entirely after the switch.
+
+    Profiles do not own their shortcuts; a deleted shortcut drops out of
+    every profile.
+ */
+
+/*!
+    Constructs an empty profile called \a name.
+ */
+MAQxtGlobalShortcutProfile::MAQxtGlobalShortcutProfile(const QString& name)
+{
+    MAQXT_INIT_PRIVATE(MAQxtGlobalShortcutProfile);
+    qxt_d().name = name;
+    MAQxtGlobalShortcutLocker locker;
+    qxt_profiles.append(this);
+}
+
+/*!
+    Destructs the profile. The shortcuts keep their key sequences.
+ */
+MAQxtGlobalShortcutProfile::~MAQxtGlobalShortcutProfile()
+{
+    MAQxtGlobalShortcutLocker locker;
+    qxt_profiles.removeOne(this);
+    if (qxt_active_profile == this)
+        qxt_active_profile = 0;
+}
+
+/*!
+    Returns the name of the profile.
+ */
+QString MAQxtGlobalShortcutProfile::name() const
+{
+    return qxt_d().name;
+}
+
+/*!
+    Binds \a shortcut to \a sequence in this profile, replacing any earlier
+    binding of \a shortcut. An active profile takes the change with the
+    next call to activate().
+
+    \sa removeShortcut()
+ */
+void MAQxtGlobalShortcutProfile::setShortcut(MAQxtGlobalShortcut* shortcut, const QKeySequence& sequence)
+{
+    MAQxtGlobalShortcutLocker locker;
+    MAQxtGlobalShortcutProfilePrivate& d = qxt_d();
+    int index = d.indexOf(shortcut);
+    if (index < 0)
+    {
+        index = d.bindings.size();
+        d.bindings.append(MAQxtGlobalShortcutProfilePrivate::Binding());
+        d.bindings[index].shortcut = shortcut;
+    }
+    d.bindings[index].sequence = sequence;
+}
+
+/*!
+    Removes the binding of \a shortcut from this profile.
+
+    \sa setShortcut()
+ */
+void MAQxtGlobalShortcutProfile::removeShortcut(MAQxtGlobalShortcut* shortcut)
+{
+    MAQxtGlobalShortcutLocker locker;
+    const int index = qxt_d().indexOf(shortcut);
+    if (index >= 0)
+        qxt_d().bindings.removeAt(index);
+}
+
+/*!
+    Returns the key sequence this profile binds \a shortcut to, or an empty
+    sequence if it does not bind \a shortcut.
+ */
+QKeySequence MAQxtGlobalShortcutProfile::shortcut(MAQxtGlobalShortcut* shortcut) const
+{
+    MAQxtGlobalShortcutLocker locker;
+    const int index = qxt_d().indexOf(shortcut);
+    return index >= 0 ? qxt_d().bindings.at(index).sequence : QKeySequence();
+}
+
+/*!
+    Returns the shortcuts bound by this profile.
+ */
+QList<MAQxtGlobalShortcut*> MAQxtGlobalShortcutProfile::shortcuts() const
+{
+    MAQxtGlobalShortcutLocker locker;
+    QList<MAQxtGlobalShortcut*> res;
+    foreach (const MAQxtGlobalShortcutProfilePrivate::Binding& binding, qxt_d().bindings)
+    {
+        if (binding.shortcut)
+            res.append(binding.shortcut);
+    }
+    return res;
+}
+
+/*!
+    Returns \c true if this is the active profile.
+
+    \sa activate(), activeProfile()
+ */
+bool MAQxtGlobalShortcutProfile::isActive() const
+{
+    MAQxtGlobalShortcutLocker locker;
+    return qxt_active_profile == this;
+}
+
+/*!
+    Makes this the active profile and returns \c true on success.
+
+    The shortcuts bound by this profile get their key sequences and those
+    bound only by the previously active profile are unset, all in one
+    atomic batch. If any key sequence cannot be registered nothing
+    changes, the previous profile stays active and \c false is returned.
+    Activating the active profile again applies the bindings changed since.
+
+    When called from the main thread, activations that a listener thread
+    has queued for it are delivered first, so that key presses made before
+    the switch reach the shortcuts they were meant for.
+
+    \sa isActive()
+ */
+bool MAQxtGlobalShortcutProfile::activate()
+{
+    QCoreApplication* application = QCoreApplication::instance();
+    if (application && QThread::currentThread() == application->thread())
+        MAQxtGlobalShortcutPrivate::deliverQueuedActivations();
+
+    MAQxtGlobalShortcutLocker locker;
+    QVector<MAQxtGlobalShortcutPrivate::BatchOperation> operations;
+    QSet<MAQxtGlobalShortcut*> bound;
+    MAQxtGlobalShortcutPrivate::BatchOperation op;
+    op.enabled = true;
+    op.ok = false;
+    foreach (const MAQxtGlobalShortcutProfilePrivate::Binding& binding, qxt_d().bindings)
+    {
+        if (!binding.shortcut)
+            continue;
+        op.type = MAQxtGlobalShortcutPrivate::BatchOperation::Set;
+        op.shortcut = binding.shortcut;
+        op.sequence = binding.sequence;
+        operations.append(op);
+        bound.insert(binding.shortcut);
+    }
+    if (qxt_active_profile && qxt_active_profile != this)
+    {
+        foreach (const MAQxtGlobalShortcutProfilePrivate::Binding& binding, qxt_active_profile->qxt_d().bindings)
+        {
+            if (!binding.shortcut || bound.contains(binding.shortcut))
+                continue;
+            op.type = MAQxtGlobalShortcutPrivate::BatchOperation::Unset;
+            op.shortcut = binding.shortcut;
+            op.sequence = QKeySequence();
+            operations.append(op);
+        }
+    }
+
+    // Combinations that stay bound, to the same or another shortcut, keep
+    // their grabs; see MAQxtGlobalShortcutPrivate::moveSubscriptions().
+    if (!MAQxtGlobalShortcutPrivate::applyBatch(operations, true))
+        return false;
+    qxt_active_profile = this;
+    return true;
+}
+
+/*!
+    Returns the active profile, or 0 if none has been activated.
+
+    \sa activate()
+ */
+MAQxtGlobalShortcutProfile* MAQxtGlobalShortcutProfile::activeProfile()
+{
+    MAQxtGlobalShortcutLocker locker;
+    return qxt_active_profile;
+}
+
+/*!
+    Returns the profile called \a name, or 0 if there is none. If several
+    profiles share the name, the one constructed first is returned.
+ */
+MAQxtGlobalShortcutProfile* MAQxtGlobalShortcutProfile::profile(const QString& name)
+{
+    MAQxtGlobalShortcutLocker locker;
+    foreach (MAQxtGlobalShortcutProfile* profile, qxt_profiles)
+    {
+        if (profile->qxt_d().name == name)
+            return profile;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTPROFILE_H
+#define MAQXTGLOBALSHORTCUTPROFILE_H
+
+#include "maqxt/core/maqxtglobal.h"
+#include <QKeySequence>
+#include <QList>
+#include <QString>
+class MAQxtGlobalShortcut;
+class MAQxtGlobalShortcutProfilePrivate;
+
+class MAQXT_GUI_EXPORT MAQxtGlobalShortcutProfile
+{
+    MAQXT_DECLARE_PRIVATE(MAQxtGlobalShortcutProfile)
+
+public:
+    explicit MAQxtGlobalShortcutProfile(const QString& name);
+    ~MAQxtGlobalShortcutProfile();
+
+    QString name() const;
+
+    void setShortcut(MAQxtGlobalShortcut* shortcut, const QKeySequence& sequence);
+    void removeShortcut(MAQxtGlobalShortcut* shortcut);
+    QKeySequence shortcut(MAQxtGlobalShortcut* shortcut) const;
+    QList<MAQxtGlobalShortcut*> shortcuts() const;
+
+    bool isActive() const;
+    bool activate();
+
+    static MAQxtGlobalShortcutProfile* activeProfile();
+    static MAQxtGlobalShortcutProfile* profile(const QString& name);
+
+private:
+    Q_DISABLE_COPY(MAQxtGlobalShortcutProfile)
+};
+
+#endif // MAQXTGLOBALSHORTCUTPROFILE_H
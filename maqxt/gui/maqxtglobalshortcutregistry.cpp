@@ -0,0 +1,86 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcutregistry_p.h"
+
+MAQxtGlobalShortcutRegistry::MAQxtGlobalShortcutRegistry() : handlerInstalled(false)
+{
+}
+
+bool MAQxtGlobalShortcutRegistry::installHandler(void (*install)())
+{
+    if (handlerInstalled)
+        return false;
+    handlerInstalled = true;
+    install();
+    return true;
+}
+
+int MAQxtGlobalShortcutRegistry::add(quint32 nativeKey, quint32 nativeMods, void* handle)
+{
+    const quint64 key = MAQxtGlobalShortcutTable::pack(nativeKey, nativeMods);
+    int id = ids.value(key, 0);
+    if (id)
+    {
+        registrations[id - 1].handle = handle;
+        return id;
+    }
+
+    // Reuse released ids first, so that ids stay dense.
+    if (!freeIds.isEmpty())
+    {
+        id = freeIds.last();
+        freeIds.removeLast();
+    }
+    else
+    {
+        registrations.append(Registration());
+        used.append(false);
+        id = registrations.size();
+    }
+    Registration& registration = registrations[id - 1];
+    registration.nativeKey = nativeKey;
+    registration.nativeMods = nativeMods;
+    registration.handle = handle;
+    used[id - 1] = true;
+    ids.insert(key, id);
+    return id;
+}
+
+bool MAQxtGlobalShortcutRegistry::remove(int id)
+{
+    const Registration* registration = this->registration(id);
+    if (!registration)
+        return false;
+    ids.remove(MAQxtGlobalShortcutTable::pack(registration->nativeKey, registration->nativeMods));
+    used[id - 1] = false;
+    freeIds.append(id);
+    return true;
+}
+
+void MAQxtGlobalShortcutRegistry::setHandle(int id, void* handle)
+{
+    if (registration(id))
+        registrations[id - 1].handle = handle;
+}
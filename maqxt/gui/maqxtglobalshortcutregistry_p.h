@@ -0,0 +1,77 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTREGISTRY_P_H
+#define MAQXTGLOBALSHORTCUTREGISTRY_P_H
+
+#include "maqxtglobalshortcuttable_p.h"
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+
+// Book-keeping of the native registrations made by a backend. Each
+// (native key, native modifiers) pair gets a small, dense integer id that
+// can be handed to the window system (Carbon hot key ids, Windows hot key
+// ids) and mapped back in constant time when the hot key fires, together
+// with an optional backend handle.
+class MAQxtGlobalShortcutRegistry
+{
+public:
+    struct Registration
+    {
+        quint32 nativeKey;
+        quint32 nativeMods;
+        void* handle;
+    };
+
+    MAQxtGlobalShortcutRegistry();
+
+    // Calls install() the first time only; returns whether it was called.
+    bool installHandler(void (*install)());
+
+    int add(quint32 nativeKey, quint32 nativeMods, void* handle = 0);
+    bool remove(int id);
+    void setHandle(int id, void* handle);
+
+    inline int id(quint32 nativeKey, quint32 nativeMods) const
+    {
+        return ids.value(MAQxtGlobalShortcutTable::pack(nativeKey, nativeMods), 0);
+    }
+
+    inline const Registration* registration(int id) const
+    {
+        return id > 0 && id <= registrations.size() && used.at(id - 1) ? &registrations.at(id - 1) : 0;
+    }
+
+    inline int size() const { return ids.size(); }
+
+private:
+    QVector<Registration> registrations; // indexed by id - 1
+    QVector<bool> used;
+    QVector<int> freeIds;
+    QHash<quint64, int> ids;
+    bool handlerInstalled;
+};
+
+#endif // MAQXTGLOBALSHORTCUTREGISTRY_P_H
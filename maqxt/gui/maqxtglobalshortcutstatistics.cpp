@@ -0,0 +1,161 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcutstatistics_p.h"
+#include <string.h>
+
+MAQxtGlobalShortcutStatisticsCollector::MAQxtGlobalShortcutStatisticsCollector() : enabled(false)
+{
+    reset();
+}
+
+void MAQxtGlobalShortcutStatisticsCollector::reset()
+{
+    activations = 0;
+    disabledHits = 0;
+    filterRejects = 0;
+    lookupMisses = 0;
+    qxt_atomic_store_release(uncountedDisabledHits, 0);
+    qxt_atomic_store_release(uncountedRejects, 0);
+    qxt_atomic_store_release(uncountedMisses, 0);
+    latencySamples = 0;
+    latencyMax = 0;
+    memset(latencyHistogram, 0, sizeof(latencyHistogram));
+    registrationCalls = 0;
+    registrationOperations = 0;
+    registrationTotalUsecs = 0;
+    registrationMaxUsecs = 0;
+}
+
+void MAQxtGlobalShortcutStatisticsCollector::collect()
+{
+    disabledHits += quint32(uncountedDisabledHits.fetchAndStoreRelaxed(0));
+    filterRejects += quint32(uncountedRejects.fetchAndStoreRelaxed(0));
+    lookupMisses += quint32(uncountedMisses.fetchAndStoreRelaxed(0));
+}
+
+void MAQxtGlobalShortcutStatisticsCollector::addLatency(qint64 msecs)
+{
+    ++latencySamples;
+    latencyMax = qMax(latencyMax, msecs);
+    ++latencyHistogram[qMin(msecs, qint64(HistogramSize - 1))];
+}
+
+void MAQxtGlobalShortcutStatisticsCollector::addRegistration(qint64 usecs, int operations)
+{
+    ++registrationCalls;
+    registrationOperations += operations;
+    registrationTotalUsecs += usecs;
+    registrationMaxUsecs = qMax(registrationMaxUsecs, usecs);
+}
+
+// Smallest latency that at least 'percent' of the samples do not exceed.
+static int qxt_percentile(const quint64* histogram, int size, quint64 samples, int percent, int max)
+{
+    if (!samples)
+        return 0;
+    quint64 count = 0;
+    for (int i = 0; i < size - 1; ++i)
+    {
+        count += histogram[i];
+        if (count * 100 >= samples * percent)
+            return i;
+    }
+    return max;
+}
+
+void MAQxtGlobalShortcutStatisticsCollector::fill(MAQxtGlobalShortcutStatistics& statistics) const
+{
+    statistics.activations = activations;
+    statistics.disabledHits = disabledHits;
+    statistics.filterRejects = filterRejects;
+    statistics.lookupMisses = lookupMisses;
+    statistics.latencySamples = latencySamples;
+    statistics.latencyMax = int(latencyMax);
+    statistics.latencyP50 = qxt_percentile(latencyHistogram, HistogramSize, latencySamples, 50, statistics.latencyMax);
+    statistics.latencyP99 = qxt_percentile(latencyHistogram, HistogramSize, latencySamples, 99, statistics.latencyMax);
+    statistics.latencyHistogram.resize(HistogramSize);
+    for (int i = 0; i < HistogramSize; ++i)
+        statistics.latencyHistogram[i] = latencyHistogram[i];
+    statistics.registrationCalls = registrationCalls;
+    statistics.registrationOperations = registrationOperations;
+    statistics.registrationTotalUsecs = registrationTotalUsecs;
+    statistics.registrationMaxUsecs = registrationMaxUsecs;
+}
+
+/*!
+    \class MAQxtGlobalShortcutStatistics
+    \inmodule MAQxtGui
+    \brief The MAQxtGlobalShortcutStatistics struct is a snapshot of global shortcut statistics.
+
+    Statistics are collected only while enabled with
+    MAQxtGlobalShortcut::setStatisticsEnabled(); a snapshot is taken with
+    MAQxtGlobalShortcut::statistics().
+
+    Example usage:
+    \code
+    MAQxtGlobalShortcut::setStatisticsEnabled(true);
+    ...
+    const MAQxtGlobalShortcutStatistics stats = MAQxtGlobalShortcut::statistics();
+    qDebug() << "p99 latency" << stats.latencyP99 << "ms over" << stats.latencySamples << "activations";
+    \endcode
+
+    \section1 Dispatch
+
+    \c activations counts emitted activated() signals, \c disabledHits key
+    presses of disabled shortcuts. \c filterRejects counts native key events
+    turned down before the table lookup, \c lookupMisses those that got to
+    the lookup without matching a shortcut. \c shortcuts lists every
+    registered shortcut with its own activation count.
+
+    \section1 Latency
+
+    The time from the native key event to the activated() emission, in
+    milliseconds, measured against the window system's event timestamp:
+    the X server time on X11, the Carbon event time on Mac OS X. Queued
+    delivery includes the time spent in the queue. \c latencyHistogram has
+    one bucket per millisecond; the last bucket also holds all slower
+    activations. \c latencyP50 and \c latencyP99 are read from the
+    histogram, \c latencyMax is exact.
+
+    \section1 Registration
+
+    \c registrationCalls counts the native registration updates, each of
+    which costs at most one server round-trip on X11, and
+    \c registrationOperations the grabs and ungrabs they carried.
+    \c registrationTotalUsecs and \c registrationMaxUsecs give their wall
+    clock time in microseconds.
+
+    \sa MAQxtGlobalShortcut::statistics()
+ */
+
+/*!
+    Constructs an empty snapshot.
+ */
+MAQxtGlobalShortcutStatistics::MAQxtGlobalShortcutStatistics()
+    : activations(0), disabledHits(0), filterRejects(0), lookupMisses(0),
+      latencySamples(0), latencyP50(0), latencyP99(0), latencyMax(0),
+      registrationCalls(0), registrationOperations(0), registrationTotalUsecs(0), registrationMaxUsecs(0)
+{
+}
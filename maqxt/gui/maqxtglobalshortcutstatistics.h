@@ -0,0 +1,66 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTSTATISTICS_H
+#define MAQXTGLOBALSHORTCUTSTATISTICS_H
+
+#include "maqxt/core/maqxtglobal.h"
+#include <QKeySequence>
+#include <QList>
+#include <QVector>
+class MAQxtGlobalShortcut;
+
+struct MAQXT_GUI_EXPORT MAQxtGlobalShortcutStatistics
+{
+    struct Shortcut
+    {
+        const MAQxtGlobalShortcut* shortcut;
+        QKeySequence sequence;
+        quint64 activations;
+    };
+
+    MAQxtGlobalShortcutStatistics();
+
+    // Dispatch
+    quint64 activations;
+    quint64 disabledHits;
+    quint64 filterRejects;
+    quint64 lookupMisses;
+    QList<Shortcut> shortcuts;
+
+    // Latency from the native key event to activated(), in milliseconds
+    quint64 latencySamples;
+    int latencyP50;
+    int latencyP99;
+    int latencyMax;
+    QVector<quint64> latencyHistogram;
+
+    // Native registration round-trips
+    quint64 registrationCalls;
+    quint64 registrationOperations;
+    qint64 registrationTotalUsecs;
+    qint64 registrationMaxUsecs;
+};
+
+#endif // MAQXTGLOBALSHORTCUTSTATISTICS_H
@@ -0,0 +1,95 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTSTATISTICS_P_H
+#define MAQXTGLOBALSHORTCUTSTATISTICS_P_H
+
+#include "maqxtglobalshortcutstatistics.h"
+#include "maqxtspscring_p.h"
+#include <QElapsedTimer>
+
+// Counters behind MAQxtGlobalShortcut::statistics(). Everything is updated
+// with MAQxtGlobalShortcutPrivate::mutex held, and only after checking
+// 'enabled', so a disabled collector costs one predictable branch. Key
+// events turned away without the mutex are counted in the 'uncounted'
+// atomics, which collect() adds to the others.
+class MAQxtGlobalShortcutStatisticsCollector
+{
+public:
+    // One bucket per millisecond; the last one collects everything slower.
+    enum { HistogramSize = 256 };
+
+    MAQxtGlobalShortcutStatisticsCollector();
+
+    void reset();
+    void collect();
+    void addLatency(qint64 msecs);
+    void addRegistration(qint64 usecs, int operations);
+    void fill(MAQxtGlobalShortcutStatistics& statistics) const;
+
+    bool enabled;
+    quint64 activations;
+    quint64 disabledHits;
+    quint64 filterRejects;
+    quint64 lookupMisses;
+    QAtomicInt uncountedDisabledHits;
+    QAtomicInt uncountedRejects;
+    QAtomicInt uncountedMisses;
+
+private:
+    quint64 latencySamples;
+    qint64 latencyMax;
+    quint64 latencyHistogram[HistogramSize];
+    quint64 registrationCalls;
+    quint64 registrationOperations;
+    qint64 registrationTotalUsecs;
+    qint64 registrationMaxUsecs;
+};
+
+// Times a native registration update for the lifetime of the object.
+class MAQxtRegistrationTimer
+{
+public:
+    MAQxtRegistrationTimer(MAQxtGlobalShortcutStatisticsCollector& collector, int operations)
+        : collector(collector), operations(collector.enabled ? operations : 0)
+    {
+        if (this->operations)
+            timer.start();
+    }
+
+    ~MAQxtRegistrationTimer()
+    {
+        if (operations)
+            collector.addRegistration(timer.nsecsElapsed() / 1000, operations);
+    }
+
+private:
+    Q_DISABLE_COPY(MAQxtRegistrationTimer)
+
+    MAQxtGlobalShortcutStatisticsCollector& collector;
+    const int operations;
+    QElapsedTimer timer;
+};
+
+#endif // MAQXTGLOBALSHORTCUTSTATISTICS_P_H
@@ -0,0 +1,180 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcuttable_p.h"
+#include <string.h>
+
+static const int qxt_table_line_size = 64;
+static const quint32 qxt_table_min_capacity = qxt_table_line_size / sizeof(MAQxtGlobalShortcutTable::Entry);
+
+MAQxtGlobalShortcutTable::MAQxtGlobalShortcutTable() : table(0), mask(0), count(0), modifierUnion(0), wideKeys(0)
+{
+    memset(keyBits, 0, sizeof(keyBits));
+    memset(keyRefs, 0, sizeof(keyRefs));
+    memset(modifierRefs, 0, sizeof(modifierRefs));
+}
+
+MAQxtGlobalShortcutTable::~MAQxtGlobalShortcutTable()
+{
+    qFreeAligned(table);
+}
+
+void MAQxtGlobalShortcutTable::rehash(quint32 capacity)
+{
+    Entry* old = table;
+    const quint32 oldCapacity = table ? mask + 1 : 0;
+
+    table = static_cast<Entry*>(qMallocAligned(capacity * sizeof(Entry), qxt_table_line_size));
+    memset(table, 0, capacity * sizeof(Entry));
+    mask = capacity - 1;
+    for (quint32 i = 0; i < oldCapacity; ++i)
+    {
+        if (!old[i].shortcut)
+            continue;
+        quint32 j = slot(old[i].key & ~DisabledFlag);
+        while (table[j].shortcut)
+            j = (j + 1) & mask;
+        table[j] = old[i];
+    }
+    qFreeAligned(old);
+}
+
+void MAQxtGlobalShortcutTable::insert(quint64 key, MAQxtGlobalShortcut* shortcut, bool enabled)
+{
+    Q_ASSERT(shortcut);
+    // Keep the load factor at or below 1/2, so probe sequences stay short.
+    if (!table || quint32(count + 1) * 2 > mask + 1)
+        rehash(table ? (mask + 1) * 2 : qxt_table_min_capacity);
+
+    quint32 i = slot(key);
+    while (table[i].shortcut && (table[i].key & ~DisabledFlag) != key)
+        i = (i + 1) & mask;
+    if (!table[i].shortcut)
+    {
+        ++count;
+        addFilterBits(key);
+    }
+    table[i].key = enabled ? key : key | DisabledFlag;
+    table[i].shortcut = shortcut;
+}
+
+bool MAQxtGlobalShortcutTable::remove(quint64 key)
+{
+    const Entry* entry = find(key);
+    if (!entry)
+        return false;
+
+    removeFilterBits(key);
+
+    // Backward shift deletion: move later entries of the probe sequence up,
+    // so that lookups never need tombstones.
+    quint32 hole = quint32(entry - table);
+    for (quint32 i = (hole + 1) & mask; table[i].shortcut; i = (i + 1) & mask)
+    {
+        const quint32 home = slot(table[i].key & ~DisabledFlag);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole].key = 0;
+    table[hole].shortcut = 0;
+    --count;
+    return true;
+}
+
+bool MAQxtGlobalShortcutTable::setEnabled(quint64 key, const MAQxtGlobalShortcut* shortcut, bool enabled)
+{
+    Entry* entry = const_cast<Entry*>(find(key));
+    if (!entry || entry->shortcut != shortcut)
+        return false;
+    entry->key = enabled ? key : key | DisabledFlag;
+    return true;
+}
+
+void MAQxtGlobalShortcutTable::clear()
+{
+    qFreeAligned(table);
+    table = 0;
+    mask = 0;
+    count = 0;
+    modifierUnion = 0;
+    wideKeys = 0;
+    memset(keyBits, 0, sizeof(keyBits));
+    memset(keyRefs, 0, sizeof(keyRefs));
+    memset(modifierRefs, 0, sizeof(modifierRefs));
+}
+
+void MAQxtGlobalShortcutTable::addFilterBits(quint64 key)
+{
+    const quint32 nativeKey = quint32(key >> 32);
+    const quint32 nativeMods = quint32(key);
+    if (nativeKey < 256)
+    {
+        if (!keyRefs[nativeKey]++)
+            keyBits[nativeKey >> 5] |= 1u << (nativeKey & 31);
+    }
+    else
+    {
+        ++wideKeys;
+    }
+    for (int bit = 0; bit < 32; ++bit)
+    {
+        if ((nativeMods & (1u << bit)) && !modifierRefs[bit]++)
+            modifierUnion |= 1u << bit;
+    }
+}
+
+void MAQxtGlobalShortcutTable::removeFilterBits(quint64 key)
+{
+    const quint32 nativeKey = quint32(key >> 32);
+    const quint32 nativeMods = quint32(key);
+    if (nativeKey < 256)
+    {
+        if (!--keyRefs[nativeKey])
+            keyBits[nativeKey >> 5] &= ~(1u << (nativeKey & 31));
+    }
+    else
+    {
+        --wideKeys;
+    }
+    for (int bit = 0; bit < 32; ++bit)
+    {
+        if ((nativeMods & (1u << bit)) && !--modifierRefs[bit])
+            modifierUnion &= ~(1u << bit);
+    }
+}
+
+QVector<MAQxtGlobalShortcutTable::Entry> MAQxtGlobalShortcutTable::entries() const
+{
+    QVector<Entry> result;
+    result.reserve(count);
+    for (quint32 i = 0; table && i <= mask; ++i)
+    {
+        if (table[i].shortcut)
+            result.append(table[i]);
+    }
+    return result;
+}
@@ -0,0 +1,124 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTTABLE_P_H
+#define MAQXTGLOBALSHORTCUTTABLE_P_H
+
+#include <QtGlobal>
+#include <QVector>
+class MAQxtGlobalShortcut;
+
+// Open addressing hash table mapping a packed (native key, native modifiers)
+// pair to its shortcut. Entries are 16 bytes and stored in one flat, cache
+// line aligned array with linear probing, and carry the enabled state of
+// the shortcut, so that dispatching a key press usually reads a single
+// cache line and never dereferences the shortcut unless it fires.
+class MAQxtGlobalShortcutTable
+{
+public:
+    static const quint64 DisabledFlag = Q_UINT64_C(1) << 63;
+
+    struct Entry
+    {
+        quint64 key;                    // pack() result, ORed with DisabledFlag
+        MAQxtGlobalShortcut* shortcut;  // 0 for free slots
+
+        inline quint32 nativeKey() const { return quint32((key & ~DisabledFlag) >> 32); }
+        inline quint32 nativeMods() const { return quint32(key); }
+        inline bool isEnabled() const { return !(key & DisabledFlag); }
+    };
+
+    MAQxtGlobalShortcutTable();
+    ~MAQxtGlobalShortcutTable();
+
+    static inline quint64 pack(quint32 nativeKey, quint32 nativeMods)
+    {
+        return (quint64(nativeKey) << 32) | nativeMods;
+    }
+
+    // Cheap pre-check for the event filter: false if no entry can match,
+    // judged from a bitmap of the keycodes below 256 and the union of all
+    // registered modifier masks.
+    inline bool mayContain(quint32 nativeKey, quint32 nativeMods) const
+    {
+        if (nativeMods & ~modifierUnion)
+            return false;
+        if (nativeKey < 256)
+            return keyBits[nativeKey >> 5] & (1u << (nativeKey & 31));
+        return wideKeys != 0;
+    }
+
+    inline const Entry* find(quint64 key) const
+    {
+        if (!count)
+            return 0;
+        for (quint32 i = slot(key); ; i = (i + 1) & mask)
+        {
+            const Entry& entry = table[i];
+            if (!entry.shortcut)
+                return 0;
+            if ((entry.key & ~DisabledFlag) == key)
+                return &entry;
+        }
+    }
+
+    inline MAQxtGlobalShortcut* value(quint64 key) const
+    {
+        const Entry* entry = find(key);
+        return entry ? entry->shortcut : 0;
+    }
+
+    void insert(quint64 key, MAQxtGlobalShortcut* shortcut, bool enabled);
+    bool remove(quint64 key);
+    bool setEnabled(quint64 key, const MAQxtGlobalShortcut* shortcut, bool enabled);
+    void clear();
+
+    inline int size() const { return count; }
+    QVector<Entry> entries() const;
+
+private:
+    Q_DISABLE_COPY(MAQxtGlobalShortcutTable)
+
+    inline quint32 slot(quint64 key) const
+    {
+        // Fibonacci hashing; the top bits are the best mixed ones.
+        return quint32((key * Q_UINT64_C(0x9e3779b97f4a7c15)) >> 32) & mask;
+    }
+
+    void rehash(quint32 capacity);
+    void addFilterBits(quint64 key);
+    void removeFilterBits(quint64 key);
+
+    Entry* table;
+    quint32 mask;
+    int count;
+
+    quint32 keyBits[8];
+    quint32 modifierUnion;
+    int wideKeys;
+    quint16 keyRefs[256];
+    quint16 modifierRefs[32];
+};
+
+#endif // MAQXTGLOBALSHORTCUTTABLE_P_H
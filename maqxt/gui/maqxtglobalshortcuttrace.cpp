@@ -0,0 +1,166 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcuttrace_p.h"
+#include <QIODevice>
+#include <QtDebug>
+#include <string.h>
+
+// Native codes only mean something to the backend that produced them.
+enum
+{
+    QxtTraceX11 = 1,
+    QxtTraceCarbon = 2,
+    QxtTraceWindows = 3,
+    QxtTraceEvdev = 4
+};
+
+#if defined(Q_OS_MAC)
+static const quint16 qxt_trace_backend = QxtTraceCarbon;
+#elif defined(Q_OS_WIN)
+static const quint16 qxt_trace_backend = QxtTraceWindows;
+#elif defined(MAQXT_EVDEV_BACKEND)
+static const quint16 qxt_trace_backend = QxtTraceEvdev;
+#else
+static const quint16 qxt_trace_backend = QxtTraceX11;
+#endif
+
+static const char qxt_trace_magic[] = { 'M', 'Q', 'X', 'T', 'R', 'A', 'C', 'E' };
+static const quint16 qxt_trace_version = 1;
+
+static inline void qxt_trace_put16(char* data, quint16 value)
+{
+    data[0] = char(value);
+    data[1] = char(value >> 8);
+}
+
+static inline void qxt_trace_put32(char* data, quint32 value)
+{
+    data[0] = char(value);
+    data[1] = char(value >> 8);
+    data[2] = char(value >> 16);
+    data[3] = char(value >> 24);
+}
+
+static inline quint16 qxt_trace_get16(const char* data)
+{
+    return quint16(uchar(data[0]) | (uchar(data[1]) << 8));
+}
+
+static inline quint32 qxt_trace_get32(const char* data)
+{
+    return quint32(uchar(data[0])) | (quint32(uchar(data[1])) << 8)
+         | (quint32(uchar(data[2])) << 16) | (quint32(uchar(data[3])) << 24);
+}
+
+MAQxtGlobalShortcutTrace::MAQxtGlobalShortcutTrace() : active(0), device(0)
+{
+}
+
+bool MAQxtGlobalShortcutTrace::start(QIODevice* device)
+{
+    stop();
+    QMutexLocker locker(&mutex);
+    if (!device || !device->isWritable())
+        return false;
+    char header[HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, qxt_trace_magic, sizeof(qxt_trace_magic));
+    qxt_trace_put16(header + 8, qxt_trace_version);
+    qxt_trace_put16(header + 10, qxt_trace_backend);
+    if (device->write(header, HeaderSize) != HeaderSize)
+        return false;
+    this->device = device;
+    buffer.reserve(BufferedRecords * RecordSize);
+    qxt_atomic_store_release(active, 1);
+    return true;
+}
+
+void MAQxtGlobalShortcutTrace::stop()
+{
+    QMutexLocker locker(&mutex);
+    if (!device)
+        return;
+    flush();
+    device = 0;
+    qxt_atomic_store_release(active, 0);
+}
+
+void MAQxtGlobalShortcutTrace::record(quint32 time, quint32 nativeKey, quint32 nativeMods, bool release)
+{
+    QMutexLocker locker(&mutex);
+    // Stopped since the caller checked isActive().
+    if (!device)
+        return;
+    char data[RecordSize];
+    qxt_trace_put32(data, time);
+    qxt_trace_put32(data + 4, nativeKey);
+    qxt_trace_put32(data + 8, release ? nativeMods | ReleaseFlag : nativeMods);
+    buffer.append(data, RecordSize);
+    if (buffer.size() >= BufferedRecords * RecordSize)
+        flush();
+}
+
+void MAQxtGlobalShortcutTrace::flush()
+{
+    if (device->write(buffer) != buffer.size())
+    {
+        qWarning() << "MAQxtGlobalShortcut failed to write the key event trace, recording stopped";
+        device = 0;
+        qxt_atomic_store_release(active, 0);
+    }
+    buffer.clear();
+}
+
+bool MAQxtGlobalShortcutTrace::read(QIODevice* device, QVector<Event>& events)
+{
+    if (!device || !device->isReadable())
+        return false;
+    const QByteArray data = device->readAll();
+    if (data.size() < HeaderSize || memcmp(data.constData(), qxt_trace_magic, sizeof(qxt_trace_magic)))
+    {
+        qWarning() << "MAQxtGlobalShortcut: not a key event trace";
+        return false;
+    }
+    const char* header = data.constData();
+    if (qxt_trace_get16(header + 8) != qxt_trace_version || qxt_trace_get16(header + 10) != qxt_trace_backend)
+    {
+        qWarning() << "MAQxtGlobalShortcut: key event trace of another version or backend";
+        return false;
+    }
+    // A trace cut short by a crash ends with a partial record; drop it.
+    const int count = (data.size() - HeaderSize) / RecordSize;
+    events.resize(count);
+    const char* record = header + HeaderSize;
+    for (int i = 0; i < count; ++i, record += RecordSize)
+    {
+        Event& event = events[i];
+        const quint32 mods = qxt_trace_get32(record + 8);
+        event.time = qxt_trace_get32(record);
+        event.nativeKey = qxt_trace_get32(record + 4);
+        event.nativeMods = mods & ~ReleaseFlag;
+        event.release = (mods & ReleaseFlag) != 0;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTTRACE_P_H
+#define MAQXTGLOBALSHORTCUTTRACE_P_H
+
+#include "maqxtspscring_p.h"
+#include <QtGlobal>
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+class QIODevice;
+
+// Recorder and reader of the native key event traces behind
+// MAQxtGlobalShortcut::startTrace() and replayTrace(). A trace is a 16 byte
+// header followed by 12 byte little-endian records of event time, native
+// keycode and native modifiers; ReleaseFlag in the modifiers marks a key
+// release. Records are buffered and written in blocks. Events are recorded
+// before the dispatch decides whether to take MAQxtGlobalShortcutPrivate::mutex,
+// so the recorder has a lock of its own; it costs one branch while inactive.
+class MAQxtGlobalShortcutTrace
+{
+public:
+    enum { HeaderSize = 16, RecordSize = 12, BufferedRecords = 256 };
+    static const quint32 ReleaseFlag = 0x40000000u;
+
+    struct Event
+    {
+        quint32 time;
+        quint32 nativeKey;
+        quint32 nativeMods;
+        bool release;
+    };
+
+    MAQxtGlobalShortcutTrace();
+
+    bool start(QIODevice* device);
+    void stop();
+    inline bool isActive() const { return qxt_atomic_load_relaxed(active) != 0; }
+    void record(quint32 time, quint32 nativeKey, quint32 nativeMods, bool release);
+
+    // Reads a whole trace written by the same backend.
+    static bool read(QIODevice* device, QVector<Event>& events);
+
+private:
+    Q_DISABLE_COPY(MAQxtGlobalShortcutTrace)
+
+    void flush();
+
+    QMutex mutex;
+    QAtomicInt active;
+    QIODevice* device;
+    QByteArray buffer;
+};
+
+#endif // MAQXTGLOBALSHORTCUTTRACE_P_H
@@ -0,0 +1,126 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtglobalshortcuttrie_p.h"
+
+MAQxtGlobalShortcutTrie::MAQxtGlobalShortcutTrie()
+{
+    clear();
+}
+
+int MAQxtGlobalShortcutTrie::allocate()
+{
+    Node node;
+    node.shortcut = 0;
+    if (!freeNodes.isEmpty())
+    {
+        const int index = freeNodes.last();
+        freeNodes.removeLast();
+        nodes[index] = node;
+        return index;
+    }
+    nodes.append(node);
+    return nodes.size() - 1;
+}
+
+bool MAQxtGlobalShortcutTrie::insert(const QVector<quint64>& path, MAQxtGlobalShortcut* shortcut)
+{
+    Q_ASSERT(shortcut && !path.isEmpty());
+    // Walk the existing part of the path first, so that a conflict leaves
+    // the tree untouched.
+    int node = Root;
+    int depth = 0;
+    for (; depth < path.size(); ++depth)
+    {
+        const int next = child(node, path.at(depth));
+        if (next == None)
+            break;
+        node = next;
+        if (nodes.at(node).shortcut)
+            return false;
+    }
+    if (depth == path.size())
+        return false;
+
+    for (; depth < path.size(); ++depth)
+    {
+        const int next = allocate();
+        nodes[node].children.insert(path.at(depth), next);
+        node = next;
+    }
+    nodes[node].shortcut = shortcut;
+    return true;
+}
+
+bool MAQxtGlobalShortcutTrie::remove(const QVector<quint64>& path, const MAQxtGlobalShortcut* shortcut)
+{
+    QVector<int> trail;
+    trail.reserve(path.size() + 1);
+    trail.append(Root);
+    foreach (quint64 chord, path)
+    {
+        const int next = child(trail.last(), chord);
+        if (next == None)
+            return false;
+        trail.append(next);
+    }
+    if (!shortcut || nodes.at(trail.last()).shortcut != shortcut)
+        return false;
+
+    // Prune the branch up to the first node still shared with others.
+    nodes[trail.last()].shortcut = 0;
+    for (int i = path.size(); i > 0; --i)
+    {
+        const int node = trail.at(i);
+        if (!nodes.at(node).children.isEmpty())
+            break;
+        nodes[trail.at(i - 1)].children.remove(path.at(i - 1));
+        freeNodes.append(node);
+    }
+    return true;
+}
+
+void MAQxtGlobalShortcutTrie::clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    allocate();
+}
+
+QList<MAQxtGlobalShortcut*> MAQxtGlobalShortcutTrie::shortcuts() const
+{
+    QList<MAQxtGlobalShortcut*> result;
+    QVector<int> pending;
+    pending.append(Root);
+    while (!pending.isEmpty())
+    {
+        const Node& node = nodes.at(pending.last());
+        pending.removeLast();
+        if (node.shortcut)
+            result.append(node.shortcut);
+        foreach (int next, node.children)
+            pending.append(next);
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTGLOBALSHORTCUTTRIE_P_H
+#define MAQXTGLOBALSHORTCUTTRIE_P_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QVector>
+class MAQxtGlobalShortcut;
+
+// Prefix tree of multi-chord shortcuts. Every edge is a packed (native key,
+// native modifiers) chord as produced by MAQxtGlobalShortcutTable::pack();
+// bindings sit on leaves only, so that a chord never both completes one
+// shortcut and continues another. Nodes are kept in one vector and referred
+// to by index; Root is the empty prefix.
+class MAQxtGlobalShortcutTrie
+{
+public:
+    enum { Root = 0, None = -1 };
+
+    MAQxtGlobalShortcutTrie();
+
+    // Fails if 'path' is bound already, or is a prefix or an extension of
+    // another binding.
+    bool insert(const QVector<quint64>& path, MAQxtGlobalShortcut* shortcut);
+    // Fails unless 'path' is bound to 'shortcut'.
+    bool remove(const QVector<quint64>& path, const MAQxtGlobalShortcut* shortcut);
+    void clear();
+
+    inline int child(int node, quint64 chord) const
+    {
+        return nodes.at(node).children.value(chord, None);
+    }
+
+    inline MAQxtGlobalShortcut* shortcut(int node) const { return nodes.at(node).shortcut; }
+    inline QList<quint64> chords(int node) const { return nodes.at(node).children.keys(); }
+    inline bool isEmpty() const { return nodes.at(Root).children.isEmpty(); }
+
+    QList<MAQxtGlobalShortcut*> shortcuts() const;
+
+private:
+    struct Node
+    {
+        QHash<quint64, int> children;
+        MAQxtGlobalShortcut* shortcut;
+    };
+
+    int allocate();
+
+    QVector<Node> nodes;
+    QVector<int> freeNodes;
+};
+
+#endif // MAQXTGLOBALSHORTCUTTRIE_P_H
@@ -0,0 +1,143 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtkeyboardlayoutindex_p.h"
+#include <string.h>
+
+// The layout as declared by UnicodeUtilities.h, in host byte order.
+enum
+{
+    QxtLayoutKeyboardTypeCount = 8,     // UCKeyboardLayout::keyboardTypeCount
+    QxtLayoutKeyboardTypeList = 12,     // UCKeyboardLayout::keyboardTypeList
+    QxtLayoutTypeHeaderSize = 28,       // sizeof(UCKeyboardTypeHeader)
+    QxtLayoutCharTableIndexOffset = 12, // UCKeyboardTypeHeader::keyToCharTableIndexOffset
+    QxtLayoutStateRecordsOffset = 16,   // UCKeyboardTypeHeader::keyStateRecordsIndexOffset
+    QxtLayoutCharTableIndexFormat = 0x3000,  // kUCKeyToCharTableIndexFormat
+    QxtLayoutStateRecordsFormat = 0x4000,    // kUCKeyStateRecordsIndexFormat
+    QxtLayoutOutputKindMask = 0xc000,        // kUCKeyOutputTestForIndexMask
+    QxtLayoutOutputStateIndex = 0x4000,      // kUCKeyOutputStateIndexMask
+    QxtLayoutOutputIndexMask = 0x3fff        // kUCKeyOutputGetIndexMask
+};
+
+namespace
+{
+    class MAQxtLayoutReader
+    {
+    public:
+        MAQxtLayoutReader(const uchar* data, quint32 size) : data(data), size(size) {}
+
+        inline bool contains(quint32 offset, quint32 length) const
+        {
+            return offset <= size && length <= size - offset;
+        }
+
+        // Out of range reads yield 0, which no table accepts as valid.
+        inline quint16 u16(quint32 offset) const
+        {
+            quint16 value = 0;
+            if (contains(offset, sizeof(value)))
+                memcpy(&value, data + offset, sizeof(value));
+            return value;
+        }
+
+        inline quint32 u32(quint32 offset) const
+        {
+            quint32 value = 0;
+            if (contains(offset, sizeof(value)))
+                memcpy(&value, data + offset, sizeof(value));
+            return value;
+        }
+
+    private:
+        const uchar* data;
+        quint32 size;
+    };
+}
+
+MAQxtKeyboardLayoutIndex::MAQxtKeyboardLayoutIndex()
+{
+}
+
+void MAQxtKeyboardLayoutIndex::clear()
+{
+    keycodes.clear();
+}
+
+bool MAQxtKeyboardLayoutIndex::build(const uchar* data, int size)
+{
+    keycodes.clear();
+    if (!data || size < QxtLayoutKeyboardTypeList)
+        return false;
+    const MAQxtLayoutReader layout(data, quint32(size));
+    const quint32 typeCount = layout.u32(QxtLayoutKeyboardTypeCount);
+    if (typeCount > (quint32(size) - QxtLayoutKeyboardTypeList) / QxtLayoutTypeHeaderSize)
+        return false;
+
+    for (quint32 i = 0; i < typeCount; ++i)
+    {
+        const quint32 type = QxtLayoutKeyboardTypeList + i * QxtLayoutTypeHeaderSize;
+        const quint32 charIndex = layout.u32(type + QxtLayoutCharTableIndexOffset);
+        if (layout.u16(charIndex) != QxtLayoutCharTableIndexFormat)
+            continue;
+        // Dead key states: a state record's first field is the character
+        // the key produces from the base state.
+        const quint32 stateIndex = layout.u32(type + QxtLayoutStateRecordsOffset);
+        const quint32 stateCount = stateIndex && layout.u16(stateIndex) == QxtLayoutStateRecordsFormat ? layout.u16(stateIndex + 2) : 0;
+
+        const quint32 keyCount = layout.u16(charIndex + 2);
+        const quint32 tableCount = layout.u32(charIndex + 4);
+        for (quint32 j = 0; j < tableCount && layout.contains(charIndex + 8 + 4 * j, 4); ++j)
+        {
+            const quint32 table = layout.u32(charIndex + 8 + 4 * j);
+            if (!layout.contains(table, 2 * keyCount))
+                continue;
+            for (quint32 k = 0; k < keyCount; ++k)
+            {
+                const quint16 output = layout.u16(table + 2 * k);
+                const quint16 kind = output & QxtLayoutOutputKindMask;
+                quint16 ch;
+                if (kind == QxtLayoutOutputStateIndex)
+                {
+                    const quint32 state = output & QxtLayoutOutputIndexMask;
+                    if (state >= stateCount)
+                        continue;
+                    ch = layout.u16(layout.u32(stateIndex + 4 + 4 * state));
+                }
+                else if (kind == 0 || (kind == QxtLayoutOutputKindMask && output < 0xfffe))
+                {
+                    ch = output;
+                }
+                else
+                {
+                    // A sequence of several characters, or no output at
+                    // all (0xfffe, 0xffff).
+                    continue;
+                }
+                if (ch && !keycodes.contains(ch))
+                    keycodes.insert(ch, int(k));
+            }
+        }
+    }
+    return true;
+}
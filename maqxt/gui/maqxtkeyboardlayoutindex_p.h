@@ -0,0 +1,56 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTKEYBOARDLAYOUTINDEX_P_H
+#define MAQXTKEYBOARDLAYOUTINDEX_P_H
+
+#include <QtGlobal>
+#include <QHash>
+
+// Reverse index of a Mac OS X 'uchr' keyboard layout (the UCKeyboardLayout
+// blob of kTISPropertyUnicodeKeyLayoutData): the virtual keycode producing
+// each character. The blob is parsed by hand in a single pass, without
+// Carbon, so the index builds on any platform; every offset is checked
+// against the blob's size. Where several keys produce a character, the one
+// found first wins, in the order keyboard types, modifier tables, keys.
+class MAQxtKeyboardLayoutIndex
+{
+public:
+    MAQxtKeyboardLayoutIndex();
+
+    // Replaces the index; false if 'data' is no layout this understands.
+    bool build(const uchar* data, int size);
+    void clear();
+
+    inline bool isEmpty() const { return keycodes.isEmpty(); }
+    inline int size() const { return keycodes.size(); }
+
+    // The virtual keycode producing 'ch', or -1.
+    inline int keycode(quint16 ch) const { return keycodes.value(ch, -1); }
+
+private:
+    QHash<quint16, int> keycodes;
+};
+
+#endif // MAQXTKEYBOARDLAYOUTINDEX_P_H
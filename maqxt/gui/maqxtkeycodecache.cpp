@@ -0,0 +1,239 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxtkeycodecache_p.h"
+#include <QMap>
+#include <QtDebug>
+#include <string.h>
+#if QT_VERSION >= 0x050000
+#include <QSaveFile>
+#elif defined(Q_OS_WIN)
+#include <qt_windows.h>
+#else
+#include <stdio.h>
+#endif
+
+static const char qxt_keycode_cache_magic[] = { 'M', 'Q', 'X', 'T', 'K', 'M', 'A', 'P' };
+static const quint16 qxt_keycode_cache_version = 1;
+
+static inline quint32 qxt_keycode_cache_get32(const uchar* data)
+{
+    return quint32(data[0]) | (quint32(data[1]) << 8) | (quint32(data[2]) << 16) | (quint32(data[3]) << 24);
+}
+
+static inline void qxt_keycode_cache_put32(char* data, quint32 value)
+{
+    data[0] = char(value);
+    data[1] = char(value >> 8);
+    data[2] = char(value >> 16);
+    data[3] = char(value >> 24);
+}
+
+#if QT_VERSION < 0x050000
+// Moves 'from' over 'to' in one step, so that readers find either file
+// complete; Qt 4 has no QSaveFile.
+static bool qxt_keycode_cache_replace(const QString& from, const QString& to)
+{
+#if defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(from.utf16()), reinterpret_cast<const wchar_t*>(to.utf16()), MOVEFILE_REPLACE_EXISTING);
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+#endif
+
+MAQxtKeycodeCache::MAQxtKeycodeCache() : currentFingerprint(0), entries(0), count(0)
+{
+}
+
+MAQxtKeycodeCache::~MAQxtKeycodeCache()
+{
+    unmap();
+}
+
+quint64 MAQxtKeycodeCache::fingerprint(quint64 hash, const void* data, int size)
+{
+    const uchar* bytes = static_cast<const uchar*>(data);
+    for (int i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= Q_UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+bool MAQxtKeycodeCache::open(const QString& fileName, quint64 fingerprint)
+{
+    close();
+    this->fileName = fileName;
+    currentFingerprint = fingerprint;
+    if (fileName.isEmpty() || !fingerprint)
+        return false;
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const qint64 size = file.size();
+    const uchar* data = size >= HeaderSize ? file.map(0, size) : 0;
+    if (!data || memcmp(data, qxt_keycode_cache_magic, sizeof(qxt_keycode_cache_magic))
+        || (data[8] | (data[9] << 8)) != qxt_keycode_cache_version)
+    {
+        if (data)
+            qWarning() << "MAQxtGlobalShortcut: ignoring" << fileName << ", not a keycode cache of this version";
+        unmap();
+        return false;
+    }
+    const quint32 entryCount = qxt_keycode_cache_get32(data + 12);
+    const quint64 fileFingerprint = qxt_keycode_cache_get32(data + 16) | (quint64(qxt_keycode_cache_get32(data + 20)) << 32);
+    // A stale cache is not an error, it is rewritten by save().
+    if (fileFingerprint != fingerprint || entryCount > quint32((size - HeaderSize) / EntrySize))
+    {
+        unmap();
+        return false;
+    }
+    entries = data + HeaderSize;
+    count = int(entryCount);
+    return true;
+}
+
+void MAQxtKeycodeCache::close()
+{
+    if (!added.isEmpty())
+        save();
+    unmap();
+    added.clear();
+    fileName.clear();
+}
+
+void MAQxtKeycodeCache::unmap()
+{
+    // Closing the file unmaps it.
+    file.close();
+    entries = 0;
+    count = 0;
+}
+
+bool MAQxtKeycodeCache::find(int id, quint32& native) const
+{
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        const int middle = (low + high) / 2;
+        const quint32 entry = qxt_keycode_cache_get32(entries + middle * EntrySize);
+        if (entry == quint32(id))
+        {
+            native = qxt_keycode_cache_get32(entries + middle * EntrySize + 4);
+            return true;
+        }
+        if (entry < quint32(id))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    QHash<int, quint32>::const_iterator it = added.constFind(id);
+    if (it == added.constEnd())
+        return false;
+    native = it.value();
+    return true;
+}
+
+void MAQxtKeycodeCache::insert(int id, quint32 native)
+{
+    if (isOpen() && currentFingerprint)
+        added.insert(id, native);
+}
+
+void MAQxtKeycodeCache::reset(quint64 fingerprint)
+{
+    unmap();
+    added.clear();
+    currentFingerprint = fingerprint;
+}
+
+bool MAQxtKeycodeCache::save()
+{
+    if (!isOpen() || !currentFingerprint)
+        return false;
+    QMap<quint32, quint32> sorted;
+    for (int i = 0; i < count; ++i)
+        sorted.insert(qxt_keycode_cache_get32(entries + i * EntrySize), qxt_keycode_cache_get32(entries + i * EntrySize + 4));
+    for (QHash<int, quint32>::const_iterator it = added.constBegin(); it != added.constEnd(); ++it)
+        sorted.insert(quint32(it.key()), it.value());
+
+    QByteArray data(HeaderSize + sorted.size() * EntrySize, 0);
+    char* out = data.data();
+    memcpy(out, qxt_keycode_cache_magic, sizeof(qxt_keycode_cache_magic));
+    out[8] = char(qxt_keycode_cache_version);
+    out[9] = char(qxt_keycode_cache_version >> 8);
+    qxt_keycode_cache_put32(out + 12, quint32(sorted.size()));
+    qxt_keycode_cache_put32(out + 16, quint32(currentFingerprint));
+    qxt_keycode_cache_put32(out + 20, quint32(currentFingerprint >> 32));
+    out += HeaderSize;
+    for (QMap<quint32, quint32>::const_iterator it = sorted.constBegin(); it != sorted.constEnd(); ++it, out += EntrySize)
+    {
+        qxt_keycode_cache_put32(out, it.key());
+        qxt_keycode_cache_put32(out + 4, it.value());
+    }
+
+    // Write a new file and move it over the old one, which other processes
+    // may have mapped or be reading.
+#if QT_VERSION >= 0x050000
+    QSaveFile temporary(fileName);
+#else
+    const QString temporaryName = fileName + QLatin1String(".new");
+    QFile temporary(temporaryName);
+#endif
+    if (!temporary.open(QIODevice::WriteOnly | QIODevice::Truncate) || temporary.write(data) != data.size())
+    {
+        qWarning() << "MAQxtGlobalShortcut failed to write the keycode cache" << temporary.fileName();
+#if QT_VERSION < 0x050000
+        temporary.remove();
+#endif
+        return false;
+    }
+    // Keep the keycodes at hand in 'added' until the new file is mapped.
+    unmap();
+    added.clear();
+    for (QMap<quint32, quint32>::const_iterator it = sorted.constBegin(); it != sorted.constEnd(); ++it)
+        added.insert(int(it.key()), it.value());
+#if QT_VERSION >= 0x050000
+    const bool replaced = temporary.commit();
+#else
+    temporary.close();
+    const bool replaced = qxt_keycode_cache_replace(temporaryName, fileName);
+    if (!replaced)
+        QFile::remove(temporaryName);
+#endif
+    if (!replaced)
+    {
+        qWarning() << "MAQxtGlobalShortcut failed to replace the keycode cache" << fileName;
+        return false;
+    }
+    added.clear();
+    // open() starts by clearing the members these are kept in.
+    const QString name = fileName;
+    const quint64 fingerprint = currentFingerprint;
+    return open(name, fingerprint);
+}
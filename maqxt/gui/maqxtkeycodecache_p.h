@@ -0,0 +1,84 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTKEYCODECACHE_P_H
+#define MAQXTKEYCODECACHE_P_H
+
+#include <QtGlobal>
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+// Native keycodes resolved in an earlier run, read from a file that is
+// memory-mapped rather than parsed. The file belongs to one keyboard
+// mapping, identified by a fingerprint the backend computes; a file of
+// another mapping is ignored and replaced on save(). Lookups binary-search
+// the mapped entries. Layout, all little-endian:
+//
+//   0  "MQXTKMAP"
+//   8  u16 version, u16 reserved
+//   12 u32 number of entries
+//   16 u64 fingerprint
+//   24 entries of u32 id, u32 native keycode, sorted by id
+class MAQxtKeycodeCache
+{
+public:
+    enum { HeaderSize = 24, EntrySize = 8 };
+
+    MAQxtKeycodeCache();
+    ~MAQxtKeycodeCache();
+
+    // Uses 'fileName', mapping it if it holds keycodes for 'fingerprint';
+    // false if it does not. An empty name turns the cache off.
+    bool open(const QString& fileName, quint64 fingerprint);
+    // Writes the file if keycodes were added, then turns the cache off.
+    void close();
+    inline bool isOpen() const { return !fileName.isEmpty(); }
+    inline QString name() const { return fileName; }
+
+    bool find(int id, quint32& native) const;
+    void insert(int id, quint32 native);
+    // Forgets all keycodes after a mapping change; 'fingerprint' is the
+    // new mapping's.
+    void reset(quint64 fingerprint);
+    bool save();
+
+    // 64-bit FNV-1a, for backends to compute fingerprints with.
+    static const quint64 FingerprintBasis = Q_UINT64_C(0xcbf29ce484222325);
+    static quint64 fingerprint(quint64 hash, const void* data, int size);
+
+private:
+    Q_DISABLE_COPY(MAQxtKeycodeCache)
+
+    void unmap();
+
+    QString fileName;
+    quint64 currentFingerprint;
+    QFile file;
+    const uchar* entries; // mapped, or 0
+    int count;
+    QHash<int, quint32> added; // resolved since, not in the file yet
+};
+
+#endif // MAQXTKEYCODECACHE_P_H
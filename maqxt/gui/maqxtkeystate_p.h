@@ -0,0 +1,98 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTKEYSTATE_P_H
+#define MAQXTKEYSTATE_P_H
+
+#include "maqxtspscring_p.h"
+#include <QtGlobal>
+#include <QAtomicInt>
+
+// Which native keycodes are held down and which native modifiers are in
+// effect, as last observed by a backend. Reads are a single atomic load and
+// may happen on any thread; writes must come from one thread at a time.
+// Keycodes from KeyCount up are never reported as held.
+class MAQxtKeyState
+{
+public:
+    enum { KeyCount = 256 };
+
+    MAQxtKeyState() {}
+
+    // Reader side.
+    inline bool isPressed(quint32 keycode) const
+    {
+        if (keycode >= quint32(KeyCount))
+            return false;
+        return quint32(qxt_atomic_load_acquire(words[keycode >> 5])) & (1u << (keycode & 31));
+    }
+
+    inline quint32 modifiers() const
+    {
+        return quint32(qxt_atomic_load_acquire(modifierState));
+    }
+
+    // Writer side.
+    void setPressed(quint32 keycode, bool pressed)
+    {
+        if (keycode >= quint32(KeyCount))
+            return;
+        QAtomicInt& word = words[keycode >> 5];
+        const quint32 bit = 1u << (keycode & 31);
+        const quint32 value = quint32(qxt_atomic_load_relaxed(word));
+        qxt_atomic_store_release(word, int(pressed ? value | bit : value & ~bit));
+    }
+
+    void setModifiers(quint32 nativeMods)
+    {
+        qxt_atomic_store_release(modifierState, int(nativeMods));
+    }
+
+    // Replaces the whole state; 'keys' holds KeyCount bits, lowest keycode
+    // first, as XQueryKeymap() and EVIOCGKEY report them.
+    void reset(const quint8* keys, quint32 nativeMods)
+    {
+        for (int i = 0; i < KeyCount / 32; ++i)
+        {
+            const quint8* bytes = keys + 4 * i;
+            qxt_atomic_store_release(words[i], int(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | quint32(bytes[3]) << 24));
+        }
+        setModifiers(nativeMods);
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < KeyCount / 32; ++i)
+            qxt_atomic_store_release(words[i], 0);
+        setModifiers(0);
+    }
+
+private:
+    Q_DISABLE_COPY(MAQxtKeyState)
+
+    mutable QAtomicInt words[KeyCount / 32];
+    mutable QAtomicInt modifierState;
+};
+
+#endif // MAQXTKEYSTATE_P_H
@@ -0,0 +1,83 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTOBJECTPOOL_P_H
+#define MAQXTOBJECTPOOL_P_H
+
+#include <QtGlobal>
+#include <new>
+#include <stdlib.h>
+
+// Free list allocator for objects of type T, for use in class specific
+// operator new and delete. Memory is carved from chunks of ChunkSize
+// objects and recycled, never returned, so that creating and destroying
+// objects in bulk does not reach the system allocator. Not thread-safe;
+// allocate() throws std::bad_alloc when out of memory, like operator new.
+// Instances must have static storage duration: the pool relies on zero
+// initialization, and has no constructor so that objects can be allocated
+// before dynamic initialization has reached it. The same goes for whatever
+// lock guards it.
+template <typename T, int ChunkSize = 64>
+class MAQxtObjectPool
+{
+public:
+    inline void* allocate()
+    {
+        if (!freeList)
+            grow();
+        Node* node = freeList;
+        freeList = node->next;
+        return node;
+    }
+
+    inline void release(void* pointer)
+    {
+        Node* node = static_cast<Node*>(pointer);
+        node->next = freeList;
+        freeList = node;
+    }
+
+private:
+    union Node
+    {
+        Node* next;
+        char data[sizeof(T)];
+        void* pointer;
+        double real;
+        qint64 integer;
+    };
+
+    void grow()
+    {
+        Node* chunk = static_cast<Node*>(::malloc(ChunkSize * sizeof(Node)));
+        if (!chunk)
+            throw std::bad_alloc();
+        for (int i = ChunkSize - 1; i >= 0; --i)
+            release(&chunk[i]);
+    }
+
+    Node* freeList;
+};
+
+#endif // MAQXTOBJECTPOOL_P_H
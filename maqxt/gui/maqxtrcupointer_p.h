@@ -0,0 +1,168 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTRCUPOINTER_P_H
+#define MAQXTRCUPOINTER_P_H
+
+#include "maqxtspscring_p.h"
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QThread>
+#include <QVector>
+
+// Pointer to an immutable object that readers use without taking a lock
+// while writers replace it wholesale, RCU style. Writers must be
+// serialized by a mutex of their own.
+//
+// A reader announces the object it uses in a hazard slot picked from its
+// thread id; the slots are a cache line apart, so readers on different
+// threads never write to a shared line. A replaced object is retired and
+// deleted as soon as no slot holds it, by the writer replacing it or by
+// the reader leaving it last, so at most one retired object per slot is
+// kept however busy the readers are.
+template <typename T>
+class MAQxtRcuPointer
+{
+public:
+    enum { Slots = 32 };
+
+    // Read section: data() stays valid until leave() or the end of the
+    // reader's scope.
+    class Reader
+    {
+    public:
+        inline explicit Reader(MAQxtRcuPointer& pointer) : pointer(pointer), slot(0), object(pointer.acquire(slot)) {}
+        inline ~Reader() { leave(); }
+        inline const T* data() const { return object; }
+
+        // Ends the read section early.
+        inline void leave()
+        {
+            if (object)
+                pointer.release(slot);
+            object = 0;
+        }
+
+    private:
+        Q_DISABLE_COPY(Reader)
+
+        MAQxtRcuPointer& pointer;
+        int slot;
+        const T* object;
+    };
+
+    MAQxtRcuPointer() : current(0), retiredCount(0), reclaiming(0) {}
+
+    ~MAQxtRcuPointer()
+    {
+        delete qxt_atomic_load_consume(current);
+        qDeleteAll(retired);
+    }
+
+    // Writer side.
+    inline const T* data() { return qxt_atomic_load_consume(current); }
+
+    void publish(T* object)
+    {
+        // The exchange is a full barrier: a reader whose announcement is
+        // not seen below sees 'object' when it checks.
+        T* previous = current.fetchAndStoreOrdered(object);
+        while (!reclaiming.testAndSetAcquire(0, 1))
+            QThread::yieldCurrentThread();
+        if (previous)
+            retired.append(previous);
+        collect();
+    }
+
+private:
+    Q_DISABLE_COPY(MAQxtRcuPointer)
+
+    struct Slot
+    {
+        QAtomicPointer<T> hazard;
+        char padding[64 - sizeof(QAtomicPointer<T>)];
+    };
+
+    T* acquire(int& index)
+    {
+        T* object = qxt_atomic_load_consume(current);
+        if (!object)
+            return 0;
+        // Fibonacci hashing of the thread id; threads sharing a start slot
+        // move on to the next free one.
+        index = int((quint64(quintptr(QThread::currentThreadId())) * Q_UINT64_C(0x9e3779b97f4a7c15)) >> 59);
+        while (!hazards[index].hazard.testAndSetOrdered(0, object))
+            index = (index + 1) & (Slots - 1);
+        // The object may have been replaced before it was announced; the
+        // ordered claim keeps this check from being read ahead of it.
+        for (;;)
+        {
+            T* latest = qxt_atomic_load_consume(current);
+            if (latest == object)
+                return object;
+            if (!latest)
+            {
+                release(index);
+                return 0;
+            }
+            object = latest;
+            hazards[index].hazard.fetchAndStoreOrdered(object);
+        }
+    }
+
+    void release(int index)
+    {
+        qxt_atomic_store_release(hazards[index].hazard, static_cast<T*>(0));
+        if (qxt_atomic_load_relaxed(retiredCount) && reclaiming.testAndSetAcquire(0, 1))
+            collect();
+    }
+
+    // Deletes the retired objects no slot holds; called with 'reclaiming'
+    // taken, and gives it back.
+    void collect()
+    {
+        for (int i = retired.size() - 1; i >= 0; --i)
+        {
+            bool held = false;
+            for (int j = 0; j < Slots && !held; ++j)
+                held = qxt_atomic_load_consume(hazards[j].hazard) == retired.at(i);
+            if (!held)
+            {
+                delete retired.at(i);
+                retired.remove(i);
+            }
+        }
+        qxt_atomic_store_release(retiredCount, retired.size());
+        qxt_atomic_store_release(reclaiming, 0);
+    }
+
+    QAtomicPointer<T> current;
+    Slot hazards[Slots];
+    QAtomicInt retiredCount;
+    QAtomicInt reclaiming;   // guards 'retired'
+    QVector<T*> retired;     // replaced, possibly still read
+};
+
+#endif // MAQXTRCUPOINTER_P_H
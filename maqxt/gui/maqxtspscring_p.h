@@ -0,0 +1,135 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTSPSCRING_P_H
+#define MAQXTSPSCRING_P_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+
+// Plain and acquire loads and release stores on top of the Qt 4, Qt 5 and
+// Qt 6 QAtomicInt and QAtomicPointer API.
+inline int qxt_atomic_load_relaxed(const QAtomicInt& value)
+{
+#if QT_VERSION >= 0x060000
+    return value.loadRelaxed();
+#elif QT_VERSION >= 0x050000
+    return value.load();
+#else
+    return value;
+#endif
+}
+
+inline int qxt_atomic_load_acquire(QAtomicInt& value)
+{
+#if QT_VERSION >= 0x050000
+    return value.loadAcquire();
+#else
+    return value.fetchAndAddAcquire(0);
+#endif
+}
+
+template <typename T>
+inline T* qxt_atomic_load_acquire(QAtomicPointer<T>& value)
+{
+#if QT_VERSION >= 0x050000
+    return value.loadAcquire();
+#else
+    return value.fetchAndAddAcquire(0);
+#endif
+}
+
+inline void qxt_atomic_store_release(QAtomicInt& value, int newValue)
+{
+#if QT_VERSION >= 0x050000
+    value.storeRelease(newValue);
+#else
+    value.fetchAndStoreRelease(newValue);
+#endif
+}
+
+template <typename T>
+inline void qxt_atomic_store_release(QAtomicPointer<T>& value, T* newValue)
+{
+#if QT_VERSION >= 0x050000
+    value.storeRelease(newValue);
+#else
+    value.fetchAndStoreRelease(newValue);
+#endif
+}
+
+// Load whose result is only dereferenced: Qt 4 has no acquire load short
+// of a read-modify-write, and every platform it supports orders reads
+// through the loaded pointer anyway.
+template <typename T>
+inline T* qxt_atomic_load_consume(QAtomicPointer<T>& value)
+{
+#if QT_VERSION >= 0x050000
+    return value.loadAcquire();
+#else
+    return value;
+#endif
+}
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Size must be a power of two; push() fails when the ring is full. The
+// positions run modulo 2 * Size, which tells a full ring from an empty one.
+template <typename T, int Size>
+class MAQxtSpscRing
+{
+public:
+    MAQxtSpscRing() : head(0), tail(0) {}
+
+    // Producer side.
+    bool push(const T& item)
+    {
+        const int t = qxt_atomic_load_relaxed(tail);
+        if (((t - qxt_atomic_load_acquire(head)) & (2 * Size - 1)) == Size)
+            return false;
+        items[t & (Size - 1)] = item;
+        qxt_atomic_store_release(tail, (t + 1) & (2 * Size - 1));
+        return true;
+    }
+
+    // Consumer side.
+    bool pop(T& item)
+    {
+        const int h = qxt_atomic_load_relaxed(head);
+        if (h == qxt_atomic_load_acquire(tail))
+            return false;
+        item = items[h & (Size - 1)];
+        qxt_atomic_store_release(head, (h + 1) & (2 * Size - 1));
+        return true;
+    }
+
+private:
+    Q_DISABLE_COPY(MAQxtSpscRing)
+
+    T items[Size];
+    QAtomicInt head; // only written by the consumer
+    QAtomicInt tail; // only written by the producer
+};
+
+#endif // MAQXTSPSCRING_P_H
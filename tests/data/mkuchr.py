@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Writes the 'uchr' keyboard layouts tst_maqxtkeyboardlayoutindex reads.
+# They are assembled to the UCKeyboardLayout format of UnicodeUtilities.h,
+# in little-endian byte order, and hold just enough of a layout for the
+# test; they are not copies of the layouts Mac OS X ships.
+import struct
+import sys
+
+KEYS = 128
+
+def table(chars):
+    keys = [0xffff] * KEYS
+    for key, ch in chars.items():
+        keys[key] = ch if isinstance(ch, int) else ord(ch)
+    return struct.pack('<%dH' % KEYS, *keys)
+
+class Blob:
+    def __init__(self):
+        self.data = bytearray()
+
+    def append(self, chunk):
+        while len(self.data) % 4:
+            self.data.append(0)
+        offset = len(self.data)
+        self.data += chunk
+        return offset
+
+def layout(types, states=None):
+    # types: [(first, last, [table dicts])]
+    header = 12 + 28 * len(types)
+    blob = Blob()
+    blob.data = bytearray(header)
+    struct.pack_into('<HHII', blob.data, 0, 0x1002, 0, 0, len(types))
+    modifiers = blob.append(struct.pack('<HHI4B', 0x2000, 0, 4, 0, 1, 2, 1))
+    records = 0
+    if states:
+        offsets = [blob.append(struct.pack('<HHHH', ch, next_state, 0, 0)) for ch, next_state in states]
+        records = blob.append(struct.pack('<HH%dI' % len(offsets), 0x4000, len(offsets), *offsets))
+    for i, (first, last, tables) in enumerate(types):
+        offsets = [blob.append(table(t)) for t in tables]
+        index = blob.append(struct.pack('<HHI%dI' % len(offsets), 0x3000, KEYS, len(offsets), *offsets))
+        struct.pack_into('<7I', blob.data, 12 + 28 * i, first, last, modifiers, index, records, 0, 0)
+    return bytes(blob.data)
+
+US_KEYS = 'asdfhgzxcv\0bqweryt123465=97-80]ou[ip\rlj\'k;\\,/nm.\t `'
+US_SHIFTED = 'ASDFHGZXCV\0BQWERYT!@#$^%+(&_*)}OU{IP\rLJ"K:|<?NM>\t ~'
+
+def us():
+    unshifted = dict((k, c) for k, c in enumerate(US_KEYS) if c != '\0')
+    unshifted[51] = 0x08
+    unshifted[53] = 0x1b
+    shifted = dict((k, c) for k, c in enumerate(US_SHIFTED) if c != '\0')
+    option = {0: 0xe5, 1: 0xdf, 8: 0xe7, 35: 0x3c0}
+    # An ISO keyboard: the key left of 1 (10) types a section sign, and
+    # its keys repeat those of the ANSI type, which come first.
+    iso = {10: 0xa7, 0: 'a', 50: '<', 6: 'y', 16: 'z'}
+    return layout([(0, 0, [unshifted, shifted, option]), (1, 1, [iso])])
+
+def deadkeys():
+    keys = {
+        0: 'a',
+        14: 0x4000 | 0,  # 'e', through a state record
+        32: 0x4000 | 1,  # a dead key, no character from the base state
+        2: 0x4000 | 5,   # a state record past the end of the list
+        3: 0x8000 | 0,   # a sequence of characters
+        4: 0xfffe,
+        5: 0xffff,
+        122: 0xf704,     # F1, in the 0xc000 range of direct characters
+        7: 'x'
+    }
+    return layout([(0, 0, [keys])], [(ord('e'), 0), (0, 1)])
+
+for name, blob in (('us.uchr', us()), ('deadkeys.uchr', deadkeys())):
+    with open(sys.argv[1] + '/' + name if len(sys.argv) > 1 else name, 'wb') as f:
+        f.write(blob)
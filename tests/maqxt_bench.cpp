@@ -0,0 +1,338 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxt/gui/maqxtglobalshortcut.h"
+#include "maqxt/gui/maqxtglobalshortcutbatch.h"
+#include <QApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <algorithm>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "maqxttest_x11.h"
+
+Q_DECLARE_METATYPE(MAQxtTestDisplay::EventKind)
+
+// Registers the first 'count' shortcuts of qxt_test_sequences() at once.
+class MAQxtBenchShortcuts
+{
+public:
+    explicit MAQxtBenchShortcuts(int count)
+    {
+        const QList<QKeySequence> sequences = qxt_test_sequences(count);
+        MAQxtGlobalShortcutBatch batch;
+        for (int i = 0; i < count; ++i)
+        {
+            shortcuts.append(new MAQxtGlobalShortcut);
+            batch.setShortcut(shortcuts.last(), sequences.at(i));
+        }
+        ok = batch.apply();
+    }
+
+    ~MAQxtBenchShortcuts()
+    {
+        qDeleteAll(shortcuts);
+    }
+
+    QList<MAQxtGlobalShortcut*> shortcuts;
+    bool ok;
+
+private:
+    Q_DISABLE_COPY(MAQxtBenchShortcuts)
+};
+
+// Times XTest injections until the activated() they cause.
+class MAQxtLatencyProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    QElapsedTimer timer;
+    qint64 latency;
+    QEventLoop loop;
+
+public Q_SLOTS:
+    void activated()
+    {
+        latency = timer.nsecsElapsed();
+    }
+
+    void released()
+    {
+        loop.quit();
+    }
+};
+
+class MAQxtBench : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void registration_data();
+    void registration();
+    void latency_data();
+    void latency();
+    void filterOverhead_data();
+    void filterOverhead();
+    void churn_data();
+    void churn();
+
+private:
+    MAQxtTestDisplay x;
+};
+
+static void qxt_bench_sizes()
+{
+    QTest::addColumn<int>("size");
+    const int sizes[] = { 10, 100, 1000 };
+    for (int i = 0; i < 3; ++i)
+        QTest::newRow(QByteArray::number(sizes[i]).constData()) << sizes[i];
+}
+
+void MAQxtBench::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server with the XTEST extension");
+    int event, error, major, minor;
+    QVERIFY(XTestQueryExtension(x.display, &event, &error, &major, &minor));
+}
+
+void MAQxtBench::registration_data()
+{
+    QTest::addColumn<bool>("batched");
+    QTest::addColumn<int>("size");
+    const int sizes[] = { 10, 100, 1000 };
+    for (int i = 0; i < 3; ++i)
+    {
+        QTest::newRow(QByteArray("batch, ").append(QByteArray::number(sizes[i])).constData()) << true << sizes[i];
+        QTest::newRow(QByteArray("one by one, ").append(QByteArray::number(sizes[i])).constData()) << false << sizes[i];
+    }
+}
+
+// Registering and unregistering 'size' shortcuts, through a batch or with
+// setShortcut() on each.
+void MAQxtBench::registration()
+{
+    QFETCH(bool, batched);
+    QFETCH(int, size);
+    const QList<QKeySequence> sequences = qxt_test_sequences(size);
+    QList<MAQxtGlobalShortcut*> shortcuts;
+    for (int i = 0; i < size; ++i)
+        shortcuts.append(new MAQxtGlobalShortcut);
+    bool ok = true;
+    QBENCHMARK
+    {
+        if (batched)
+        {
+            MAQxtGlobalShortcutBatch set;
+            MAQxtGlobalShortcutBatch unset;
+            for (int i = 0; i < size; ++i)
+            {
+                set.setShortcut(shortcuts.at(i), sequences.at(i));
+                unset.unsetShortcut(shortcuts.at(i));
+            }
+            ok &= set.apply();
+            ok &= unset.apply();
+        }
+        else
+        {
+            for (int i = 0; i < size; ++i)
+                ok &= shortcuts.at(i)->setShortcut(sequences.at(i));
+            for (int i = 0; i < size; ++i)
+                shortcuts.at(i)->setShortcut(QKeySequence());
+        }
+    }
+    qDeleteAll(shortcuts);
+    QVERIFY(ok);
+}
+
+void MAQxtBench::latency_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("percentile");
+    const int sizes[] = { 10, 100, 1000 };
+    for (int i = 0; i < 3; ++i)
+    {
+        QTest::newRow(QByteArray("p50, ").append(QByteArray::number(sizes[i])).constData()) << sizes[i] << 50;
+        QTest::newRow(QByteArray("p99, ").append(QByteArray::number(sizes[i])).constData()) << sizes[i] << 99;
+    }
+}
+
+// Milliseconds from an XTest press of Ctrl+Alt+A, the first of the
+// shortcuts, to its activated() in the event loop, over 200 presses.
+void MAQxtBench::latency()
+{
+    QFETCH(int, size);
+    QFETCH(int, percentile);
+    MAQxtBenchShortcuts registered(size);
+    QVERIFY(registered.ok);
+    MAQxtLatencyProbe probe;
+    QObject::connect(registered.shortcuts.first(), SIGNAL(activated()), &probe, SLOT(activated()));
+    QObject::connect(registered.shortcuts.first(), SIGNAL(released(int)), &probe, SLOT(released()));
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, SIGNAL(timeout()), &probe.loop, SLOT(quit()));
+
+    const int keycode = XKeysymToKeycode(x.display, XK_a);
+    const QVector<KeySym> modifiers = QVector<KeySym>() << XK_Control_L << XK_Alt_L;
+    QVector<qint64> latencies;
+    for (int i = 0; i < 200; ++i)
+    {
+        probe.latency = -1;
+        timeout.start(2000);
+        probe.timer.start();
+        x.tap(keycode, modifiers);
+        probe.loop.exec();
+        QVERIFY(probe.latency >= 0);
+        latencies.append(probe.latency);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    QTest::setBenchmarkResult(latencies.at(latencies.size() * percentile / 100) / 1e6, QTest::WalltimeMilliseconds);
+}
+
+void MAQxtBench::filterOverhead_data()
+{
+    QTest::addColumn<MAQxtTestDisplay::EventKind>("kind");
+    QTest::addColumn<int>("size");
+    const int sizes[] = { 0, 10, 100, 1000 };
+    for (int i = 0; i < 4; ++i)
+    {
+        QTest::newRow(QByteArray("motion, ").append(QByteArray::number(sizes[i])).constData()) << MAQxtTestDisplay::MotionEvent << sizes[i];
+        QTest::newRow(QByteArray("unbound key, ").append(QByteArray::number(sizes[i])).constData()) << MAQxtTestDisplay::KeyPressEvent << sizes[i];
+    }
+}
+
+// 1000 native events through the event dispatcher's filters; with no
+// shortcuts the filter is not installed. Key presses are of the pause key
+// with Ctrl+Alt, which none of the shortcuts uses.
+void MAQxtBench::filterOverhead()
+{
+    QFETCH(MAQxtTestDisplay::EventKind, kind);
+    QFETCH(int, size);
+    MAQxtBenchShortcuts registered(size);
+    QVERIFY(registered.ok);
+    QVector<MAQxtTestEvent> events = x.events(kind, 1000, XKeysymToKeycode(x.display, XK_Pause), ControlMask | Mod1Mask);
+    int filtered = 0;
+    QBENCHMARK
+    {
+        filtered += MAQxtTestDisplay::filter(events);
+    }
+    QCOMPARE(filtered, 0);
+}
+
+void MAQxtBench::churn_data()
+{
+    qxt_bench_sizes();
+}
+
+// Moving one shortcut back and forth between two unused key combinations
+// while 'size' others are registered: an ungrab and a grab each time.
+void MAQxtBench::churn()
+{
+    QFETCH(int, size);
+    MAQxtBenchShortcuts registered(size);
+    QVERIFY(registered.ok);
+    const QList<QKeySequence> sequences = qxt_test_sequences(size + 2);
+    MAQxtGlobalShortcut shortcut;
+    bool ok = true;
+    QBENCHMARK
+    {
+        ok &= shortcut.setShortcut(sequences.at(size));
+        ok &= shortcut.setShortcut(sequences.at(size + 1));
+    }
+    QVERIFY(ok);
+}
+
+// Starts Xvfb on a free display and points DISPLAY at it; returns its
+// process id, or 0 if it could not be started.
+static pid_t qxt_bench_start_xvfb()
+{
+    int fds[2];
+    if (pipe(fds))
+        return 0;
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        char fd[16];
+        snprintf(fd, sizeof(fd), "%d", fds[1]);
+        execlp("Xvfb", "Xvfb", "-displayfd", fd, "-nolisten", "tcp", "-screen", "0", "1024x768x24", (char*) 0);
+        _exit(127);
+    }
+    close(fds[1]);
+    // Xvfb writes the display number once it accepts connections.
+    char display[16] = ":";
+    int length = 1;
+    char c;
+    while (pid > 0 && length < int(sizeof(display)) - 1 && read(fds[0], &c, 1) == 1 && c != '\n')
+        display[length++] = c;
+    close(fds[0]);
+    if (pid > 0 && length == 1)
+    {
+        kill(pid, SIGTERM);
+        waitpid(pid, 0, 0);
+    }
+    if (pid <= 0 || length == 1)
+        return 0;
+    display[length] = 0;
+    setenv("DISPLAY", display, 1);
+    return pid;
+}
+
+// Runs against a private Xvfb unless DISPLAY names a server. Results come
+// in QtTest's formats, e.g. -csv or -xml.
+int main(int argc, char** argv)
+{
+    pid_t xvfb = 0;
+    if (qgetenv("DISPLAY").isEmpty())
+    {
+        xvfb = qxt_bench_start_xvfb();
+        if (!xvfb)
+        {
+            fprintf(stderr, "maqxt_bench: could not start Xvfb\n");
+            return 1;
+        }
+    }
+#if QT_VERSION >= 0x050000
+    qputenv("QT_QPA_PLATFORM", "xcb");
+#endif
+    int res;
+    {
+        QApplication application(argc, argv);
+        MAQxtBench bench;
+        res = QTest::qExec(&bench, argc, argv);
+    }
+    if (xvfb)
+    {
+        kill(xvfb, SIGTERM);
+        waitpid(xvfb, 0, 0);
+    }
+    return res;
+}
+
+#include "maqxt_bench.moc"
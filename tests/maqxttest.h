@@ -0,0 +1,95 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTTEST_H
+#define MAQXTTEST_H
+
+#include <QElapsedTimer>
+#include <QKeySequence>
+#include <QList>
+#include <QSignalSpy>
+#include <QtTest>
+
+// Spins the event loop until 'spy' has caught 'count' signals, or for at
+// most 'timeout' milliseconds. QSignalSpy::wait() needs Qt 5.
+inline bool qxt_test_wait(QSignalSpy& spy, int count, int timeout = 2000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (spy.count() < count && timer.elapsed() < timeout)
+        QTest::qWait(5);
+    return spy.count() >= count;
+}
+
+// 'count' distinct shortcuts, up to 1104: 69 keys of a US keyboard under
+// each combination of Shift, Control, Alt and Meta, starting with
+// Ctrl+Alt+A, Ctrl+Alt+B...
+inline QList<QKeySequence> qxt_test_sequences(int count)
+{
+    static const int keys[] =
+    {
+        Qt::Key_Comma, Qt::Key_Minus, Qt::Key_Period, Qt::Key_Slash, Qt::Key_Semicolon, Qt::Key_Equal,
+        Qt::Key_BracketLeft, Qt::Key_Backslash, Qt::Key_BracketRight, Qt::Key_Apostrophe, Qt::Key_QuoteLeft,
+        Qt::Key_Home, Qt::Key_End, Qt::Key_Left, Qt::Key_Up, Qt::Key_Right, Qt::Key_Down, Qt::Key_PageUp,
+        Qt::Key_PageDown, Qt::Key_Insert, Qt::Key_Delete
+    };
+    static const int modifiers[] =
+    {
+        int(Qt::ControlModifier) | int(Qt::AltModifier),
+        int(Qt::ControlModifier) | int(Qt::AltModifier) | int(Qt::ShiftModifier),
+        int(Qt::AltModifier) | int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::AltModifier) | int(Qt::MetaModifier),
+        int(Qt::ShiftModifier) | int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::ShiftModifier) | int(Qt::MetaModifier),
+        int(Qt::AltModifier) | int(Qt::ShiftModifier) | int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::AltModifier) | int(Qt::ShiftModifier) | int(Qt::MetaModifier),
+        int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::ShiftModifier),
+        int(Qt::AltModifier) | int(Qt::ShiftModifier),
+        int(Qt::ControlModifier),
+        int(Qt::AltModifier),
+        int(Qt::ShiftModifier),
+        0
+    };
+    const int keyCount = 26 + 10 + 12 + int(sizeof(keys) / sizeof(keys[0]));
+    QList<QKeySequence> sequences;
+    for (int i = 0; i < count; ++i)
+    {
+        const int k = i % keyCount;
+        int key;
+        if (k < 26)
+            key = Qt::Key_A + k;
+        else if (k < 36)
+            key = Qt::Key_0 + k - 26;
+        else if (k < 48)
+            key = Qt::Key_F1 + k - 36;
+        else
+            key = keys[k - 48];
+        sequences.append(QKeySequence(modifiers[i / keyCount % 16] | key));
+    }
+    return sequences;
+}
+
+#endif // MAQXTTEST_H
@@ -0,0 +1,78 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTTEST_TRACE_H
+#define MAQXTTEST_TRACE_H
+
+#include "maqxt/gui/maqxtglobalshortcut.h"
+#include "maqxt/gui/maqxtglobalshortcuttrace_p.h"
+#include <QBuffer>
+#include <QByteArray>
+
+// Writes a key event trace with chosen timestamps, for replayTrace(). The
+// test needs maqxtglobalshortcuttrace.cpp among its sources.
+class MAQxtTestTrace
+{
+public:
+    MAQxtTestTrace()
+    {
+        buffer.open(QIODevice::WriteOnly);
+        trace.start(&buffer);
+    }
+
+    MAQxtTestTrace& press(quint32 time, quint32 keycode, quint32 mods)
+    {
+        trace.record(time, keycode, mods, false);
+        return *this;
+    }
+
+    MAQxtTestTrace& release(quint32 time, quint32 keycode, quint32 mods)
+    {
+        trace.record(time, keycode, mods, true);
+        return *this;
+    }
+
+    // Ends the trace and returns it.
+    QByteArray data()
+    {
+        trace.stop();
+        return buffer.data();
+    }
+
+    static int replay(const QByteArray& data, MAQxtGlobalShortcut::ReplaySpeed speed = MAQxtGlobalShortcut::MaximumSpeed)
+    {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        return MAQxtGlobalShortcut::replayTrace(&buffer, speed);
+    }
+
+private:
+    Q_DISABLE_COPY(MAQxtTestTrace)
+
+    QBuffer buffer;
+    MAQxtGlobalShortcutTrace trace;
+};
+
+#endif // MAQXTTEST_TRACE_H
@@ -0,0 +1,223 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#ifndef MAQXTTEST_X11_H
+#define MAQXTTEST_X11_H
+
+#include <QAbstractEventDispatcher>
+#include <QVector>
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <xcb/xcb.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Native events the way the event dispatcher hands them to the filters.
+#if QT_VERSION >= 0x050000
+typedef xcb_generic_event_t MAQxtTestEvent;
+#else
+typedef XEvent MAQxtTestEvent;
+#endif
+
+// Connections of the test's own to the X server, apart from the
+// application's: XTest injects key events through Xlib, and grab probes go
+// through XCB, where they compete with the library's grabs like the
+// requests of any other client would.
+class MAQxtTestDisplay
+{
+public:
+    MAQxtTestDisplay() : display(XOpenDisplay(0)), connection(xcb_connect(0, 0)), root(0)
+    {
+        if (!xcb_connection_has_error(connection))
+            root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+    }
+
+    ~MAQxtTestDisplay()
+    {
+        if (display)
+            XCloseDisplay(display);
+        xcb_disconnect(connection);
+    }
+
+    bool isOpen() const
+    {
+        return display && root;
+    }
+
+    int minKeycode() const
+    {
+        return xcb_get_setup(connection)->min_keycode;
+    }
+
+    int maxKeycode() const
+    {
+        return xcb_get_setup(connection)->max_keycode;
+    }
+
+    // The keycodes grabbed by another client with exactly 'mods': a grab of
+    // ours fails with BadAccess on those. All of them when that client holds
+    // XCB_GRAB_ANY. Every probe that succeeds is released again.
+    QVector<int> grabbedKeycodes(quint16 mods)
+    {
+        QVector<xcb_void_cookie_t> cookies;
+        for (int keycode = minKeycode(); keycode <= maxKeycode(); ++keycode)
+            cookies.append(xcb_grab_key_checked(connection, 1, root, mods, xcb_keycode_t(keycode),
+                                                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC));
+        QVector<int> grabbed;
+        for (int i = 0; i < cookies.size(); ++i)
+        {
+            xcb_generic_error_t* error = xcb_request_check(connection, cookies.at(i));
+            if (error)
+            {
+                grabbed.append(minKeycode() + i);
+                free(error);
+            }
+        }
+        xcb_void_cookie_t ungrab = xcb_ungrab_key_checked(connection, XCB_GRAB_ANY, root, mods);
+        free(xcb_request_check(connection, ungrab));
+        return grabbed;
+    }
+
+    // Grabs 'keycode' with 'mods' through the Xlib connection, as another
+    // application would; the probes of grabbedKeycodes() leave it alone.
+    void grabKey(int keycode, quint16 mods)
+    {
+        XGrabKey(display, keycode, mods, DefaultRootWindow(display), True, GrabModeAsync, GrabModeAsync);
+        XSync(display, False);
+    }
+
+    void ungrabKey(int keycode, quint16 mods)
+    {
+        XUngrabKey(display, keycode, mods, DefaultRootWindow(display));
+        XSync(display, False);
+    }
+
+    // Presses or releases 'keycode' alone, for keys held across a test.
+    void hold(int keycode, bool down)
+    {
+        XTestFakeKeyEvent(display, keycode, down, CurrentTime);
+        XSync(display, False);
+    }
+
+    // Presses and releases 'keycode' while the keys of 'keysyms' are held.
+    void tap(int keycode, const QVector<KeySym>& keysyms = QVector<KeySym>())
+    {
+        foreach (KeySym keysym, keysyms)
+            XTestFakeKeyEvent(display, XKeysymToKeycode(display, keysym), True, CurrentTime);
+        XTestFakeKeyEvent(display, keycode, True, CurrentTime);
+        XTestFakeKeyEvent(display, keycode, False, CurrentTime);
+        for (int i = keysyms.size() - 1; i >= 0; --i)
+            XTestFakeKeyEvent(display, XKeysymToKeycode(display, keysyms.at(i)), False, CurrentTime);
+        XSync(display, False);
+    }
+
+    enum EventKind
+    {
+        MotionEvent,
+        ExposeEvent,
+        KeyPressEvent,
+        KeyReleaseEvent
+    };
+
+    // 'count' synthesized events of one kind on the root window, such as
+    // the dispatcher sees by the thousand while a window is dragged or
+    // repainted. Key events are for 'keycode' with 'state'.
+    QVector<MAQxtTestEvent> events(EventKind kind, int count, int keycode = 0, int state = 0) const
+    {
+        MAQxtTestEvent event;
+        memset(&event, 0, sizeof(event));
+#if QT_VERSION >= 0x050000
+        const quint8 types[] = { XCB_MOTION_NOTIFY, XCB_EXPOSE, XCB_KEY_PRESS, XCB_KEY_RELEASE };
+        event.response_type = types[kind];
+        if (kind == MotionEvent || kind == KeyPressEvent || kind == KeyReleaseEvent)
+        {
+            // Motion and key events share their layout.
+            xcb_key_press_event_t* key = reinterpret_cast<xcb_key_press_event_t*>(&event);
+            key->detail = xcb_keycode_t(keycode);
+            key->root = root;
+            key->event = root;
+            key->state = quint16(state);
+        }
+        else
+        {
+            reinterpret_cast<xcb_expose_event_t*>(&event)->window = root;
+        }
+#else
+        const int types[] = { MotionNotify, Expose, KeyPress, KeyRelease };
+        event.type = types[kind];
+        event.xany.display = display;
+        event.xany.window = root;
+        if (kind == KeyPressEvent || kind == KeyReleaseEvent)
+        {
+            event.xkey.root = root;
+            event.xkey.keycode = keycode;
+            event.xkey.state = state;
+        }
+        else if (kind == MotionEvent)
+        {
+            event.xmotion.root = root;
+        }
+#endif
+        return QVector<MAQxtTestEvent>(count, event);
+    }
+
+    // Passes 'events' to the native event filters of the main thread, and
+    // returns how many of them were filtered out.
+    static int filter(QVector<MAQxtTestEvent>& events)
+    {
+        QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+        int filtered = 0;
+        for (int i = 0; i < events.size(); ++i)
+        {
+#if QT_VERSION >= 0x060000
+            qintptr result;
+            filtered += dispatcher->filterNativeEvent("xcb_generic_event_t", &events[i], &result);
+#elif QT_VERSION >= 0x050000
+            long result;
+            filtered += dispatcher->filterNativeEvent("xcb_generic_event_t", &events[i], &result);
+#else
+            filtered += dispatcher->filterEvent(&events[i]);
+#endif
+        }
+        return filtered;
+    }
+
+    // Clears Caps Lock and Num Lock, which a tap of their keys leaves set.
+    void unlockModifiers()
+    {
+        XkbLockModifiers(display, XkbUseCoreKbd, LockMask | Mod2Mask, 0);
+        XSync(display, False);
+    }
+
+    Display* display;
+    xcb_connection_t* connection;
+    xcb_window_t root;
+
+private:
+    Q_DISABLE_COPY(MAQxtTestDisplay)
+};
+
+#endif // MAQXTTEST_X11_H
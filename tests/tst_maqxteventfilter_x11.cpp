@@ -0,0 +1,106 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxt/gui/maqxtglobalshortcut.h"
+#include "maqxt/gui/maqxtglobalshortcutbatch.h"
+#include "maqxttest_x11.h"
+
+Q_DECLARE_METATYPE(MAQxtTestDisplay::EventKind)
+
+// The cost the shortcuts' native event filter adds to every event the
+// application gets: rows without shortcuts have no filter installed and
+// measure the dispatcher alone.
+class tst_MAQxtEventFilterX11 : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void storm_data();
+    void storm();
+
+private:
+    MAQxtTestDisplay x;
+};
+
+void tst_MAQxtEventFilterX11::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server, e.g. xvfb-run");
+}
+
+void tst_MAQxtEventFilterX11::storm_data()
+{
+    QTest::addColumn<MAQxtTestDisplay::EventKind>("kind");
+    QTest::addColumn<int>("shortcuts");
+    QTest::addColumn<bool>("bound");
+    QTest::newRow("motion, no shortcuts") << MAQxtTestDisplay::MotionEvent << 0 << false;
+    QTest::newRow("motion, 100 shortcuts") << MAQxtTestDisplay::MotionEvent << 100 << false;
+    QTest::newRow("expose, no shortcuts") << MAQxtTestDisplay::ExposeEvent << 0 << false;
+    QTest::newRow("expose, 100 shortcuts") << MAQxtTestDisplay::ExposeEvent << 100 << false;
+    QTest::newRow("unbound key press, no shortcuts") << MAQxtTestDisplay::KeyPressEvent << 0 << false;
+    QTest::newRow("unbound key press, 100 shortcuts") << MAQxtTestDisplay::KeyPressEvent << 100 << false;
+    QTest::newRow("bound key, other modifiers, 100 shortcuts") << MAQxtTestDisplay::KeyPressEvent << 100 << true;
+    QTest::newRow("unbound key release, 100 shortcuts") << MAQxtTestDisplay::KeyReleaseEvent << 100 << false;
+}
+
+// 1000 events per iteration. The shortcuts are Ctrl+Alt, Ctrl+Alt+Shift,
+// Alt+Meta and Ctrl+Meta with letters. Unbound keys are function keys,
+// which the keycode bitmap turns away; a bound key with Shift alone gets
+// past both pre-checks and costs a table lookup.
+void tst_MAQxtEventFilterX11::storm()
+{
+    QFETCH(MAQxtTestDisplay::EventKind, kind);
+    QFETCH(int, shortcuts);
+    QFETCH(bool, bound);
+
+    const int modifiers[] =
+    {
+        int(Qt::ControlModifier) | int(Qt::AltModifier),
+        int(Qt::ControlModifier) | int(Qt::AltModifier) | int(Qt::ShiftModifier),
+        int(Qt::AltModifier) | int(Qt::MetaModifier),
+        int(Qt::ControlModifier) | int(Qt::MetaModifier)
+    };
+    QList<MAQxtGlobalShortcut*> registered;
+    MAQxtGlobalShortcutBatch batch;
+    for (int i = 0; i < shortcuts; ++i)
+    {
+        registered.append(new MAQxtGlobalShortcut);
+        batch.setShortcut(registered.last(), QKeySequence(modifiers[i / 26 % 4] | (Qt::Key_A + i % 26)));
+    }
+    QVERIFY(batch.apply());
+
+    const int keycode = XKeysymToKeycode(x.display, bound ? XK_a : XK_F5);
+    QVector<MAQxtTestEvent> events = x.events(kind, 1000, keycode, bound ? ShiftMask : 0);
+    int filtered = 0;
+    QBENCHMARK
+    {
+        filtered += MAQxtTestDisplay::filter(events);
+    }
+    qDeleteAll(registered);
+    QCOMPARE(filtered, 0);
+}
+
+QTEST_MAIN(tst_MAQxtEventFilterX11)
+#include "tst_maqxteventfilter_x11.moc"
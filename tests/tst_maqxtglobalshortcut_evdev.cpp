@@ -0,0 +1,255 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtglobalshortcut.h"
+#include "maqxttest.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <string.h>
+#include <unistd.h>
+
+// Kernels before 4.16 have no accessors for the event time.
+#ifndef input_event_sec
+#  define input_event_sec time.tv_sec
+#  define input_event_usec time.tv_usec
+#endif
+
+static const int qxt_test_ctrl_alt = int(Qt::ControlModifier) | int(Qt::AltModifier);
+
+// A recording played into the write end of a pipe the backend reads, the
+// way MAQxtGlobalShortcut::addInputDevice() documents it.
+class MAQxtTestReplay
+{
+public:
+    MAQxtTestReplay() : added(false)
+    {
+        fds[0] = fds[1] = -1;
+        if (pipe(fds) == 0)
+        {
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            added = MAQxtGlobalShortcut::addInputDevice(fds[0]);
+        }
+    }
+
+    ~MAQxtTestReplay()
+    {
+        finish();
+        if (fds[0] >= 0)
+        {
+            MAQxtGlobalShortcut::removeInputDevice(fds[0]);
+            close(fds[0]);
+        }
+    }
+
+    bool isOpen() const
+    {
+        return added;
+    }
+
+    // Queues a key record, stamped 'msecs' into the recording, followed by
+    // the report that ends it, as a keyboard sends them.
+    void key(quint16 code, int value, quint32 msecs)
+    {
+        append(EV_KEY, code, value, msecs);
+        append(EV_SYN, SYN_REPORT, 0, msecs);
+    }
+
+    void tap(quint16 code, quint32 msecs, quint32 holdMsecs)
+    {
+        key(code, 1, msecs);
+        key(code, 0, msecs + holdMsecs);
+    }
+
+    // Writes the queued records 'chunk' bytes at a time, so that records
+    // end up split between reads.
+    bool flush(int chunk = 0)
+    {
+        const char* data = reinterpret_cast<const char*>(records.constData());
+        int left = records.size() * int(sizeof(struct input_event));
+        if (chunk <= 0)
+            chunk = left;
+        while (left > 0)
+        {
+            const ssize_t size = write(fds[1], data, qMin(chunk, left));
+            if (size < 0 && errno == EINTR)
+                continue;
+            if (size <= 0)
+                return false;
+            data += size;
+            left -= int(size);
+            if (left > 0)
+                QTest::qWait(5);
+        }
+        records.clear();
+        return true;
+    }
+
+    // Closes the write end: the backend reads the end of the stream and
+    // stops reading the pipe.
+    void finish()
+    {
+        if (fds[1] >= 0)
+        {
+            close(fds[1]);
+            fds[1] = -1;
+        }
+    }
+
+    int device() const
+    {
+        return fds[0];
+    }
+
+private:
+    void append(quint16 type, quint16 code, int value, quint32 msecs)
+    {
+        struct input_event record;
+        memset(&record, 0, sizeof(record));
+        record.input_event_sec = msecs / 1000;
+        record.input_event_usec = msecs % 1000 * 1000;
+        record.type = type;
+        record.code = code;
+        record.value = value;
+        records.append(record);
+    }
+
+    int fds[2];
+    bool added;
+    QVector<struct input_event> records;
+};
+
+class tst_MAQxtGlobalShortcutEvdev : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void replay();
+    void modifiers();
+    void splitRecords();
+    void endOfStream();
+};
+
+void tst_MAQxtGlobalShortcutEvdev::replay()
+{
+    MAQxtTestReplay replay;
+    QVERIFY(replay.isOpen());
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_A)));
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QSignalSpy released(&shortcut, SIGNAL(released(int)));
+
+    replay.key(KEY_LEFTCTRL, 1, 1000);
+    replay.key(KEY_LEFTALT, 1, 1010);
+    replay.tap(KEY_A, 1100, 250);
+    replay.key(KEY_LEFTALT, 0, 1400);
+    replay.key(KEY_LEFTCTRL, 0, 1410);
+    QVERIFY(replay.flush());
+
+    QVERIFY(qxt_test_wait(released, 1));
+    QCOMPARE(activated.count(), 1);
+    QCOMPARE(released.at(0).at(0).toInt(), 250);
+}
+
+void tst_MAQxtGlobalShortcutEvdev::modifiers()
+{
+    MAQxtTestReplay replay;
+    QVERIFY(replay.isOpen());
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_A)));
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+
+    // Neither the bare key, one of the modifiers nor an extra one
+    // activates it; the right-hand modifiers count like the left ones.
+    replay.tap(KEY_A, 1000, 10);
+    replay.key(KEY_LEFTCTRL, 1, 1100);
+    replay.tap(KEY_A, 1110, 10);
+    replay.key(KEY_LEFTALT, 1, 1200);
+    replay.key(KEY_LEFTSHIFT, 1, 1210);
+    replay.tap(KEY_A, 1220, 10);
+    replay.key(KEY_LEFTSHIFT, 0, 1300);
+    replay.key(KEY_LEFTALT, 0, 1310);
+    replay.key(KEY_LEFTCTRL, 0, 1320);
+    replay.key(KEY_RIGHTCTRL, 1, 1400);
+    replay.key(KEY_RIGHTALT, 1, 1410);
+    replay.tap(KEY_A, 1420, 10);
+    replay.key(KEY_RIGHTALT, 0, 1500);
+    replay.key(KEY_RIGHTCTRL, 0, 1510);
+    QVERIFY(replay.flush());
+
+    QVERIFY(qxt_test_wait(activated, 1));
+    // Give a wrongly matched tap time to arrive as well.
+    QTest::qWait(50);
+    QCOMPARE(activated.count(), 1);
+}
+
+void tst_MAQxtGlobalShortcutEvdev::splitRecords()
+{
+    MAQxtTestReplay replay;
+    QVERIFY(replay.isOpen());
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_B)));
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+
+    const int taps = 5;
+    replay.key(KEY_LEFTCTRL, 1, 1000);
+    replay.key(KEY_LEFTALT, 1, 1010);
+    for (int i = 0; i < taps; ++i)
+        replay.tap(KEY_B, 1100 + i * 100, 20);
+    replay.key(KEY_LEFTALT, 0, 1700);
+    replay.key(KEY_LEFTCTRL, 0, 1710);
+    // Not a divisor of the record size.
+    QVERIFY(replay.flush(int(sizeof(struct input_event)) / 2 + 3));
+
+    QVERIFY(qxt_test_wait(activated, taps));
+    QCOMPARE(activated.count(), taps);
+}
+
+void tst_MAQxtGlobalShortcutEvdev::endOfStream()
+{
+    MAQxtTestReplay replay;
+    QVERIFY(replay.isOpen());
+    QVERIFY(!MAQxtGlobalShortcut::addInputDevice(replay.device()));
+    replay.finish();
+    // The backend lets go of the pipe, after which it can be added again.
+    QElapsedTimer timer;
+    timer.start();
+    bool added;
+    while (!(added = MAQxtGlobalShortcut::addInputDevice(replay.device())) && timer.elapsed() < 2000)
+        QTest::qWait(5);
+    QVERIFY(added);
+}
+
+// Needs no display: the evdev backend only reads the pipes it is given.
+int main(int argc, char** argv)
+{
+    QCoreApplication application(argc, argv);
+    tst_MAQxtGlobalShortcutEvdev test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_maqxtglobalshortcut_evdev.moc"
@@ -0,0 +1,509 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxt/gui/maqxtglobalshortcut.h"
+#include "maqxt/gui/maqxtglobalshortcutbatch.h"
+#include "maqxt/gui/maqxtglobalshortcutprofile.h"
+#include <QKeyEvent>
+#include <QMetaEnum>
+#include <QWidget>
+#include "maqxttest_x11.h"
+#include <algorithm>
+#include <dlfcn.h>
+
+// Xlib's event type macros shadow QEvent's.
+#undef KeyPress
+
+static const int qxt_test_ctrl_alt = int(Qt::ControlModifier) | int(Qt::AltModifier);
+
+// Keys that Xvfb's default US layout has, so registering them must work.
+static bool qxt_test_required_key(int key)
+{
+    static const int keys[] =
+    {
+        Qt::Key_Escape, Qt::Key_Tab, Qt::Key_Backspace, Qt::Key_Return, Qt::Key_Enter, Qt::Key_Insert,
+        Qt::Key_Delete, Qt::Key_Pause, Qt::Key_Print, Qt::Key_Home, Qt::Key_End, Qt::Key_Left, Qt::Key_Up,
+        Qt::Key_Right, Qt::Key_Down, Qt::Key_PageUp, Qt::Key_PageDown, Qt::Key_Shift, Qt::Key_Control,
+        Qt::Key_Alt, Qt::Key_CapsLock, Qt::Key_NumLock, Qt::Key_ScrollLock, Qt::Key_Super_L, Qt::Key_Menu,
+        Qt::Key_Space, Qt::Key_Comma, Qt::Key_Minus, Qt::Key_Period, Qt::Key_Slash, Qt::Key_Semicolon,
+        Qt::Key_Equal, Qt::Key_BracketLeft, Qt::Key_Backslash, Qt::Key_BracketRight,
+        Qt::Key_VolumeDown, Qt::Key_VolumeMute, Qt::Key_VolumeUp,
+        Qt::Key_MediaPlay, Qt::Key_MediaStop, Qt::Key_MediaPrevious, Qt::Key_MediaNext
+    };
+    if ((key >= Qt::Key_A && key <= Qt::Key_Z) || (key >= Qt::Key_0 && key <= Qt::Key_9) || (key >= Qt::Key_F1 && key <= Qt::Key_F12))
+        return true;
+    for (unsigned i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+    {
+        if (keys[i] == key)
+            return true;
+    }
+    return false;
+}
+
+// Keys whose keysym the layout only has beyond the Shift level, where
+// typing it takes a layout specific modifier: Sys_Req is Alt+Print.
+static bool qxt_test_other_level_key(int key)
+{
+    return key == Qt::Key_SysReq;
+}
+
+// Waits up to 'timeout' milliseconds for 'keycode' under 'mods' to be
+// grabbed, or released if 'grabbed' is false.
+static bool qxt_test_wait_grab(MAQxtTestDisplay& x, int keycode, quint16 mods, bool grabbed, int timeout = 2000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (x.grabbedKeycodes(mods).contains(keycode) != grabbed && timer.elapsed() < timeout)
+        QTest::qWait(5);
+    return x.grabbedKeycodes(mods).contains(keycode) == grabbed;
+}
+
+// Calls of XQueryKeymap() by the library, counted by taking its place.
+static int qxt_test_keymap_queries = 0;
+
+extern "C" int XQueryKeymap(Display* display, char keys[32])
+{
+    typedef int (*Function)(Display*, char*);
+    static Function next = reinterpret_cast<Function>(dlsym(RTLD_NEXT, "XQueryKeymap"));
+    ++qxt_test_keymap_queries;
+    return next(display, keys);
+}
+
+static bool qxt_test_wait_pressed(Qt::Key key, bool pressed, int timeout = 2000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (MAQxtGlobalShortcut::isKeyPressed(key) != pressed && timer.elapsed() < timeout)
+        QTest::qWait(5);
+    return MAQxtGlobalShortcut::isKeyPressed(key) == pressed;
+}
+
+// Records the key Qt reports for presses of one keycode while it has the
+// focus.
+class MAQxtKeyRecorder : public QWidget
+{
+public:
+    MAQxtKeyRecorder() : keycode(0), key(0)
+    {
+        setFocusPolicy(Qt::StrongFocus);
+    }
+
+    // The key of a tap of 'keycode' with the keys of 'keysyms' held, or 0
+    // if Qt reports none within 'timeout' milliseconds.
+    int type(MAQxtTestDisplay& x, int keycode, const QVector<KeySym>& keysyms = QVector<KeySym>(), int timeout = 1000)
+    {
+        this->keycode = keycode;
+        key = 0;
+        x.tap(keycode, keysyms);
+        QElapsedTimer timer;
+        timer.start();
+        while (!key && timer.elapsed() < timeout)
+            QTest::qWait(5);
+        return key;
+    }
+
+protected:
+    bool event(QEvent* event)
+    {
+        // Ahead of QWidget, which moves the focus on Tab and Backtab.
+        if (event->type() == QEvent::KeyPress)
+        {
+            // On X11 the native scan code is the keycode.
+            const QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+            if (int(keyEvent->nativeScanCode()) == keycode)
+                key = keyEvent->key();
+            return true;
+        }
+        return QWidget::event(event);
+    }
+
+private:
+    int keycode;
+    int key;
+};
+
+class tst_MAQxtGlobalShortcutX11 : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+    void roundTrip_data();
+    void roundTrip();
+    void missingKey_data();
+    void missingKey();
+    void missingKeyInBatch();
+    void missingChordInProfile();
+    void chordGrabs();
+    void sharedGrab();
+    void enableBurst();
+    void probeForeignGrab();
+    void keyStateHeld();
+    void passiveTap();
+
+private:
+    MAQxtTestDisplay x;
+    MAQxtKeyRecorder recorder;
+};
+
+void tst_MAQxtGlobalShortcutX11::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server with the XTEST extension, e.g. xvfb-run");
+    int event, error, major, minor;
+    QVERIFY(XTestQueryExtension(x.display, &event, &error, &major, &minor));
+    recorder.show();
+#if QT_VERSION >= 0x050000
+    QVERIFY(QTest::qWaitForWindowExposed(&recorder));
+#else
+    QTest::qWaitForWindowShown(&recorder);
+#endif
+    // Without a window manager the focus has to be given explicitly.
+    XSetInputFocus(x.display, recorder.winId(), RevertToParent, CurrentTime);
+    XSync(x.display, False);
+    QElapsedTimer timer;
+    timer.start();
+    while (!recorder.isActiveWindow() && timer.elapsed() < 2000)
+        QTest::qWait(5);
+    QVERIFY(recorder.isActiveWindow());
+}
+
+void tst_MAQxtGlobalShortcutX11::cleanup()
+{
+    x.unlockModifiers();
+}
+
+void tst_MAQxtGlobalShortcutX11::roundTrip_data()
+{
+    QTest::addColumn<int>("key");
+#if QT_VERSION >= 0x050500
+    const QMetaEnum keys = QMetaEnum::fromType<Qt::Key>();
+#else
+    const QMetaEnum keys = staticQtMetaObject.enumerator(staticQtMetaObject.indexOfEnumerator("Key"));
+#endif
+    for (int i = 0; i < keys.keyCount(); ++i)
+        QTest::newRow(keys.key(i)) << keys.value(i);
+}
+
+// Every Qt::Key either grabs exactly the keycode that types it, which then
+// activates the shortcut, or fails and grabs nothing at all. Keys without
+// a keysym resolve to keycode 0, which XCB takes for XCB_GRAB_ANY.
+void tst_MAQxtGlobalShortcutX11::roundTrip()
+{
+    QFETCH(int, key);
+    int keycode = 0;
+    {
+        MAQxtGlobalShortcut shortcut;
+        QSignalSpy activated(&shortcut, SIGNAL(activated()));
+        QSignalSpy released(&shortcut, SIGNAL(released(int)));
+        const bool ok = shortcut.setShortcut(QKeySequence(key));
+        const QVector<int> grabbed = x.grabbedKeycodes(0);
+        if (qxt_test_required_key(key))
+            QVERIFY(ok);
+        if (!ok)
+        {
+            QVERIFY2(grabbed.isEmpty(), "a key that failed to register holds a grab");
+            return;
+        }
+        QCOMPARE(grabbed.size(), 1);
+        keycode = grabbed.at(0);
+        x.tap(keycode);
+        QVERIFY(qxt_test_wait(activated, 1));
+        QVERIFY(qxt_test_wait(released, 1));
+        QCOMPARE(activated.count(), 1);
+    }
+    QVERIFY(x.grabbedKeycodes(0).isEmpty());
+
+    // And back: the keycode, typed on its own or with Shift, gives the key.
+    if (qxt_test_other_level_key(key))
+        return;
+    int typed = recorder.type(x, keycode);
+    if (typed != key)
+        typed = recorder.type(x, keycode, QVector<KeySym>() << XK_Shift_L);
+    QCOMPARE(typed, key);
+}
+
+void tst_MAQxtGlobalShortcutX11::missingKey_data()
+{
+    QTest::addColumn<QKeySequence>("sequence");
+    QTest::newRow("empty") << QKeySequence();
+    QTest::newRow("Direction_L") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_Direction_L);
+    QTest::newRow("Direction_R") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_Direction_R);
+    QTest::newRow("BassBoost") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_BassBoost);
+    QTest::newRow("TrebleUp") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_TrebleUp);
+    QTest::newRow("unknown") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_unknown);
+    QTest::newRow("GroupSwitch") << QKeySequence(qxt_test_ctrl_alt | Qt::GroupSwitchModifier | Qt::Key_A);
+    QTest::newRow("chord") << QKeySequence(qxt_test_ctrl_alt | Qt::Key_A, qxt_test_ctrl_alt | Qt::Key_BassBoost);
+}
+
+void tst_MAQxtGlobalShortcutX11::missingKey()
+{
+    QFETCH(QKeySequence, sequence);
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(!shortcut.setShortcut(sequence));
+    QVERIFY(x.grabbedKeycodes(ControlMask | Mod1Mask).isEmpty());
+}
+
+void tst_MAQxtGlobalShortcutX11::missingKeyInBatch()
+{
+    MAQxtGlobalShortcut present;
+    MAQxtGlobalShortcut missing;
+
+    MAQxtGlobalShortcutBatch atomic(MAQxtGlobalShortcutBatch::Atomic);
+    atomic.setShortcut(&present, QKeySequence(qxt_test_ctrl_alt | Qt::Key_A));
+    atomic.setShortcut(&missing, QKeySequence(qxt_test_ctrl_alt | Qt::Key_BassBoost));
+    QVERIFY(!atomic.apply());
+    QVERIFY(!atomic.result(1));
+    QVERIFY(x.grabbedKeycodes(ControlMask | Mod1Mask).isEmpty());
+
+    MAQxtGlobalShortcutBatch bestEffort(MAQxtGlobalShortcutBatch::BestEffort);
+    bestEffort.setShortcut(&present, QKeySequence(qxt_test_ctrl_alt | Qt::Key_A));
+    bestEffort.setShortcut(&missing, QKeySequence(qxt_test_ctrl_alt | Qt::Key_BassBoost));
+    QVERIFY(!bestEffort.apply());
+    QVERIFY(bestEffort.result(0));
+    QVERIFY(!bestEffort.result(1));
+    QCOMPARE(x.grabbedKeycodes(ControlMask | Mod1Mask).size(), 1);
+}
+
+// Multi-chord shortcuts are switched after the others; one that fails
+// must still take the whole switch back.
+void tst_MAQxtGlobalShortcutX11::missingChordInProfile()
+{
+    MAQxtGlobalShortcut single;
+    MAQxtGlobalShortcut chord;
+    const QKeySequence first(qxt_test_ctrl_alt | Qt::Key_A);
+
+    MAQxtGlobalShortcutProfile current("current");
+    current.setShortcut(&single, first);
+    QVERIFY(current.activate());
+    const QVector<int> grabbed = x.grabbedKeycodes(ControlMask | Mod1Mask);
+    QCOMPARE(grabbed.size(), 1);
+
+    MAQxtGlobalShortcutProfile broken("broken");
+    broken.setShortcut(&single, QKeySequence(qxt_test_ctrl_alt | Qt::Key_B));
+    broken.setShortcut(&chord, QKeySequence(qxt_test_ctrl_alt | Qt::Key_C, qxt_test_ctrl_alt | Qt::Key_BassBoost));
+    QVERIFY(!broken.activate());
+    QVERIFY(current.isActive());
+    QVERIFY(!broken.isActive());
+    QCOMPARE(single.shortcut(), first);
+    QVERIFY(chord.shortcut().isEmpty());
+    QCOMPARE(x.grabbedKeycodes(ControlMask | Mod1Mask), grabbed);
+}
+
+// The chords that may follow a typed prefix are grabbed only while it is
+// pending, and given back once the sequence completes or times out.
+void tst_MAQxtGlobalShortcutX11::chordGrabs()
+{
+    const quint16 mods = ControlMask | Mod1Mask;
+    const QVector<KeySym> ctrlAlt = QVector<KeySym>() << XK_Control_L << XK_Alt_L;
+    const int first = XKeysymToKeycode(x.display, XK_a);
+    const int second = XKeysymToKeycode(x.display, XK_b);
+    const int timeout = MAQxtGlobalShortcut::chordTimeout();
+
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_A, qxt_test_ctrl_alt | Qt::Key_B)));
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << first);
+
+    x.tap(first, ctrlAlt);
+    QVERIFY(qxt_test_wait_grab(x, second, mods, true));
+    QCOMPARE(activated.count(), 0);
+    x.tap(second, ctrlAlt);
+    QVERIFY(qxt_test_wait(activated, 1));
+    QVERIFY(qxt_test_wait_grab(x, second, mods, false));
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << first);
+
+    MAQxtGlobalShortcut::setChordTimeout(200);
+    x.tap(first, ctrlAlt);
+    QVERIFY(qxt_test_wait_grab(x, second, mods, true));
+    QVERIFY(qxt_test_wait_grab(x, second, mods, false));
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << first);
+    // Timed out, the second chord alone does nothing.
+    x.tap(second, ctrlAlt);
+    QTest::qWait(100);
+    QCOMPARE(activated.count(), 1);
+    MAQxtGlobalShortcut::setChordTimeout(timeout);
+}
+
+// Shortcuts on one key sequence share a single grab, held while any of
+// them is left.
+void tst_MAQxtGlobalShortcutX11::sharedGrab()
+{
+    const quint16 mods = ControlMask | Mod1Mask;
+    const QVector<KeySym> ctrlAlt = QVector<KeySym>() << XK_Control_L << XK_Alt_L;
+    const int keycode = XKeysymToKeycode(x.display, XK_c);
+    const QKeySequence sequence(qxt_test_ctrl_alt | Qt::Key_C);
+
+    MAQxtGlobalShortcut* first = new MAQxtGlobalShortcut;
+    MAQxtGlobalShortcut* second = new MAQxtGlobalShortcut;
+    QSignalSpy firstActivated(first, SIGNAL(activated()));
+    QSignalSpy secondActivated(second, SIGNAL(activated()));
+    QVERIFY(first->setShortcut(sequence));
+    QVERIFY(second->setShortcut(sequence));
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << keycode);
+
+    x.tap(keycode, ctrlAlt);
+    QVERIFY(qxt_test_wait(firstActivated, 1));
+    QVERIFY(qxt_test_wait(secondActivated, 1));
+
+    delete first;
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << keycode);
+    x.tap(keycode, ctrlAlt);
+    QVERIFY(qxt_test_wait(secondActivated, 2));
+    QCOMPARE(firstActivated.count(), 1);
+
+    delete second;
+    QVERIFY(x.grabbedKeycodes(mods).isEmpty());
+}
+
+// With ungrabWhenDisabled(), a burst of enable and disable calls within
+// one pass of the event loop reaches the server as at most one update,
+// and a disabled shortcut holds no grab.
+void tst_MAQxtGlobalShortcutX11::enableBurst()
+{
+    const quint16 mods = ControlMask | Mod1Mask;
+    const QVector<KeySym> ctrlAlt = QVector<KeySym>() << XK_Control_L << XK_Alt_L;
+    const int keycode = XKeysymToKeycode(x.display, XK_d);
+    const bool statistics = MAQxtGlobalShortcut::isStatisticsEnabled();
+
+    MAQxtGlobalShortcut::setUngrabWhenDisabled(true);
+    MAQxtGlobalShortcut::setStatisticsEnabled(true);
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_D)));
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << keycode);
+
+    // Ends disabled: one ungrab.
+    MAQxtGlobalShortcut::resetStatistics();
+    for (int i = 0; i < 1001; ++i)
+        shortcut.setEnabled(i % 2 != 0);
+    QVERIFY(!shortcut.isEnabled());
+    QTest::qWait(50);
+    QVERIFY(x.grabbedKeycodes(mods).isEmpty());
+    QCOMPARE(MAQxtGlobalShortcut::statistics().registrationOperations, quint64(1));
+    x.tap(keycode, ctrlAlt);
+    QTest::qWait(100);
+    QCOMPARE(activated.count(), 0);
+
+    // Ends where it started: nothing.
+    MAQxtGlobalShortcut::resetStatistics();
+    for (int i = 0; i < 1000; ++i)
+        shortcut.setEnabled(i % 2 == 0);
+    QVERIFY(!shortcut.isEnabled());
+    QTest::qWait(50);
+    QVERIFY(x.grabbedKeycodes(mods).isEmpty());
+    QCOMPARE(MAQxtGlobalShortcut::statistics().registrationOperations, quint64(0));
+
+    // Ends enabled: one grab, and the shortcut fires again.
+    MAQxtGlobalShortcut::resetStatistics();
+    for (int i = 0; i < 1001; ++i)
+        shortcut.setEnabled(i % 2 == 0);
+    QVERIFY(shortcut.isEnabled());
+    QTest::qWait(50);
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << keycode);
+    QCOMPARE(MAQxtGlobalShortcut::statistics().registrationOperations, quint64(1));
+    x.tap(keycode, ctrlAlt);
+    QVERIFY(qxt_test_wait(activated, 1));
+
+    MAQxtGlobalShortcut::setStatisticsEnabled(statistics);
+    MAQxtGlobalShortcut::setUngrabWhenDisabled(false);
+}
+
+// A combination another client holds is reported taken, whether as the
+// only chord or a later one, and skipped when picking the first available
+// candidate; the probes leave no grab behind.
+void tst_MAQxtGlobalShortcutX11::probeForeignGrab()
+{
+    const quint16 mods = ControlMask | Mod1Mask;
+    const int taken = XKeysymToKeycode(x.display, XK_f);
+    const int free = XKeysymToKeycode(x.display, XK_g);
+    const QKeySequence takenSequence(qxt_test_ctrl_alt | Qt::Key_F);
+    const QKeySequence freeSequence(qxt_test_ctrl_alt | Qt::Key_G);
+    const QKeySequence otherFreeSequence(qxt_test_ctrl_alt | Qt::Key_H);
+    const QKeySequence takenChord(qxt_test_ctrl_alt | Qt::Key_G, qxt_test_ctrl_alt | Qt::Key_F);
+    const QKeySequence unmapped(qxt_test_ctrl_alt | Qt::Key_BassBoost);
+
+    x.grabKey(taken, mods);
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << taken);
+
+    const QList<QKeySequence> candidates = QList<QKeySequence>()
+        << takenSequence << freeSequence << takenChord << unmapped << otherFreeSequence;
+    QCOMPARE(MAQxtGlobalShortcut::availableShortcuts(candidates), QList<QKeySequence>() << freeSequence << otherFreeSequence);
+    QCOMPARE(x.grabbedKeycodes(mods), QVector<int>() << taken);
+
+    MAQxtGlobalShortcut shortcut;
+    QCOMPARE(shortcut.setFirstAvailableShortcut(candidates), 1);
+    QCOMPARE(shortcut.shortcut(), freeSequence);
+    QVector<int> grabbed = x.grabbedKeycodes(mods);
+    std::sort(grabbed.begin(), grabbed.end());
+    QVector<int> expected = QVector<int>() << taken << free;
+    std::sort(expected.begin(), expected.end());
+    QCOMPARE(grabbed, expected);
+
+    // Taken by this application now, the combination is no longer free.
+    QCOMPARE(MAQxtGlobalShortcut::availableShortcuts(candidates), QList<QKeySequence>() << otherFreeSequence);
+
+    x.ungrabKey(taken, mods);
+}
+
+// A held key is followed from the raw events alone; the keymap is only
+// read once, when tracking starts.
+void tst_MAQxtGlobalShortcutX11::keyStateHeld()
+{
+    const int keycode = XKeysymToKeycode(x.display, XK_x);
+    QVERIFY(MAQxtGlobalShortcut::setKeyStateTracked(true));
+    QVERIFY(!MAQxtGlobalShortcut::isKeyPressed(Qt::Key_X));
+    qxt_test_keymap_queries = 0;
+
+    x.hold(keycode, true);
+    const bool pressed = qxt_test_wait_pressed(Qt::Key_X, true);
+    x.hold(keycode, false);
+    QVERIFY(pressed);
+    QVERIFY(qxt_test_wait_pressed(Qt::Key_X, false));
+    QCOMPARE(qxt_test_keymap_queries, 0);
+
+    QVERIFY(MAQxtGlobalShortcut::setKeyStateTracked(false));
+}
+
+// A passive shortcut holds no grab and is still activated by a tap.
+void tst_MAQxtGlobalShortcutX11::passiveTap()
+{
+    const quint16 mods = ControlMask | Mod1Mask;
+    const QVector<KeySym> ctrlAlt = QVector<KeySym>() << XK_Control_L << XK_Alt_L;
+    const int keycode = XKeysymToKeycode(x.display, XK_e);
+
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setPassive(true));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_E)));
+    QVERIFY(x.grabbedKeycodes(mods).isEmpty());
+
+    x.tap(keycode, ctrlAlt);
+    QVERIFY(qxt_test_wait(activated, 1));
+    QVERIFY(x.grabbedKeycodes(mods).isEmpty());
+}
+
+QTEST_MAIN(tst_MAQxtGlobalShortcutX11)
+#include "tst_maqxtglobalshortcut_x11.moc"
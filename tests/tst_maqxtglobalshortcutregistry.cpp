@@ -0,0 +1,129 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtglobalshortcutregistry_p.h"
+#include <QtTest>
+
+static int qxt_test_installs = 0;
+
+static void qxt_test_install()
+{
+    ++qxt_test_installs;
+}
+
+class tst_MAQxtGlobalShortcutRegistry : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void add();
+    void remove();
+    void xorCollisions();
+    void installHandler();
+};
+
+void tst_MAQxtGlobalShortcutRegistry::add()
+{
+    MAQxtGlobalShortcutRegistry registry;
+    int handle;
+    QCOMPARE(registry.add(38, 4), 1);
+    QCOMPARE(registry.add(39, 4, &handle), 2);
+    QCOMPARE(registry.size(), 2);
+    QCOMPARE(registry.id(38, 4), 1);
+    QCOMPARE(registry.id(39, 4), 2);
+    QCOMPARE(registry.id(38, 0), 0);
+
+    const MAQxtGlobalShortcutRegistry::Registration* registration = registry.registration(2);
+    QVERIFY(registration);
+    QCOMPARE(registration->nativeKey, 39u);
+    QCOMPARE(registration->nativeMods, 4u);
+    QVERIFY(registration->handle == &handle);
+    QVERIFY(!registry.registration(0));
+    QVERIFY(!registry.registration(3));
+
+    // Adding a pair again keeps its id and replaces the handle.
+    QCOMPARE(registry.add(39, 4), 2);
+    QVERIFY(!registry.registration(2)->handle);
+    registry.setHandle(2, &handle);
+    QVERIFY(registry.registration(2)->handle == &handle);
+    QCOMPARE(registry.size(), 2);
+}
+
+void tst_MAQxtGlobalShortcutRegistry::remove()
+{
+    MAQxtGlobalShortcutRegistry registry;
+    for (quint32 key = 0; key < 10; ++key)
+        QCOMPARE(registry.add(key, 1), int(key) + 1);
+    QVERIFY(registry.remove(4));
+    QVERIFY(registry.remove(7));
+    QVERIFY(!registry.remove(7));
+    QVERIFY(!registry.remove(11));
+    QCOMPARE(registry.size(), 8);
+    QCOMPARE(registry.id(3, 1), 0);
+    QVERIFY(!registry.registration(4));
+
+    // Released ids are handed out again before new ones.
+    const int first = registry.add(100, 1);
+    const int second = registry.add(101, 1);
+    QVERIFY((first == 4 && second == 7) || (first == 7 && second == 4));
+    QCOMPARE(registry.add(102, 1), 11);
+    QCOMPARE(registry.id(100, 1), first);
+    QCOMPARE(registry.registration(first)->nativeKey, 100u);
+}
+
+// Windows hot key ids used to be nativeMods ^ nativeKey, under which all
+// of these were the same hot key.
+void tst_MAQxtGlobalShortcutRegistry::xorCollisions()
+{
+    MAQxtGlobalShortcutRegistry registry;
+    const int a = registry.add(1, 2);
+    const int b = registry.add(2, 1);
+    const int c = registry.add(3, 0);
+    const int d = registry.add(0, 3);
+    QCOMPARE(registry.size(), 4);
+    QVERIFY(a != b && a != c && a != d && b != c && b != d && c != d);
+    QCOMPARE(registry.registration(b)->nativeKey, 2u);
+    QCOMPARE(registry.registration(d)->nativeMods, 3u);
+
+    // The full 32 bits of both halves are kept apart.
+    const int high = registry.add(0xffffffffu, 0);
+    const int low = registry.add(0, 0xffffffffu);
+    QVERIFY(high != low);
+    QCOMPARE(registry.id(0xffffffffu, 0), high);
+    QCOMPARE(registry.id(0, 0xffffffffu), low);
+}
+
+void tst_MAQxtGlobalShortcutRegistry::installHandler()
+{
+    MAQxtGlobalShortcutRegistry registry;
+    qxt_test_installs = 0;
+    QVERIFY(registry.installHandler(qxt_test_install));
+    QVERIFY(!registry.installHandler(qxt_test_install));
+    registry.add(38, 4);
+    QVERIFY(!registry.installHandler(qxt_test_install));
+    QCOMPARE(qxt_test_installs, 1);
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtGlobalShortcutRegistry)
+#include "tst_maqxtglobalshortcutregistry.moc"
@@ -0,0 +1,169 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxttest_trace.h"
+#include "maqxttest_x11.h"
+
+// Built in since Qt 5.
+#if QT_VERSION < 0x050000
+Q_DECLARE_METATYPE(QList<int>)
+#endif
+
+static const int qxt_test_ctrl_alt = int(Qt::ControlModifier) | int(Qt::AltModifier);
+
+// Notes repeatCount() at every activation and the hold duration of every
+// release.
+class MAQxtTestRepeatRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MAQxtTestRepeatRecorder(MAQxtGlobalShortcut* shortcut) : shortcut(shortcut)
+    {
+        connect(shortcut, SIGNAL(activated()), this, SLOT(activated()));
+        connect(shortcut, SIGNAL(released(int)), this, SLOT(released(int)));
+    }
+
+    QList<int> repeatCounts;
+    QList<int> holdDurations;
+
+private Q_SLOTS:
+    void activated()
+    {
+        repeatCounts.append(shortcut->repeatCount());
+    }
+
+    void released(int holdDuration)
+    {
+        // Coalesced repeats go out before the release.
+        holdDurations.append(holdDuration);
+        repeatCounts.append(-1);
+    }
+
+private:
+    MAQxtGlobalShortcut* shortcut;
+};
+
+// Repeat policies are decided on the timestamps of the native events, so
+// replaying a trace at maximum speed gives the same signals every time.
+class tst_MAQxtGlobalShortcutRepeatX11 : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void policy_data();
+    void policy();
+    void twoHolds();
+
+private:
+    MAQxtTestDisplay x;
+};
+
+void tst_MAQxtGlobalShortcutRepeatX11::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server, e.g. xvfb-run");
+}
+
+void tst_MAQxtGlobalShortcutRepeatX11::policy_data()
+{
+    QTest::addColumn<int>("policy");
+    QTest::addColumn<int>("interval");
+    QTest::addColumn<QList<int> >("repeatCounts");
+
+    // A press at 1000, ten auto-repeats 30 ms apart and the release at
+    // 1330; -1 stands for released().
+    QList<int> all;
+    all << 0;
+    for (int i = 0; i < 10; ++i)
+        all << 1;
+    all << -1;
+    QTest::newRow("AllowRepeats") << int(MAQxtGlobalShortcut::AllowRepeats) << 500 << all;
+    QTest::newRow("DropRepeats") << int(MAQxtGlobalShortcut::DropRepeats) << 500 << (QList<int>() << 0 << -1);
+    // Repeats at 1120 and 1240 are the first 100 ms after an activation,
+    // each standing for four; the last two are still due at the release.
+    QTest::newRow("ThrottleRepeats 100") << int(MAQxtGlobalShortcut::ThrottleRepeats) << 100 << (QList<int>() << 0 << 4 << 4 << -1);
+    QTest::newRow("ThrottleRepeats 0") << int(MAQxtGlobalShortcut::ThrottleRepeats) << 0 << all;
+    QTest::newRow("ThrottleRepeats 1000") << int(MAQxtGlobalShortcut::ThrottleRepeats) << 1000 << (QList<int>() << 0 << -1);
+    // The replay keeps the event loop from flushing, so every repeat is
+    // merged into one activation ahead of the release.
+    QTest::newRow("CoalesceRepeats") << int(MAQxtGlobalShortcut::CoalesceRepeats) << 500 << (QList<int>() << 0 << 10 << -1);
+}
+
+void tst_MAQxtGlobalShortcutRepeatX11::policy()
+{
+    QFETCH(int, policy);
+    QFETCH(int, interval);
+    QFETCH(QList<int>, repeatCounts);
+
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_D)));
+    shortcut.setRepeatPolicy(MAQxtGlobalShortcut::RepeatPolicy(policy));
+    shortcut.setRepeatInterval(interval);
+    QCOMPARE(int(shortcut.repeatPolicy()), policy);
+    QCOMPARE(shortcut.repeatInterval(), interval);
+    MAQxtTestRepeatRecorder recorder(&shortcut);
+
+    const quint32 keycode = XKeysymToKeycode(x.display, XK_d);
+    const quint32 mods = ControlMask | Mod1Mask;
+    MAQxtTestTrace trace;
+    for (int i = 0; i <= 10; ++i)
+        trace.press(1000 + 30 * i, keycode, mods);
+    trace.release(1330, keycode, mods);
+    const QByteArray data = trace.data();
+
+    for (int replay = 0; replay < 2; ++replay)
+    {
+        recorder.repeatCounts.clear();
+        recorder.holdDurations.clear();
+        QCOMPARE(MAQxtTestTrace::replay(data), 12);
+        QCOMPARE(recorder.repeatCounts, repeatCounts);
+        QCOMPARE(recorder.holdDurations, QList<int>() << 330);
+    }
+}
+
+// A new press after the release starts over, with its own hold duration;
+// the time since the previous activation does not carry over.
+void tst_MAQxtGlobalShortcutRepeatX11::twoHolds()
+{
+    MAQxtGlobalShortcut shortcut;
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_E)));
+    shortcut.setRepeatPolicy(MAQxtGlobalShortcut::ThrottleRepeats);
+    shortcut.setRepeatInterval(100);
+    MAQxtTestRepeatRecorder recorder(&shortcut);
+
+    const quint32 keycode = XKeysymToKeycode(x.display, XK_e);
+    const quint32 mods = ControlMask | Mod1Mask;
+    MAQxtTestTrace trace;
+    trace.press(1000, keycode, mods).press(1050, keycode, mods).release(1060, keycode, mods);
+    trace.press(1070, keycode, mods).press(1120, keycode, mods).press(1170, keycode, mods).release(1400, keycode, mods);
+    QCOMPARE(MAQxtTestTrace::replay(trace.data()), 7);
+    QCOMPARE(recorder.repeatCounts, QList<int>() << 0 << -1 << 0 << 2 << -1);
+    QCOMPARE(recorder.holdDurations, QList<int>() << 60 << 330);
+}
+
+QTEST_MAIN(tst_MAQxtGlobalShortcutRepeatX11)
+
+#include "tst_maqxtglobalshortcutrepeat_x11.moc"
@@ -0,0 +1,191 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtglobalshortcuttable_p.h"
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QtTest>
+
+typedef QPair<quint32, quint32> MAQxtNativeShortcut;
+
+// Shortcuts are only stored and compared, never dereferenced.
+static MAQxtGlobalShortcut* qxt_test_shortcut(int i)
+{
+    return reinterpret_cast<MAQxtGlobalShortcut*>(quintptr(i + 1) * 16);
+}
+
+// X11-like keycodes 8 to 255, with another modifier mask every 248 entries.
+static MAQxtNativeShortcut qxt_test_native(int i)
+{
+    return MAQxtNativeShortcut(8 + i % 248, i / 248);
+}
+
+class tst_MAQxtGlobalShortcutTable : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void insertFind();
+    void remove();
+    void setEnabled();
+    void mayContain();
+    void lookup_data();
+    void lookup();
+};
+
+void tst_MAQxtGlobalShortcutTable::insertFind()
+{
+    MAQxtGlobalShortcutTable table;
+    QVERIFY(!table.find(MAQxtGlobalShortcutTable::pack(38, 4)));
+    for (int i = 0; i < 1000; ++i)
+        table.insert(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second), qxt_test_shortcut(i), true);
+    QCOMPARE(table.size(), 1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const MAQxtGlobalShortcutTable::Entry* entry = table.find(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second));
+        QVERIFY(entry);
+        QVERIFY(entry->shortcut == qxt_test_shortcut(i));
+        QCOMPARE(entry->nativeKey(), qxt_test_native(i).first);
+        QCOMPARE(entry->nativeMods(), qxt_test_native(i).second);
+        QVERIFY(entry->isEnabled());
+    }
+    QVERIFY(!table.value(MAQxtGlobalShortcutTable::pack(7, 0)));
+
+    // Inserting an existing key replaces its shortcut.
+    table.insert(MAQxtGlobalShortcutTable::pack(8, 0), qxt_test_shortcut(5000), true);
+    QCOMPARE(table.size(), 1000);
+    QVERIFY(table.value(MAQxtGlobalShortcutTable::pack(8, 0)) == qxt_test_shortcut(5000));
+    QCOMPARE(table.entries().size(), 1000);
+}
+
+void tst_MAQxtGlobalShortcutTable::remove()
+{
+    MAQxtGlobalShortcutTable table;
+    for (int i = 0; i < 5000; ++i)
+        table.insert(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second), qxt_test_shortcut(i), true);
+    // Every other entry, so that removal has to close gaps in probe runs.
+    for (int i = 0; i < 5000; i += 2)
+        QVERIFY(table.remove(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second)));
+    QVERIFY(!table.remove(MAQxtGlobalShortcutTable::pack(qxt_test_native(0).first, qxt_test_native(0).second)));
+    QCOMPARE(table.size(), 2500);
+    for (int i = 0; i < 5000; ++i)
+    {
+        MAQxtGlobalShortcut* shortcut = table.value(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second));
+        QVERIFY(shortcut == (i % 2 ? qxt_test_shortcut(i) : 0));
+    }
+    table.clear();
+    QCOMPARE(table.size(), 0);
+    QVERIFY(!table.value(MAQxtGlobalShortcutTable::pack(qxt_test_native(1).first, qxt_test_native(1).second)));
+}
+
+void tst_MAQxtGlobalShortcutTable::setEnabled()
+{
+    MAQxtGlobalShortcutTable table;
+    const quint64 key = MAQxtGlobalShortcutTable::pack(38, 4);
+    table.insert(key, qxt_test_shortcut(1), false);
+    QVERIFY(!table.find(key)->isEnabled());
+    QVERIFY(!table.setEnabled(key, qxt_test_shortcut(2), true));
+    QVERIFY(table.setEnabled(key, qxt_test_shortcut(1), true));
+    QVERIFY(table.find(key)->isEnabled());
+    QVERIFY(table.setEnabled(key, qxt_test_shortcut(1), false));
+    QVERIFY(!table.find(key)->isEnabled());
+    QVERIFY(table.value(key) == qxt_test_shortcut(1));
+}
+
+void tst_MAQxtGlobalShortcutTable::mayContain()
+{
+    MAQxtGlobalShortcutTable table;
+    QVERIFY(!table.mayContain(38, 0));
+    table.insert(MAQxtGlobalShortcutTable::pack(38, 4), qxt_test_shortcut(1), true);
+    table.insert(MAQxtGlobalShortcutTable::pack(300, 1), qxt_test_shortcut(2), true);
+    QVERIFY(table.mayContain(38, 4));
+    QVERIFY(table.mayContain(38, 5));
+    QVERIFY(!table.mayContain(38, 8));
+    QVERIFY(!table.mayContain(39, 4));
+    QVERIFY(table.mayContain(301, 1));
+    table.remove(MAQxtGlobalShortcutTable::pack(300, 1));
+    QVERIFY(!table.mayContain(301, 1));
+    QVERIFY(!table.mayContain(38, 5));
+    QVERIFY(table.mayContain(38, 4));
+}
+
+void tst_MAQxtGlobalShortcutTable::lookup_data()
+{
+    QTest::addColumn<bool>("hash");
+    QTest::addColumn<int>("size");
+    const int sizes[] = { 10, 1000, 100000 };
+    for (int i = 0; i < 3; ++i)
+    {
+        QTest::newRow(QByteArray("QHash<QPair> ").append(QByteArray::number(sizes[i])).constData()) << true << sizes[i];
+        QTest::newRow(QByteArray("table ").append(QByteArray::number(sizes[i])).constData()) << false << sizes[i];
+    }
+}
+
+// Lookups as the event filter makes them: 1024 per iteration whatever the
+// size, half of them for keys that are not registered. The QHash keyed by
+// QPair is what the shortcuts were kept in before the table.
+void tst_MAQxtGlobalShortcutTable::lookup()
+{
+    QFETCH(bool, hash);
+    QFETCH(int, size);
+    const int lookups = 1024;
+    QVector<MAQxtNativeShortcut> probes(lookups);
+    for (int i = 0; i < lookups; ++i)
+        probes[i] = qxt_test_native(i % 2 ? (i * 7919) % size : size + i);
+
+    QHash<MAQxtNativeShortcut, MAQxtGlobalShortcut*> shortcuts;
+    MAQxtGlobalShortcutTable table;
+    for (int i = 0; i < size; ++i)
+    {
+        if (hash)
+            shortcuts.insert(qxt_test_native(i), qxt_test_shortcut(i));
+        else
+            table.insert(MAQxtGlobalShortcutTable::pack(qxt_test_native(i).first, qxt_test_native(i).second), qxt_test_shortcut(i), true);
+    }
+
+    int found = 0;
+    if (hash)
+    {
+        QBENCHMARK
+        {
+            found = 0;
+            for (int i = 0; i < lookups; ++i)
+                found += shortcuts.value(probes.at(i)) != 0;
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            found = 0;
+            for (int i = 0; i < lookups; ++i)
+                found += table.value(MAQxtGlobalShortcutTable::pack(probes.at(i).first, probes.at(i).second)) != 0;
+        }
+    }
+    QCOMPARE(found, lookups / 2);
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtGlobalShortcutTable)
+#include "tst_maqxtglobalshortcuttable.moc"
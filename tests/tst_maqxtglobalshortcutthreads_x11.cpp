@@ -0,0 +1,237 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxttest_trace.h"
+#include "maqxttest_x11.h"
+#include <QAtomicInt>
+#include <QBuffer>
+#include <QThread>
+
+static const int qxt_test_ctrl_alt = int(Qt::ControlModifier) | int(Qt::AltModifier);
+
+// Counts activations on whichever thread emits them.
+class MAQxtTestCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    MAQxtTestCounter() : toggled(0) {}
+
+    QAtomicInt activations;
+    MAQxtGlobalShortcut* toggled; // enabled state flipped by every activation
+
+public Q_SLOTS:
+    void count()
+    {
+        activations.ref();
+        // Receivers run without the shortcut mutex and may change
+        // shortcuts, while other threads do the same.
+        if (toggled)
+            toggled->setEnabled(!toggled->isEnabled());
+    }
+};
+
+// Creates, rebinds and deletes shortcuts until told to stop. Half of them
+// share their key sequences with the shortcuts the test counts.
+class MAQxtTestWriter : public QThread
+{
+public:
+    MAQxtTestWriter(MAQxtTestCounter* counter, int seed) : rounds(0), counter(counter), seed(seed) {}
+
+    QAtomicInt stop;
+    int rounds;
+
+protected:
+    void run()
+    {
+        QList<MAQxtGlobalShortcut*> shortcuts;
+        while (!stop.fetchAndAddOrdered(0))
+        {
+            const int letter = (seed + rounds) % 8 + (rounds % 2 ? 0 : 16);
+            MAQxtGlobalShortcut* shortcut = new MAQxtGlobalShortcut;
+            QObject::connect(shortcut, SIGNAL(activated()), counter, SLOT(count()), Qt::DirectConnection);
+            shortcut->setShortcut(QKeySequence(qxt_test_ctrl_alt | (Qt::Key_A + letter)));
+            shortcuts.append(shortcut);
+            if (shortcuts.size() > 4)
+            {
+                MAQxtGlobalShortcut* oldest = shortcuts.takeFirst();
+                oldest->setShortcut(QKeySequence(qxt_test_ctrl_alt | (Qt::Key_Q + (seed + rounds) % 8)));
+                oldest->setDisabled(rounds % 3 == 0);
+                delete oldest;
+            }
+            ++rounds;
+        }
+        qDeleteAll(shortcuts);
+    }
+
+private:
+    MAQxtTestCounter* counter;
+    int seed;
+};
+
+// Replays a trace over and over, each event through the full dispatch.
+class MAQxtTestDispatcher : public QThread
+{
+public:
+    MAQxtTestDispatcher(const QByteArray& trace, int replays) : replayed(0), trace(trace), replays(replays) {}
+
+    int replayed; // events, or -1 if a replay failed
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < replays; ++i)
+        {
+            QBuffer buffer;
+            buffer.setData(trace);
+            buffer.open(QIODevice::ReadOnly);
+            const int events = MAQxtGlobalShortcut::replayTrace(&buffer);
+            if (events < 0)
+            {
+                replayed = -1;
+                return;
+            }
+            replayed += events;
+        }
+    }
+
+private:
+    QByteArray trace;
+    int replays;
+};
+
+// Writer threads churn shortcuts while dispatcher threads feed key events,
+// and receivers change shortcuts from within their slots. Shortcuts that
+// stay put must see every press, none twice.
+class tst_MAQxtGlobalShortcutThreadsX11 : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void stress();
+
+private:
+    QByteArray trace(const QVector<quint32>& keycodes, quint32 mods);
+
+    MAQxtTestDisplay x;
+};
+
+void tst_MAQxtGlobalShortcutThreadsX11::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server, e.g. xvfb-run");
+}
+
+// A press and a release of each key in turn.
+QByteArray tst_MAQxtGlobalShortcutThreadsX11::trace(const QVector<quint32>& keycodes, quint32 mods)
+{
+    MAQxtTestTrace trace;
+    quint32 time = 1000;
+    foreach (quint32 keycode, keycodes)
+    {
+        trace.press(time, keycode, mods).release(time + 5, keycode, mods);
+        time += 10;
+    }
+    return trace.data();
+}
+
+void tst_MAQxtGlobalShortcutThreadsX11::stress()
+{
+    const int stableCount = 8;
+    const int dispatcherCount = 2;
+    const int writerCount = 2;
+    const int replays = 500;
+
+    // Ctrl+Alt+A to H stay put; the writers also use them and Q to X.
+    // Function keys with Ctrl+Alt match nothing.
+    MAQxtTestCounter stableCounter;
+    MAQxtTestCounter churnCounter;
+    QList<MAQxtGlobalShortcut*> stable;
+    QVector<quint32> keycodes;
+    for (int i = 0; i < stableCount; ++i)
+    {
+        stable.append(new MAQxtGlobalShortcut);
+        QVERIFY(stable.last()->setShortcut(QKeySequence(qxt_test_ctrl_alt | (Qt::Key_A + i))));
+        connect(stable.last(), SIGNAL(activated()), &stableCounter, SLOT(count()), Qt::DirectConnection);
+        keycodes.append(XKeysymToKeycode(x.display, XK_a + i));
+        keycodes.append(XKeysymToKeycode(x.display, XK_q + i));
+    }
+    for (int i = 0; i < 4; ++i)
+        keycodes.append(XKeysymToKeycode(x.display, XK_F5 + i));
+    MAQxtGlobalShortcut toggled;
+    QVERIFY(toggled.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_Y)));
+    stableCounter.toggled = &toggled;
+
+    // The X11 backend grabs Ctrl+Alt as Control and Mod1.
+    const QByteArray events = trace(keycodes, ControlMask | Mod1Mask);
+    QVERIFY(!events.isEmpty());
+
+    QList<MAQxtTestWriter*> writers;
+    for (int i = 0; i < writerCount; ++i)
+    {
+        writers.append(new MAQxtTestWriter(&churnCounter, i));
+        writers.last()->start();
+    }
+    QList<MAQxtTestDispatcher*> dispatchers;
+    for (int i = 0; i < dispatcherCount; ++i)
+    {
+        dispatchers.append(new MAQxtTestDispatcher(events, replays));
+        dispatchers.last()->start();
+    }
+    foreach (MAQxtTestDispatcher* dispatcher, dispatchers)
+        QVERIFY(dispatcher->wait(60000));
+    foreach (MAQxtTestWriter* writer, writers)
+    {
+        writer->stop.fetchAndStoreOrdered(1);
+        QVERIFY(writer->wait(60000));
+    }
+
+    foreach (MAQxtTestDispatcher* dispatcher, dispatchers)
+        QCOMPARE(dispatcher->replayed, replays * 2 * keycodes.size());
+    int rounds = 0;
+    foreach (MAQxtTestWriter* writer, writers)
+        rounds += writer->rounds;
+    QVERIFY(rounds > 0);
+    QCOMPARE(int(stableCounter.activations.fetchAndAddOrdered(0)), dispatcherCount * replays * stableCount);
+
+    // Once the writers are gone, a replay reaches exactly the stable
+    // shortcuts again.
+    stableCounter.activations.fetchAndStoreOrdered(0);
+    churnCounter.activations.fetchAndStoreOrdered(0);
+    QBuffer buffer;
+    buffer.setData(events);
+    buffer.open(QIODevice::ReadOnly);
+    QCOMPARE(MAQxtGlobalShortcut::replayTrace(&buffer), 2 * keycodes.size());
+    QCOMPARE(int(stableCounter.activations.fetchAndAddOrdered(0)), stableCount);
+    QCOMPARE(int(churnCounter.activations.fetchAndAddOrdered(0)), 0);
+
+    qDeleteAll(dispatchers);
+    qDeleteAll(writers);
+    qDeleteAll(stable);
+}
+
+QTEST_MAIN(tst_MAQxtGlobalShortcutThreadsX11)
+
+#include "tst_maqxtglobalshortcutthreads_x11.moc"
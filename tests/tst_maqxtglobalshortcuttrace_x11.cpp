@@ -0,0 +1,173 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxttest.h"
+#include "maqxttest_trace.h"
+#include "maqxttest_x11.h"
+#include <QElapsedTimer>
+
+static const int qxt_test_ctrl_alt = int(Qt::ControlModifier) | int(Qt::AltModifier);
+
+// A press and a release of 'keycode' at each of 'times', 5 ms apart.
+static QByteArray qxt_test_trace(quint32 keycode, quint32 mods, const QVector<quint32>& times)
+{
+    MAQxtTestTrace trace;
+    foreach (quint32 time, times)
+        trace.press(time, keycode, mods).release(time + 5, keycode, mods);
+    return trace.data();
+}
+
+class tst_MAQxtGlobalShortcutTraceX11 : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void recordReplay();
+    void recordedSpeed();
+    void malformed_data();
+    void malformed();
+    void partialRecord();
+
+private:
+    MAQxtTestDisplay x;
+};
+
+void tst_MAQxtGlobalShortcutTraceX11::initTestCase()
+{
+    QVERIFY2(x.isOpen(), "needs an X server with the XTEST extension, e.g. xvfb-run");
+}
+
+// Live events are recorded as the dispatch saw them, and replaying them
+// activates the shortcut again without recording the replay.
+void tst_MAQxtGlobalShortcutTraceX11::recordReplay()
+{
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QSignalSpy released(&shortcut, SIGNAL(released(int)));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_A)));
+    const int keycode = XKeysymToKeycode(x.display, XK_a);
+
+    QBuffer recording;
+    recording.open(QIODevice::WriteOnly);
+    QVERIFY(MAQxtGlobalShortcut::startTrace(&recording));
+    x.tap(keycode, QVector<KeySym>() << XK_Control_L << XK_Alt_L);
+    QVERIFY(qxt_test_wait(activated, 1));
+    QVERIFY(qxt_test_wait(released, 1));
+    MAQxtGlobalShortcut::stopTrace();
+
+    QBuffer reading;
+    reading.setData(recording.data());
+    reading.open(QIODevice::ReadOnly);
+    QVector<MAQxtGlobalShortcutTrace::Event> events;
+    QVERIFY(MAQxtGlobalShortcutTrace::read(&reading, events));
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(0).nativeKey, quint32(keycode));
+    QVERIFY(!events.at(0).release);
+    QCOMPARE(events.at(1).nativeKey, quint32(keycode));
+    QVERIFY(events.at(1).release);
+    for (int i = 0; i < events.size(); ++i)
+        QCOMPARE(events.at(i).nativeMods & (ControlMask | Mod1Mask), quint32(ControlMask | Mod1Mask));
+    QVERIFY(qint32(events.at(1).time - events.at(0).time) >= 0);
+
+    QBuffer again;
+    again.open(QIODevice::WriteOnly);
+    QVERIFY(MAQxtGlobalShortcut::startTrace(&again));
+    QCOMPARE(MAQxtTestTrace::replay(recording.data()), 2);
+    MAQxtGlobalShortcut::stopTrace();
+    QCOMPARE(activated.count(), 2);
+    QCOMPARE(released.count(), 2);
+    QCOMPARE(int(again.data().size()), int(MAQxtGlobalShortcutTrace::HeaderSize));
+}
+
+// RecordedSpeed keeps the recorded spacing, MaximumSpeed drops it; both
+// dispatch the same.
+void tst_MAQxtGlobalShortcutTraceX11::recordedSpeed()
+{
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_B)));
+    const QByteArray trace = qxt_test_trace(XKeysymToKeycode(x.display, XK_b), ControlMask | Mod1Mask,
+                                            QVector<quint32>() << 1000 << 1200 << 1400);
+
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(MAQxtTestTrace::replay(trace, MAQxtGlobalShortcut::RecordedSpeed), 6);
+    QVERIFY(timer.elapsed() >= 400);
+    QCOMPARE(activated.count(), 3);
+
+    timer.restart();
+    QCOMPARE(MAQxtTestTrace::replay(trace, MAQxtGlobalShortcut::MaximumSpeed), 6);
+    QVERIFY(timer.elapsed() < 400);
+    QCOMPARE(activated.count(), 6);
+}
+
+void tst_MAQxtGlobalShortcutTraceX11::malformed_data()
+{
+    const QByteArray trace = qxt_test_trace(38, ControlMask, QVector<quint32>() << 1000);
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short header") << trace.left(MAQxtGlobalShortcutTrace::HeaderSize - 1);
+    QByteArray magic = trace;
+    magic[0] = 'X';
+    QTest::newRow("magic") << magic;
+    QByteArray version = trace;
+    version[8] = char(version[8] + 1);
+    QTest::newRow("version") << version;
+    QByteArray backend = trace;
+    backend[10] = char(backend[10] + 1);
+    QTest::newRow("backend") << backend;
+}
+
+void tst_MAQxtGlobalShortcutTraceX11::malformed()
+{
+    QFETCH(QByteArray, data);
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setShortcut(QKeySequence(int(Qt::ControlModifier) | Qt::Key_A)));
+    QCOMPARE(MAQxtTestTrace::replay(data), -1);
+    QCOMPARE(activated.count(), 0);
+
+    // Nor is a device that cannot be read.
+    QBuffer writeOnly;
+    writeOnly.open(QIODevice::WriteOnly);
+    QCOMPARE(MAQxtGlobalShortcut::replayTrace(&writeOnly), -1);
+}
+
+// A trace cut short mid-record replays the whole records before the cut.
+void tst_MAQxtGlobalShortcutTraceX11::partialRecord()
+{
+    MAQxtGlobalShortcut shortcut;
+    QSignalSpy activated(&shortcut, SIGNAL(activated()));
+    QVERIFY(shortcut.setShortcut(QKeySequence(qxt_test_ctrl_alt | Qt::Key_C)));
+    QByteArray trace = qxt_test_trace(XKeysymToKeycode(x.display, XK_c), ControlMask | Mod1Mask,
+                                      QVector<quint32>() << 1000 << 1100);
+    trace.chop(MAQxtGlobalShortcutTrace::RecordSize + 5);
+    QCOMPARE(MAQxtTestTrace::replay(trace), 2);
+    QCOMPARE(activated.count(), 1);
+}
+
+QTEST_MAIN(tst_MAQxtGlobalShortcutTraceX11)
+
+#include "tst_maqxtglobalshortcuttrace_x11.moc"
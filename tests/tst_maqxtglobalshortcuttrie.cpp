@@ -0,0 +1,176 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtglobalshortcuttrie_p.h"
+#include <QtTest>
+#include <algorithm>
+
+typedef MAQxtGlobalShortcutTrie Trie;
+
+// Shortcuts are only stored and compared, never dereferenced.
+static MAQxtGlobalShortcut* qxt_test_shortcut(int i)
+{
+    return reinterpret_cast<MAQxtGlobalShortcut*>(quintptr(i + 1) * 16);
+}
+
+static QVector<quint64> qxt_test_path(quint64 first, quint64 second = 0, quint64 third = 0)
+{
+    QVector<quint64> path;
+    path << first;
+    if (second)
+        path << second;
+    if (third)
+        path << third;
+    return path;
+}
+
+// The node 'path' leads to, or Trie::None.
+static int qxt_test_walk(const Trie& trie, const QVector<quint64>& path)
+{
+    int node = Trie::Root;
+    for (int i = 0; i < path.size() && node != Trie::None; ++i)
+        node = trie.child(node, path.at(i));
+    return node;
+}
+
+class tst_MAQxtGlobalShortcutTrie : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void insertWalk();
+    void prefixConflicts();
+    void remove();
+    void nodeReuse();
+    void clear();
+};
+
+void tst_MAQxtGlobalShortcutTrie::insertWalk()
+{
+    Trie trie;
+    QVERIFY(trie.isEmpty());
+    QVERIFY(trie.insert(qxt_test_path(1, 2), qxt_test_shortcut(0)));
+    QVERIFY(trie.insert(qxt_test_path(1, 3, 4), qxt_test_shortcut(1)));
+    QVERIFY(trie.insert(qxt_test_path(5, 2), qxt_test_shortcut(2)));
+    QVERIFY(!trie.isEmpty());
+
+    // Bindings sit on leaves; inner nodes only lead on.
+    const int prefix = trie.child(Trie::Root, 1);
+    QVERIFY(prefix != Trie::None);
+    QVERIFY(!trie.shortcut(prefix));
+    QList<quint64> chords = trie.chords(prefix);
+    std::sort(chords.begin(), chords.end());
+    QCOMPARE(chords, QList<quint64>() << 2 << 3);
+    QVERIFY(trie.shortcut(qxt_test_walk(trie, qxt_test_path(1, 2))) == qxt_test_shortcut(0));
+    QVERIFY(trie.shortcut(qxt_test_walk(trie, qxt_test_path(1, 3, 4))) == qxt_test_shortcut(1));
+    QVERIFY(trie.shortcut(qxt_test_walk(trie, qxt_test_path(5, 2))) == qxt_test_shortcut(2));
+    QCOMPARE(trie.child(Trie::Root, 2), int(Trie::None));
+    QCOMPARE(trie.child(prefix, 5), int(Trie::None));
+    QCOMPARE(trie.shortcuts().size(), 3);
+}
+
+// A chord never both completes one shortcut and continues another, and a
+// refused insertion leaves the tree as it was.
+void tst_MAQxtGlobalShortcutTrie::prefixConflicts()
+{
+    Trie trie;
+    QVERIFY(trie.insert(qxt_test_path(1, 2), qxt_test_shortcut(0)));
+    QVERIFY(!trie.insert(qxt_test_path(1, 2), qxt_test_shortcut(1)));
+    QVERIFY(!trie.insert(qxt_test_path(1), qxt_test_shortcut(1)));
+    QVERIFY(!trie.insert(qxt_test_path(1, 2, 3), qxt_test_shortcut(1)));
+    QCOMPARE(trie.chords(Trie::Root), QList<quint64>() << 1);
+    QCOMPARE(trie.chords(trie.child(Trie::Root, 1)), QList<quint64>() << 2);
+    QVERIFY(trie.chords(qxt_test_walk(trie, qxt_test_path(1, 2))).isEmpty());
+    QCOMPARE(trie.shortcuts(), QList<MAQxtGlobalShortcut*>() << qxt_test_shortcut(0));
+
+    // Siblings are fine, at any depth.
+    QVERIFY(trie.insert(qxt_test_path(1, 3), qxt_test_shortcut(1)));
+    QVERIFY(trie.insert(qxt_test_path(1, 4, 5), qxt_test_shortcut(2)));
+    QVERIFY(!trie.insert(qxt_test_path(1, 4), qxt_test_shortcut(3)));
+    QCOMPARE(trie.shortcuts().size(), 3);
+}
+
+void tst_MAQxtGlobalShortcutTrie::remove()
+{
+    Trie trie;
+    QVERIFY(trie.insert(qxt_test_path(1, 2, 3), qxt_test_shortcut(0)));
+    QVERIFY(trie.insert(qxt_test_path(1, 4), qxt_test_shortcut(1)));
+
+    // Only the exact path with its own shortcut.
+    QVERIFY(!trie.remove(qxt_test_path(1, 2, 3), qxt_test_shortcut(1)));
+    QVERIFY(!trie.remove(qxt_test_path(1, 2), qxt_test_shortcut(0)));
+    QVERIFY(!trie.remove(qxt_test_path(1, 2, 3) << 4, qxt_test_shortcut(0)));
+    QVERIFY(!trie.remove(qxt_test_path(7), qxt_test_shortcut(0)));
+    QCOMPARE(trie.shortcuts().size(), 2);
+
+    // The branch is pruned up to the node still shared.
+    QVERIFY(trie.remove(qxt_test_path(1, 2, 3), qxt_test_shortcut(0)));
+    QCOMPARE(trie.child(trie.child(Trie::Root, 1), 2), int(Trie::None));
+    QCOMPARE(trie.chords(trie.child(Trie::Root, 1)), QList<quint64>() << 4);
+    QVERIFY(!trie.remove(qxt_test_path(1, 2, 3), qxt_test_shortcut(0)));
+
+    // A prefix freed of its extensions can be bound again.
+    QVERIFY(trie.insert(qxt_test_path(1, 2), qxt_test_shortcut(2)));
+    QVERIFY(trie.remove(qxt_test_path(1, 2), qxt_test_shortcut(2)));
+    QVERIFY(trie.remove(qxt_test_path(1, 4), qxt_test_shortcut(1)));
+    QVERIFY(trie.isEmpty());
+    QCOMPARE(trie.child(Trie::Root, 1), int(Trie::None));
+    QVERIFY(trie.shortcuts().isEmpty());
+}
+
+// Pruned nodes are recycled, so churn does not grow the tree, and a
+// recycled node starts out empty.
+void tst_MAQxtGlobalShortcutTrie::nodeReuse()
+{
+    Trie trie;
+    QVERIFY(trie.insert(qxt_test_path(1, 2, 3), qxt_test_shortcut(0)));
+    QVERIFY(qxt_test_walk(trie, qxt_test_path(1, 2, 3)) <= 3);
+    QVERIFY(trie.remove(qxt_test_path(1, 2, 3), qxt_test_shortcut(0)));
+    for (int i = 0; i < 1000; ++i)
+    {
+        QVERIFY(trie.insert(qxt_test_path(5, 6, 7), qxt_test_shortcut(i)));
+        QVERIFY(trie.remove(qxt_test_path(5, 6, 7), qxt_test_shortcut(i)));
+    }
+    QVERIFY(trie.insert(qxt_test_path(8, 9), qxt_test_shortcut(1)));
+    const int reused = trie.child(Trie::Root, 8);
+    QVERIFY(reused <= 3);
+    QVERIFY(!trie.shortcut(reused));
+    QCOMPARE(trie.chords(reused), QList<quint64>() << 9);
+}
+
+void tst_MAQxtGlobalShortcutTrie::clear()
+{
+    Trie trie;
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(trie.insert(qxt_test_path(1, i + 2), qxt_test_shortcut(i)));
+    trie.clear();
+    QVERIFY(trie.isEmpty());
+    QVERIFY(trie.shortcuts().isEmpty());
+    QCOMPARE(trie.child(Trie::Root, 1), int(Trie::None));
+    QVERIFY(trie.insert(qxt_test_path(1), qxt_test_shortcut(0)));
+    QCOMPARE(trie.shortcuts(), QList<MAQxtGlobalShortcut*>() << qxt_test_shortcut(0));
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtGlobalShortcutTrie)
+#include "tst_maqxtglobalshortcuttrie.moc"
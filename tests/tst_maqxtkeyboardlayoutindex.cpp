@@ -0,0 +1,216 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtkeyboardlayoutindex_p.h"
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+#include <QtTest>
+#include <string.h>
+
+// The layouts in data/ are written by data/mkuchr.py, little-endian.
+static QByteArray qxt_test_layout(const char* name)
+{
+    QFile file(QFile::decodeName(QByteArray(MAQXT_TEST_DATA "/") + name));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+static bool qxt_test_build(MAQxtKeyboardLayoutIndex& index, const QByteArray& layout)
+{
+    return index.build(reinterpret_cast<const uchar*>(layout.constData()), layout.size());
+}
+
+class tst_MAQxtKeyboardLayoutIndex : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void us_data();
+    void us();
+    void deadKeys_data();
+    void deadKeys();
+    void rebuild();
+    void truncated();
+    void malformed();
+};
+
+void tst_MAQxtKeyboardLayoutIndex::initTestCase()
+{
+    // The index reads layouts in host byte order, as Carbon hands them out.
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian)
+#if QT_VERSION >= 0x050000
+        QSKIP("The layout fixtures are little-endian");
+#else
+        QSKIP("The layout fixtures are little-endian", SkipAll);
+#endif
+    QVERIFY(!qxt_test_layout("us.uchr").isEmpty());
+    QVERIFY(!qxt_test_layout("deadkeys.uchr").isEmpty());
+}
+
+void tst_MAQxtKeyboardLayoutIndex::us_data()
+{
+    QTest::addColumn<int>("ch");
+    QTest::addColumn<int>("keycode");
+
+    QTest::newRow("a") << int('a') << 0;
+    QTest::newRow("z") << int('z') << 6;
+    QTest::newRow("q") << int('q') << 12;
+    QTest::newRow("1") << int('1') << 18;
+    QTest::newRow("0") << int('0') << 29;
+    QTest::newRow("space") << int(' ') << 49;
+    QTest::newRow("return") << int('\r') << 36;
+    QTest::newRow("escape") << 0x1b << 53;
+    QTest::newRow("backquote") << int('`') << 50;
+    // The shifted table.
+    QTest::newRow("A") << int('A') << 0;
+    QTest::newRow("!") << int('!') << 18;
+    QTest::newRow("~") << int('~') << 50;
+    // The option table.
+    QTest::newRow("a ring") << 0xe5 << 0;
+    QTest::newRow("pi") << 0x3c0 << 35;
+    // Only the second keyboard type has the key left of 1; for the keys
+    // both have, the first type wins, even over its own shifted table.
+    QTest::newRow("section") << 0xa7 << 10;
+    QTest::newRow("<") << int('<') << 43;
+    QTest::newRow("y") << int('y') << 16;
+    QTest::newRow("unmapped") << 0xe9 << -1;
+    QTest::newRow("nul") << 0 << -1;
+}
+
+void tst_MAQxtKeyboardLayoutIndex::us()
+{
+    QFETCH(int, ch);
+    QFETCH(int, keycode);
+    MAQxtKeyboardLayoutIndex index;
+    QVERIFY(qxt_test_build(index, qxt_test_layout("us.uchr")));
+    QCOMPARE(index.size(), 104);
+    QCOMPARE(index.keycode(quint16(ch)), keycode);
+}
+
+void tst_MAQxtKeyboardLayoutIndex::deadKeys_data()
+{
+    QTest::addColumn<int>("ch");
+    QTest::addColumn<int>("keycode");
+
+    QTest::newRow("plain") << int('a') << 0;
+    QTest::newRow("state record") << int('e') << 14;
+    QTest::newRow("direct 0xc000 range") << 0xf704 << 122;
+    QTest::newRow("after skipped keys") << int('x') << 7;
+    // A sequence index (0x8000) and the "no output" values are no
+    // characters.
+    QTest::newRow("sequence") << 0x8000 << -1;
+    QTest::newRow("fffe") << 0xfffe << -1;
+    QTest::newRow("ffff") << 0xffff << -1;
+}
+
+void tst_MAQxtKeyboardLayoutIndex::deadKeys()
+{
+    QFETCH(int, ch);
+    QFETCH(int, keycode);
+    MAQxtKeyboardLayoutIndex index;
+    QVERIFY(qxt_test_build(index, qxt_test_layout("deadkeys.uchr")));
+    // The dead key itself produces nothing from the base state, and the
+    // key pointing past the state records is left out.
+    QCOMPARE(index.size(), 4);
+    QCOMPARE(index.keycode(quint16(ch)), keycode);
+}
+
+void tst_MAQxtKeyboardLayoutIndex::rebuild()
+{
+    MAQxtKeyboardLayoutIndex index;
+    QVERIFY(index.isEmpty());
+    QVERIFY(qxt_test_build(index, qxt_test_layout("us.uchr")));
+    QCOMPARE(index.keycode('b'), 11);
+    QVERIFY(qxt_test_build(index, qxt_test_layout("deadkeys.uchr")));
+    QCOMPARE(index.keycode('b'), -1);
+    QCOMPARE(index.keycode('a'), 0);
+    QVERIFY(!index.build(0, 0));
+    QVERIFY(index.isEmpty());
+    QVERIFY(qxt_test_build(index, qxt_test_layout("us.uchr")));
+    index.clear();
+    QVERIFY(index.isEmpty());
+    QCOMPARE(index.keycode('a'), -1);
+}
+
+void tst_MAQxtKeyboardLayoutIndex::truncated()
+{
+    // Every prefix of a layout is read without going past its end: each
+    // is copied to a buffer of its own size, for valgrind or ASan to
+    // catch reads beyond it. What is indexed is a subset of the whole.
+    const QByteArray layout = qxt_test_layout("us.uchr");
+    MAQxtKeyboardLayoutIndex whole;
+    QVERIFY(qxt_test_build(whole, layout));
+    MAQxtKeyboardLayoutIndex index;
+    for (int size = 0; size < layout.size(); ++size)
+    {
+        QVector<uchar> prefix(qMax(size, 1));
+        memcpy(prefix.data(), layout.constData(), size);
+        index.build(prefix.constData(), size);
+        QVERIFY(index.size() <= whole.size());
+        for (int ch = 0; ch < 0x80; ++ch)
+        {
+            if (index.keycode(quint16(ch)) >= 0)
+                QVERIFY(whole.keycode(quint16(ch)) >= 0);
+        }
+    }
+}
+
+void tst_MAQxtKeyboardLayoutIndex::malformed()
+{
+    const QByteArray layout = qxt_test_layout("us.uchr");
+    MAQxtKeyboardLayoutIndex index;
+
+    // More keyboard types than the blob has room for.
+    QByteArray broken = layout;
+    const quint32 types = 1000;
+    memcpy(broken.data() + 8, &types, sizeof(types));
+    QVERIFY(!qxt_test_build(index, broken));
+    QVERIFY(index.isEmpty());
+
+    // Key tables of unknown format, or out of range, are skipped.
+    broken = layout;
+    for (int type = 0; type < 2; ++type)
+    {
+        quint32 charIndex;
+        memcpy(&charIndex, broken.constData() + 12 + 28 * type + 12, sizeof(charIndex));
+        const quint16 format = 0x2000;
+        memcpy(broken.data() + charIndex, &format, sizeof(format));
+    }
+    QVERIFY(qxt_test_build(index, broken));
+    QVERIFY(index.isEmpty());
+
+    broken = layout;
+    const quint32 outside = 0xfffffff0;
+    memcpy(broken.data() + 12 + 12, &outside, sizeof(outside));
+    QVERIFY(qxt_test_build(index, broken));
+    QCOMPARE(index.keycode(0xa7), 10);
+    QCOMPARE(index.keycode('b'), -1);
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtKeyboardLayoutIndex)
+
+#include "tst_maqxtkeyboardlayoutindex.moc"
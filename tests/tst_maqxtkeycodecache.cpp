@@ -0,0 +1,268 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/gui/maqxtkeycodecache_p.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtTest>
+
+static const quint64 qxt_test_fingerprint = Q_UINT64_C(0x0123456789abcdef);
+static const quint64 qxt_test_other_fingerprint = Q_UINT64_C(0xfedcba9876543210);
+
+class tst_MAQxtKeycodeCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+    void roundTrip();
+    void closeSaves();
+    void fingerprintMismatch();
+    void corrupt_data();
+    void corrupt();
+    void atomicReplace();
+
+private:
+    QByteArray contents() const;
+    void write(const QByteArray& data) const;
+
+    QString fileName;
+};
+
+void tst_MAQxtKeycodeCache::initTestCase()
+{
+    fileName = QDir::tempPath() + QLatin1String("/tst_maqxtkeycodecache-") + QString::number(QCoreApplication::applicationPid());
+}
+
+void tst_MAQxtKeycodeCache::cleanup()
+{
+    QFile::remove(fileName);
+    QFile::remove(fileName + QLatin1String(".new"));
+}
+
+QByteArray tst_MAQxtKeycodeCache::contents() const
+{
+    QFile file(fileName);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+void tst_MAQxtKeycodeCache::write(const QByteArray& data) const
+{
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(data);
+}
+
+// Saved keycodes are found again by a cache that maps the file.
+void tst_MAQxtKeycodeCache::roundTrip()
+{
+    {
+        MAQxtKeycodeCache cache;
+        QVERIFY(!cache.open(fileName, qxt_test_fingerprint));
+        QVERIFY(cache.isOpen());
+        QCOMPARE(cache.name(), fileName);
+        for (int id = 0; id < 300; ++id)
+            cache.insert(id * 7919, quint32(id + 8));
+        quint32 native = 0;
+        QVERIFY(cache.find(7919, native));
+        QCOMPARE(native, quint32(9));
+        QVERIFY(cache.save());
+        QCOMPARE(contents().size(), int(MAQxtKeycodeCache::HeaderSize + 300 * MAQxtKeycodeCache::EntrySize));
+        // Reopened after saving, by value.
+        QVERIFY(cache.isOpen());
+        QCOMPARE(cache.name(), fileName);
+        QVERIFY(cache.find(7919 * 299, native));
+        QCOMPARE(native, quint32(307));
+    }
+
+    MAQxtKeycodeCache cache;
+    QVERIFY(cache.open(fileName, qxt_test_fingerprint));
+    for (int id = 0; id < 300; ++id)
+    {
+        quint32 native = 0;
+        QVERIFY(cache.find(id * 7919, native));
+        QCOMPARE(native, quint32(id + 8));
+    }
+    quint32 native = 0;
+    QVERIFY(!cache.find(1, native));
+    QVERIFY(!cache.find(-7919, native));
+
+    // Keycodes added to a mapped file go into the next one with the rest.
+    cache.insert(1, 100);
+    QVERIFY(cache.save());
+    QVERIFY(cache.find(1, native));
+    QCOMPARE(native, quint32(100));
+    QVERIFY(cache.find(0, native));
+    QCOMPARE(native, quint32(8));
+    QCOMPARE(contents().size(), int(MAQxtKeycodeCache::HeaderSize + 301 * MAQxtKeycodeCache::EntrySize));
+}
+
+void tst_MAQxtKeycodeCache::closeSaves()
+{
+    {
+        MAQxtKeycodeCache cache;
+        cache.open(fileName, qxt_test_fingerprint);
+        cache.insert(42, 38);
+        cache.close();
+        QVERIFY(!cache.isOpen());
+        // Closed, the cache holds nothing.
+        quint32 native = 0;
+        QVERIFY(!cache.find(42, native));
+    }
+    MAQxtKeycodeCache cache;
+    QVERIFY(cache.open(fileName, qxt_test_fingerprint));
+    quint32 native = 0;
+    QVERIFY(cache.find(42, native));
+    QCOMPARE(native, quint32(38));
+}
+
+// A file of another keyboard mapping is ignored, and replaced on save.
+void tst_MAQxtKeycodeCache::fingerprintMismatch()
+{
+    {
+        MAQxtKeycodeCache cache;
+        cache.open(fileName, qxt_test_fingerprint);
+        cache.insert(42, 38);
+        QVERIFY(cache.save());
+    }
+    {
+        MAQxtKeycodeCache cache;
+        QVERIFY(!cache.open(fileName, qxt_test_other_fingerprint));
+        quint32 native = 0;
+        QVERIFY(!cache.find(42, native));
+        cache.insert(43, 39);
+        QVERIFY(cache.save());
+    }
+    MAQxtKeycodeCache cache;
+    QVERIFY(!cache.open(fileName, qxt_test_fingerprint));
+    QVERIFY(cache.open(fileName, qxt_test_other_fingerprint));
+    quint32 native = 0;
+    QVERIFY(!cache.find(42, native));
+    QVERIFY(cache.find(43, native));
+    QCOMPARE(native, quint32(39));
+
+    // Nor is a cache kept without a fingerprint.
+    QVERIFY(!cache.open(fileName, 0));
+    cache.insert(44, 40);
+    QVERIFY(!cache.save());
+}
+
+void tst_MAQxtKeycodeCache::corrupt_data()
+{
+    QByteArray valid;
+    {
+        MAQxtKeycodeCache cache;
+        cache.open(fileName, qxt_test_fingerprint);
+        cache.insert(1, 10);
+        cache.insert(2, 20);
+        QVERIFY(cache.save());
+        valid = contents();
+        cleanup();
+    }
+    QCOMPARE(valid.size(), int(MAQxtKeycodeCache::HeaderSize + 2 * MAQxtKeycodeCache::EntrySize));
+
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short header") << valid.left(MAQxtKeycodeCache::HeaderSize - 1);
+    QByteArray magic = valid;
+    magic[3] = 'Y';
+    QTest::newRow("magic") << magic;
+    QByteArray version = valid;
+    version[8] = char(version[8] + 1);
+    QTest::newRow("version") << version;
+    // The header counts more entries than the file holds.
+    QTest::newRow("truncated") << valid.left(valid.size() - 1);
+    QByteArray count = valid;
+    count[12] = char(200);
+    QTest::newRow("count") << count;
+}
+
+// A damaged file is never read from, and the next save replaces it.
+void tst_MAQxtKeycodeCache::corrupt()
+{
+    QFETCH(QByteArray, data);
+    write(data);
+    {
+        MAQxtKeycodeCache cache;
+        QVERIFY(!cache.open(fileName, qxt_test_fingerprint));
+        quint32 native = 0;
+        QVERIFY(!cache.find(1, native));
+        QVERIFY(!cache.find(2, native));
+        cache.insert(3, 30);
+        QVERIFY(cache.save());
+    }
+    MAQxtKeycodeCache cache;
+    QVERIFY(cache.open(fileName, qxt_test_fingerprint));
+    quint32 native = 0;
+    QVERIFY(!cache.find(1, native));
+    QVERIFY(cache.find(3, native));
+    QCOMPARE(native, quint32(30));
+}
+
+// Saving writes a new file and moves it over the old one: a cache that
+// has the old file mapped keeps reading it intact, and no temporary file
+// is left behind.
+void tst_MAQxtKeycodeCache::atomicReplace()
+{
+#ifdef Q_OS_WIN
+    // Windows refuses to replace a file that is mapped.
+#if QT_VERSION >= 0x050000
+    QSKIP("Mapped files cannot be replaced on Windows");
+#else
+    QSKIP("Mapped files cannot be replaced on Windows", SkipSingle);
+#endif
+#endif
+    MAQxtKeycodeCache reader;
+    {
+        MAQxtKeycodeCache cache;
+        cache.open(fileName, qxt_test_fingerprint);
+        for (int id = 0; id < 100; ++id)
+            cache.insert(id, quint32(id + 8));
+        QVERIFY(cache.save());
+    }
+    QVERIFY(reader.open(fileName, qxt_test_fingerprint));
+
+    MAQxtKeycodeCache writer;
+    QVERIFY(!writer.open(fileName, qxt_test_other_fingerprint));
+    for (int id = 0; id < 10; ++id)
+        writer.insert(id, quint32(id + 100));
+    QVERIFY(writer.save());
+
+    for (int id = 0; id < 100; ++id)
+    {
+        quint32 native = 0;
+        QVERIFY(reader.find(id, native));
+        QCOMPARE(native, quint32(id + 8));
+    }
+    QCOMPARE(contents().size(), int(MAQxtKeycodeCache::HeaderSize + 10 * MAQxtKeycodeCache::EntrySize));
+    QVERIFY(!QFile::exists(fileName + QLatin1String(".new")));
+    const QStringList left = QDir(QDir::tempPath()).entryList(QStringList() << QFileInfo(fileName).fileName() + QLatin1String("*"), QDir::Files | QDir::Hidden);
+    QCOMPARE(left.size(), 1);
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtKeycodeCache)
+#include "tst_maqxtkeycodecache.moc"
@@ -0,0 +1,170 @@
+/****************************************************************************
+ **
+ ** Copyright (C) Qxt Foundation. Some rights reserved.
+ **
+ ** This file is part of the QxtGui module of the Qxt library.
+ **
+ ** This library is free software; you can redistribute it and/or modify it
+ ** under the terms of the Common Public License, version 1.0, as published
+ ** by IBM, and/or under the terms of the GNU Lesser General Public License,
+ ** version 2.1, as published by the Free Software Foundation.
+ **
+ ** This file is provided "AS IS", without WARRANTIES OR CONDITIONS OF ANY
+ ** KIND, EITHER EXPRESS OR IMPLIED INCLUDING, WITHOUT LIMITATION, ANY
+ ** WARRANTIES OR CONDITIONS OF TITLE, NON-INFRINGEMENT, MERCHANTABILITY OR
+ ** FITNESS FOR A PARTICULAR PURPOSE.
+ **
+ ** You should have received a copy of the CPL and the LGPL along with this
+ ** file. See the LICENSE file and the cpl1.0.txt/lgpl-2.1.txt files
+ ** included with the source distribution for more information.
+ ** If you did not receive a copy of the licenses, contact the Qxt Foundation.
+ **
+ ** <http://libqxt.org>  <foundation@libqxt.org>
+ **
+ ****************************************************************************/
+#include "maqxt/core/maqxtglobal.h"
+#include "maqxt/gui/maqxtobjectpool_p.h"
+#include <QList>
+#include <QSet>
+#include <QtTest>
+
+class MAQxtTestInline;
+
+// Enough room for the overaligned variant, so that only its alignment is
+// wrong.
+#if defined(MAQXT_TEST_PRIVATE_OVERALIGNED)
+#define MAQXT_TEST_INLINE_SIZE 256
+#else
+#define MAQXT_TEST_INLINE_SIZE (4 * sizeof(void*))
+#endif
+
+class MAQxtTestInlinePrivate : public MAQxtPrivate<MAQxtTestInline>
+{
+public:
+    MAQxtTestInlinePrivate() : value(42), real(0.5) { ++constructed; }
+    ~MAQxtTestInlinePrivate() { ++destructed; }
+    MAQxtTestInline* owner() { return &qxt_p(); }
+
+    int value;
+    double real;
+#if defined(MAQXT_TEST_PRIVATE_TOO_LARGE)
+    char padding[64];
+#elif defined(MAQXT_TEST_PRIVATE_OVERALIGNED)
+    Q_DECL_ALIGN(64) char padding[8];
+#endif
+
+    static int constructed;
+    static int destructed;
+};
+
+int MAQxtTestInlinePrivate::constructed = 0;
+int MAQxtTestInlinePrivate::destructed = 0;
+
+class MAQxtTestInline
+{
+    MAQXT_DECLARE_INLINE_PRIVATE(MAQxtTestInline, MAQXT_TEST_INLINE_SIZE)
+public:
+    MAQxtTestInline() { MAQXT_INIT_PRIVATE(MAQxtTestInline); }
+    MAQxtTestInlinePrivate& d() { return qxt_d(); }
+    const MAQxtTestInlinePrivate& d() const { return qxt_d(); }
+};
+
+#if defined(MAQXT_TEST_PRIVATE_TOO_LARGE) || defined(MAQXT_TEST_PRIVATE_OVERALIGNED)
+
+// Built by the tests that expect the storage checks to refuse the private
+// class; see CMakeLists.txt.
+int main()
+{
+    MAQxtTestInline object;
+    return object.d().value;
+}
+
+#else
+
+struct MAQxtTestPooled
+{
+    qint64 integer;
+    char data[13];
+};
+
+static MAQxtObjectPool<MAQxtTestPooled, 8> qxt_test_pool;
+
+class tst_MAQxtObjectPool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void reuse();
+    void alignment();
+    void inlineStorage();
+};
+
+void tst_MAQxtObjectPool::reuse()
+{
+    // More than a chunk, so that the pool has to grow.
+    QList<void*> objects;
+    QSet<void*> distinct;
+    for (int i = 0; i < 20; ++i)
+    {
+        objects.append(qxt_test_pool.allocate());
+        distinct.insert(objects.last());
+    }
+    QCOMPARE(distinct.size(), 20);
+
+    // Released slots are handed out again, the last released first, before
+    // the pool grows again.
+    for (int i = 0; i < 20; ++i)
+        qxt_test_pool.release(objects.at(i));
+    for (int i = 19; i >= 0; --i)
+        QCOMPARE(qxt_test_pool.allocate(), objects.at(i));
+    qxt_test_pool.release(objects.at(7));
+    QCOMPARE(qxt_test_pool.allocate(), objects.at(7));
+
+    void* more = qxt_test_pool.allocate();
+    QVERIFY(!objects.contains(more));
+    qxt_test_pool.release(more);
+    for (int i = 0; i < 20; ++i)
+        qxt_test_pool.release(objects.at(i));
+}
+
+void tst_MAQxtObjectPool::alignment()
+{
+    QList<void*> objects;
+    for (int i = 0; i < 20; ++i)
+    {
+        objects.append(qxt_test_pool.allocate());
+        QCOMPARE(quintptr(objects.last()) % Q_ALIGNOF(MAQxtTestPooled), quintptr(0));
+        QCOMPARE(quintptr(objects.last()) % Q_ALIGNOF(double), quintptr(0));
+    }
+    for (int i = 0; i < 20; ++i)
+        qxt_test_pool.release(objects.at(i));
+}
+
+void tst_MAQxtObjectPool::inlineStorage()
+{
+    MAQxtTestInlinePrivate::constructed = 0;
+    MAQxtTestInlinePrivate::destructed = 0;
+    {
+        MAQxtTestInline object;
+        QCOMPARE(MAQxtTestInlinePrivate::constructed, 1);
+
+        // The private object lives inside the public one, suitably aligned.
+        const char* begin = reinterpret_cast<const char*>(&object);
+        const char* d = reinterpret_cast<const char*>(&object.d());
+        QVERIFY(d >= begin && d + sizeof(MAQxtTestInlinePrivate) <= begin + sizeof(object));
+        QVERIFY(sizeof(object) >= MAQXT_TEST_INLINE_SIZE);
+        QCOMPARE(quintptr(d) % Q_ALIGNOF(MAQxtTestInlinePrivate), quintptr(0));
+
+        const MAQxtTestInline& constObject = object;
+        QVERIFY(&constObject.d() == &object.d());
+        QCOMPARE(constObject.d().value, 42);
+        QCOMPARE(constObject.d().real, 0.5);
+        QVERIFY(object.d().owner() == &object);
+    }
+    QCOMPARE(MAQxtTestInlinePrivate::destructed, 1);
+}
+
+QTEST_APPLESS_MAIN(tst_MAQxtObjectPool)
+#include "tst_maqxtobjectpool.moc"
+
+#endif